@@ -0,0 +1,58 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <stdbool.h>
+#include "vec2.h"
+
+typedef struct
+{
+    Vec2 min;
+    Vec2 max;
+} AABB;
+
+AABB aabb_create(Vec2 min, Vec2 max)
+{
+    return (AABB){.min = min, .max = max};
+}
+
+bool aabb_overlap(AABB a, AABB b)
+{
+    // touching boxes count as overlapping, matching the <= tests in the narrowphase
+    if (a.max.x < b.min.x || b.max.x < a.min.x)
+        return false;
+    if (a.max.y < b.min.y || b.max.y < a.min.y)
+        return false;
+    return true;
+}
+
+bool aabb_contains(AABB outer, AABB inner)
+{
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && inner.max.x <= outer.max.x && inner.max.y <= outer.max.y;
+}
+
+AABB aabb_union(AABB a, AABB b)
+{
+    return aabb_create((Vec2){.x = fminf(a.min.x, b.min.x), .y = fminf(a.min.y, b.min.y)}, (Vec2){.x = fmaxf(a.max.x, b.max.x), .y = fmaxf(a.max.y, b.max.y)});
+}
+
+AABB aabb_fatten(AABB a, float margin)
+{
+    return aabb_create((Vec2){.x = a.min.x - margin, .y = a.min.y - margin}, (Vec2){.x = a.max.x + margin, .y = a.max.y + margin});
+}
+
+float aabb_perimeter(AABB a)
+{
+    return 2.0f * ((a.max.x - a.min.x) + (a.max.y - a.min.y));
+}
+
+float aabb_width(AABB a)
+{
+    return a.max.x - a.min.x;
+}
+
+float aabb_height(AABB a)
+{
+    return a.max.y - a.min.y;
+}
+
+#endif
@@ -0,0 +1,362 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <stdbool.h>
+#include <assert.h>
+
+#include "aabb.h"
+#include "mem.h"
+
+#define AABB_TREE_NULL -1
+
+// leaves store the body AABB grown by this margin, so small movements don't reinsert
+#define AABB_TREE_MARGIN 4.0f
+// and stretched along the body's velocity by this many seconds of travel
+#define AABB_TREE_DISPLACEMENT_TIME (2.0f / 60.0f)
+
+typedef struct
+{
+    AABB aabb;
+
+    // parent, or the next free node while the node is on the free list
+    int parent;
+    int child1;
+    int child2;
+
+    // leaf = 0, free node = -1
+    int height;
+
+    // index of the body in the broadphase, leaves only
+    int body;
+} AABBTreeNode;
+
+typedef struct
+{
+    AABBTreeNode *nodes;
+    unsigned int capacity;
+    unsigned int n_nodes;
+    int root;
+    int free_list;
+
+    int *stack;
+    unsigned int stack_capacity;
+} AABBTree;
+
+void aabb_tree_create(AABBTree *t)
+{
+    t->nodes = NULL;
+    t->capacity = 0;
+    t->n_nodes = 0;
+    t->root = AABB_TREE_NULL;
+    t->free_list = AABB_TREE_NULL;
+    t->stack = NULL;
+    t->stack_capacity = 0;
+}
+
+void aabb_tree_destroy(AABBTree *t)
+{
+    mem_free(t->nodes);
+    mem_free(t->stack);
+    aabb_tree_create(t);
+}
+
+bool aabb_tree_is_leaf(AABBTree *t, int node)
+{
+    return t->nodes[node].child1 == AABB_TREE_NULL;
+}
+
+int aabb_tree_allocate_node(AABBTree *t)
+{
+    if (t->free_list == AABB_TREE_NULL)
+    {
+        unsigned int old_capacity = t->capacity;
+        t->nodes = (AABBTreeNode *)mem_grow(t->nodes, &t->capacity, t->capacity + 1, sizeof(AABBTreeNode));
+        for (unsigned int i = old_capacity; i < t->capacity; i++)
+        {
+            t->nodes[i].parent = (i + 1 < t->capacity) ? (int)(i + 1) : AABB_TREE_NULL;
+            t->nodes[i].height = -1;
+        }
+        t->free_list = old_capacity;
+    }
+
+    int node = t->free_list;
+    t->free_list = t->nodes[node].parent;
+    t->nodes[node].parent = AABB_TREE_NULL;
+    t->nodes[node].child1 = AABB_TREE_NULL;
+    t->nodes[node].child2 = AABB_TREE_NULL;
+    t->nodes[node].height = 0;
+    t->nodes[node].body = -1;
+    t->n_nodes++;
+    return node;
+}
+
+void aabb_tree_free_node(AABBTree *t, int node)
+{
+    t->nodes[node].parent = t->free_list;
+    t->nodes[node].height = -1;
+    t->free_list = node;
+    t->n_nodes--;
+}
+
+void aabb_tree_fix_node(AABBTree *t, int node)
+{
+    AABBTreeNode *n = &t->nodes[node];
+    AABBTreeNode *c1 = &t->nodes[n->child1];
+    AABBTreeNode *c2 = &t->nodes[n->child2];
+    n->height = 1 + ((c1->height > c2->height) ? c1->height : c2->height);
+    n->aabb = aabb_union(c1->aabb, c2->aabb);
+}
+
+void aabb_tree_replace_child(AABBTree *t, int parent, int old_child, int new_child)
+{
+    if (parent == AABB_TREE_NULL)
+    {
+        t->root = new_child;
+    }
+    else if (t->nodes[parent].child1 == old_child)
+    {
+        t->nodes[parent].child1 = new_child;
+    }
+    else
+    {
+        assert(t->nodes[parent].child2 == old_child);
+        t->nodes[parent].child2 = new_child;
+    }
+}
+
+// Rotates the taller grandchild of node a up into its place if the two subtrees of a differ
+// in height by more than one. Returns the index of the node now at the position of a.
+int aabb_tree_balance(AABBTree *t, int a)
+{
+    AABBTreeNode *na = &t->nodes[a];
+    if (aabb_tree_is_leaf(t, a) || na->height < 2)
+        return a;
+
+    int b = na->child1;
+    int c = na->child2;
+    AABBTreeNode *nb = &t->nodes[b];
+    AABBTreeNode *nc = &t->nodes[c];
+    int balance = nc->height - nb->height;
+
+    if (balance > 1)
+    {
+        // rotate c up
+        int f = nc->child1;
+        int g = nc->child2;
+
+        nc->child1 = a;
+        nc->parent = na->parent;
+        na->parent = c;
+        aabb_tree_replace_child(t, nc->parent, a, c);
+
+        if (t->nodes[f].height > t->nodes[g].height)
+        {
+            nc->child2 = f;
+            na->child2 = g;
+            t->nodes[g].parent = a;
+        }
+        else
+        {
+            nc->child2 = g;
+            na->child2 = f;
+            t->nodes[f].parent = a;
+        }
+        aabb_tree_fix_node(t, a);
+        aabb_tree_fix_node(t, c);
+        return c;
+    }
+
+    if (balance < -1)
+    {
+        // rotate b up
+        int d = nb->child1;
+        int e = nb->child2;
+
+        nb->child1 = a;
+        nb->parent = na->parent;
+        na->parent = b;
+        aabb_tree_replace_child(t, nb->parent, a, b);
+
+        if (t->nodes[d].height > t->nodes[e].height)
+        {
+            nb->child2 = d;
+            na->child1 = e;
+            t->nodes[e].parent = a;
+        }
+        else
+        {
+            nb->child2 = e;
+            na->child1 = d;
+            t->nodes[d].parent = a;
+        }
+        aabb_tree_fix_node(t, a);
+        aabb_tree_fix_node(t, b);
+        return b;
+    }
+
+    return a;
+}
+
+void aabb_tree_refit(AABBTree *t, int node)
+{
+    while (node != AABB_TREE_NULL)
+    {
+        node = aabb_tree_balance(t, node);
+        aabb_tree_fix_node(t, node);
+        node = t->nodes[node].parent;
+    }
+}
+
+void aabb_tree_insert_leaf(AABBTree *t, int leaf)
+{
+    if (t->root == AABB_TREE_NULL)
+    {
+        t->root = leaf;
+        t->nodes[leaf].parent = AABB_TREE_NULL;
+        return;
+    }
+
+    // walk down picking the child with the cheapest perimeter growth
+    AABB leaf_aabb = t->nodes[leaf].aabb;
+    int sibling = t->root;
+    while (!aabb_tree_is_leaf(t, sibling))
+    {
+        AABBTreeNode *n = &t->nodes[sibling];
+        float perimeter = aabb_perimeter(n->aabb);
+        float combined_perimeter = aabb_perimeter(aabb_union(n->aabb, leaf_aabb));
+
+        // cost of making a new parent for this node and the leaf
+        float cost = 2.0f * combined_perimeter;
+        // minimum cost of pushing the leaf further down
+        float inheritance_cost = 2.0f * (combined_perimeter - perimeter);
+
+        float child_cost[2];
+        int children[2] = {n->child1, n->child2};
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            AABBTreeNode *child = &t->nodes[children[i]];
+            child_cost[i] = aabb_perimeter(aabb_union(leaf_aabb, child->aabb)) + inheritance_cost;
+            if (!aabb_tree_is_leaf(t, children[i]))
+                child_cost[i] -= aabb_perimeter(child->aabb);
+        }
+
+        if (cost < child_cost[0] && cost < child_cost[1])
+            break;
+
+        sibling = (child_cost[0] < child_cost[1]) ? children[0] : children[1];
+    }
+
+    int old_parent = t->nodes[sibling].parent;
+    int new_parent = aabb_tree_allocate_node(t);
+    t->nodes[new_parent].parent = old_parent;
+    t->nodes[new_parent].child1 = sibling;
+    t->nodes[new_parent].child2 = leaf;
+    t->nodes[sibling].parent = new_parent;
+    t->nodes[leaf].parent = new_parent;
+    aabb_tree_replace_child(t, old_parent, sibling, new_parent);
+
+    aabb_tree_refit(t, new_parent);
+}
+
+void aabb_tree_remove_leaf(AABBTree *t, int leaf)
+{
+    if (leaf == t->root)
+    {
+        t->root = AABB_TREE_NULL;
+        return;
+    }
+
+    int parent = t->nodes[leaf].parent;
+    int grandparent = t->nodes[parent].parent;
+    int sibling = (t->nodes[parent].child1 == leaf) ? t->nodes[parent].child2 : t->nodes[parent].child1;
+
+    aabb_tree_replace_child(t, grandparent, parent, sibling);
+    t->nodes[sibling].parent = grandparent;
+    aabb_tree_free_node(t, parent);
+
+    aabb_tree_refit(t, grandparent);
+}
+
+AABB aabb_tree_fat_aabb(AABB aabb, Vec2 displacement)
+{
+    AABB fat = aabb_fatten(aabb, AABB_TREE_MARGIN);
+    if (displacement.x < 0)
+        fat.min.x += displacement.x;
+    else
+        fat.max.x += displacement.x;
+    if (displacement.y < 0)
+        fat.min.y += displacement.y;
+    else
+        fat.max.y += displacement.y;
+    return fat;
+}
+
+int aabb_tree_create_proxy(AABBTree *t, AABB aabb, Vec2 displacement, int body)
+{
+    int proxy = aabb_tree_allocate_node(t);
+    t->nodes[proxy].aabb = aabb_tree_fat_aabb(aabb, displacement);
+    t->nodes[proxy].body = body;
+    aabb_tree_insert_leaf(t, proxy);
+    return proxy;
+}
+
+void aabb_tree_destroy_proxy(AABBTree *t, int proxy)
+{
+    aabb_tree_remove_leaf(t, proxy);
+    aabb_tree_free_node(t, proxy);
+}
+
+// Returns true if the proxy had to be reinserted
+bool aabb_tree_move_proxy(AABBTree *t, int proxy, AABB aabb, Vec2 displacement)
+{
+    AABB tree_aabb = t->nodes[proxy].aabb;
+    AABB fat = aabb_tree_fat_aabb(aabb, displacement);
+
+    // still inside its fat bounds, and those are not much larger than needed
+    if (aabb_contains(tree_aabb, aabb) && aabb_contains(aabb_fatten(fat, 4.0f * AABB_TREE_MARGIN), tree_aabb))
+        return false;
+
+    aabb_tree_remove_leaf(t, proxy);
+    t->nodes[proxy].aabb = fat;
+    aabb_tree_insert_leaf(t, proxy);
+    return true;
+}
+
+// Calls callback with the body of every leaf whose fat AABB overlaps aabb
+void aabb_tree_query(AABBTree *t, AABB aabb, void (*callback)(void *, int), void *context)
+{
+    if (t->root == AABB_TREE_NULL)
+        return;
+
+    unsigned int n_stack = 0;
+    t->stack = (int *)mem_grow(t->stack, &t->stack_capacity, 1, sizeof(int));
+    t->stack[n_stack++] = t->root;
+
+    while (n_stack > 0)
+    {
+        int node = t->stack[--n_stack];
+        AABBTreeNode *n = &t->nodes[node];
+        if (!aabb_overlap(n->aabb, aabb))
+            continue;
+
+        if (aabb_tree_is_leaf(t, node))
+        {
+            callback(context, n->body);
+        }
+        else
+        {
+            t->stack = (int *)mem_grow(t->stack, &t->stack_capacity, n_stack + 2, sizeof(int));
+            t->stack[n_stack++] = n->child1;
+            t->stack[n_stack++] = n->child2;
+        }
+    }
+}
+
+int aabb_tree_height(AABBTree *t)
+{
+    if (t->root == AABB_TREE_NULL)
+        return 0;
+    return t->nodes[t->root].height;
+}
+
+#endif
@@ -7,17 +7,24 @@
 #include "body.h"
 #include "force.h"
 #include "collision.h"
+#include "fixed_step.h"
 
 #include "mem.h"
+#include "trace.h"
 
 #define FPS 60
 #define MILLISECONDS_PER_FRAME ((int)(1000.0f / FPS))
 
+// world steps per second, independent of FPS, and the most steps one frame may catch up
+#define PHYSICS_RATE 60
+#define PHYSICS_MAX_STEPS 4
+
 typedef struct
 {
     bool running;
     bool debug;
     World world;
+    FixedStep step;
 
     Vec2 mouse_cursor_pos;
     bool mouse_button_down;
@@ -34,84 +41,58 @@ void app_setup(int window_width, int window_height)
     app.running = gfx_create_window(window_width, window_height);
     app.debug = false;
     world_create(&app.world, -9.8f);
-    time_previous_frame = 0;
+    fixed_step_create(&app.step, PHYSICS_RATE, PHYSICS_MAX_STEPS);
+    app.world.debug_draw.enabled = true;
+    time_previous_frame = SDL_GetTicks();
     app.mouse_cursor_pos = (Vec2){0, 0};
     app.mouse_button_down = false;
     app.new_shape_type = CIRCLE;
 
-    Circle *c1 = (Circle *)malloc(sizeof(Circle));
-    *c1 = circle_create(30.0);
-    Body *b1 = (Body *)malloc(sizeof(Body));
-    *b1 = body_create(CIRCLE, c1, gfx.window_width / 2, gfx.window_height / 2, 0.0);
-    body_set_texture(b1, "assets/bowlingball.png");
-    List_push(&app.world.bodies, b1);
-
-    Polygon *box = (Polygon *)malloc(sizeof(Polygon));
-    *box = box_create(800, 50);
-    Body *b2 = (Body *)malloc(sizeof(Body));
-    *b2 = body_create(BOX, box, b1->position.x, b1->position.y + 200, 1.0);
-    b2->friction = 0.5;
-    b2->restitution = 0.1;
-    // body_set_fill_color(b2, (uint8_t[3]){163, 110, 11});
-    List_push(&app.world.bodies, b2);
-
-    JointConstraint *jc = (JointConstraint *)malloc(sizeof(JointConstraint));
-    joint_constraint_create(jc, b1, b2, b1->position);
-    List_push(&app.world.joint_constraints, jc);
-
-    Circle *c2 = (Circle *)malloc(sizeof(Circle));
-    *c2 = circle_create(20.0);
-    Body *b3 = (Body *)malloc(sizeof(Body));
-    *b3 = body_create(CIRCLE, c2, b2->position.x, b2->position.y + 150, 1.0);
-    body_set_texture(b3, "assets/bowlingball.png");
-    List_push(&app.world.bodies, b3);
-
-    jc = (JointConstraint *)malloc(sizeof(JointConstraint));
-    joint_constraint_create(jc, b2, b3, b2->position);
-    List_push(&app.world.joint_constraints, jc);
-
-    Circle *c3 = (Circle *)malloc(sizeof(Circle));
-    *c3 = circle_create(20.0);
-    Body *b4 = (Body *)malloc(sizeof(Body));
-    *b4 = body_create(CIRCLE, c3, b3->position.x, b3->position.y + 150, 1.0);
-    body_set_texture(b4, "assets/bowlingball.png");
-    List_push(&app.world.bodies, b4);
-
-    jc = (JointConstraint *)malloc(sizeof(JointConstraint));
-    joint_constraint_create(jc, b3, b4, b3->position);
-    List_push(&app.world.joint_constraints, jc);
-
-    Polygon *floor = (Polygon *)malloc(sizeof(Polygon));
-    *floor = box_create(gfx.window_width - 50, 25);
-    Body *b5 = (Body *)malloc(sizeof(Body));
-    *b5 = body_create(BOX, floor, gfx.window_width / 2.0, gfx.window_height - 25, 0.0);
-    b5->restitution = 0.1;
-    b5->friction = 0.5;
-    body_set_fill_color(b5, (uint8_t[3]){74, 50, 6});
-    List_push(&app.world.bodies, b5);
-
-    Polygon *left_wall = (Polygon *)malloc(sizeof(Polygon));
-    *left_wall = box_create(25, gfx.window_height - 50);
-    Body *b6 = (Body *)malloc(sizeof(Body));
-    *b6 = body_create(BOX, left_wall, 12, gfx.window_height / 2.0 + 12, 0.0);
-    b6->restitution = 0.1;
-    b6->friction = 0.5;
-    body_set_fill_color(b6, (uint8_t[3]){74, 50, 6});
-    List_push(&app.world.bodies, b6);
-
-    Polygon *right_wall = (Polygon *)malloc(sizeof(Polygon));
-    *right_wall = box_create(25, gfx.window_height - 50);
-    Body *b7 = (Body *)malloc(sizeof(Body));
-    *b7 = body_create(BOX, right_wall, gfx.window_width - 12, gfx.window_height / 2.0 + 12, 0.0);
-    b7->restitution = 0.1;
-    body_set_fill_color(b7, (uint8_t[3]){74, 50, 6});
-    List_push(&app.world.bodies, b7);
+    Body b1 = body_create(circle_create(30.0), gfx.window_width / 2, gfx.window_height / 2, 0.0);
+    b1.texture = gfx_load_texture("assets/bowlingball.png");
+    BodyHandle h1 = world_add_body(&app.world, b1);
+
+    Body b2 = body_create(box_create(800, 50), b1.position.x, b1.position.y + 200, 1.0);
+    b2.friction = 0.5;
+    b2.restitution = 0.1;
+    // body_set_fill_color(&b2, (uint8_t[3]){163, 110, 11});
+    BodyHandle h2 = world_add_body(&app.world, b2);
+
+    world_add_joint(&app.world, h1, h2, b1.position);
+
+    Body b3 = body_create(circle_create(20.0), b2.position.x, b2.position.y + 150, 1.0);
+    b3.texture = gfx_load_texture("assets/bowlingball.png");
+    BodyHandle h3 = world_add_body(&app.world, b3);
+
+    world_add_joint(&app.world, h2, h3, b2.position);
+
+    Body b4 = body_create(circle_create(20.0), b3.position.x, b3.position.y + 150, 1.0);
+    b4.texture = gfx_load_texture("assets/bowlingball.png");
+    BodyHandle h4 = world_add_body(&app.world, b4);
+
+    world_add_joint(&app.world, h3, h4, b3.position);
+
+    Body b5 = body_create(box_create(gfx.window_width - 50, 25), gfx.window_width / 2.0, gfx.window_height - 25, 0.0);
+    b5.restitution = 0.1;
+    b5.friction = 0.5;
+    body_set_fill_color(&b5, (uint8_t[3]){74, 50, 6});
+    world_add_body(&app.world, b5);
+
+    Body b6 = body_create(box_create(25, gfx.window_height - 50), 12, gfx.window_height / 2.0 + 12, 0.0);
+    b6.restitution = 0.1;
+    b6.friction = 0.5;
+    body_set_fill_color(&b6, (uint8_t[3]){74, 50, 6});
+    world_add_body(&app.world, b6);
+
+    Body b7 = body_create(box_create(25, gfx.window_height - 50), gfx.window_width - 12, gfx.window_height / 2.0 + 12, 0.0);
+    b7.restitution = 0.1;
+    body_set_fill_color(&b7, (uint8_t[3]){74, 50, 6});
+    world_add_body(&app.world, b7);
 }
 
 void app_input()
 {
     SDL_Event event;
-    Body b;
     while (SDL_PollEvent(&event))
     {
         switch (event.type)
@@ -130,6 +111,14 @@ void app_input()
                 app.new_shape_type = BOX;
             if (event.key.keysym.sym == SDLK_3)
                 app.new_shape_type = POLYGON;
+            // the timings of the last frames, built with -DDEBUG_TRACE
+            if (event.key.keysym.sym == SDLK_t)
+            {
+                if (trace_write_chrome_json("trace.json"))
+                    printf("trace written to trace.json\n");
+                else
+                    printf("could not write trace.json\n");
+            }
             break;
         case SDL_KEYUP:
             break;
@@ -147,41 +136,32 @@ void app_input()
                 app.mouse_cursor_pos.y = y;
                 if (app.new_shape_type == CIRCLE)
                 {
-                    Circle *c = (Circle *)malloc(sizeof(Circle));
-                    *c = circle_create(100.0);
-                    Body *b = (Body *)malloc(sizeof(Body));
-                    *b = body_create(CIRCLE, c, x, y, 1.0);
-                    b->restitution = 0.6;
-                    b->friction = 0.4;
-                    body_set_texture(b, "assets/basketball.png");
-                    List_push(&app.world.bodies, b);
+                    Body b = body_create(circle_create(100.0), x, y, 1.0);
+                    b.restitution = 0.6;
+                    b.friction = 0.4;
+                    b.texture = gfx_load_texture("assets/basketball.png");
+                    world_add_body(&app.world, b);
                 }
                 else if (app.new_shape_type == BOX)
                 {
-                    Polygon *p = (Polygon *)malloc(sizeof(Polygon));
-                    *p = box_create(100, 100);
-                    Body *b = (Body *)malloc(sizeof(Body));
-                    *b = body_create(BOX, p, x, y, 1.0);
-                    b->restitution = 0.6;
-                    b->friction = 0.4;
-                    body_set_texture(b, "assets/crate.png");
-                    List_push(&app.world.bodies, b);
+                    Body b = body_create(box_create(100, 100), x, y, 1.0);
+                    b.restitution = 0.6;
+                    b.friction = 0.4;
+                    b.texture = gfx_load_texture("assets/crate.png");
+                    world_add_body(&app.world, b);
                 }
                 else if (app.new_shape_type == POLYGON)
                 {
-                    Polygon *p = (Polygon *)malloc(sizeof(Polygon));
                     Vec2 points[5];
                     points[0] = (Vec2){20, 60};
                     points[1] = (Vec2){-40, 20};
                     points[2] = (Vec2){-20, -60};
                     points[3] = (Vec2){20, -60};
                     points[4] = (Vec2){40, 20};
-                    *p = polygon_create(points, 5);
-                    Body *b = (Body *)malloc(sizeof(Body));
-                    *b = body_create(POLYGON, p, x, y, 1.0);
-                    b->restitution = 0.6;
-                    b->friction = 0.7;
-                    List_push(&app.world.bodies, b);
+                    Body b = body_create(polygon_create(points, 5), x, y, 1.0);
+                    b.restitution = 0.6;
+                    b.friction = 0.7;
+                    world_add_body(&app.world, b);
                 }
             }
             break;
@@ -207,27 +187,23 @@ void app_update()
         SDL_Delay(time_to_wait);
     }
 
-    float delta_time = (SDL_GetTicks() - time_previous_frame) / 1000.0f;
-    if (delta_time > (1.0f / (float)FPS))
-    {
-        // printf("%f > %f\n", delta_time, (1.0f / (float)FPS));
-        delta_time = (1.0f / (float)FPS);
-    }
-
+    float frame_time = (SDL_GetTicks() - time_previous_frame) / 1000.0f;
     time_previous_frame = SDL_GetTicks();
 
-    world_update(&app.world, delta_time);
+    fixed_step_advance(&app.step, &app.world, frame_time);
     // printf("[MEM] %zu bytes allocated this update, %zu calls\n", mem_log.heap_memory_allocated, mem_log.heap_memory_calls);
 }
 
 void app_render()
 {
+    TRACE_BEGIN("app_render");
     // gfx_clear_screen((uint8_t[3]){255, 255, 255});
 
     uint8_t not_collide_color[3] = {0, 0, 255};
     uint8_t collide_color[3] = {255, 0, 0};
+    uint8_t sleeping_color[3] = {128, 128, 128};
 
-    for (Node *n = app.world.bodies.start, *next; n; n = next)
+    for (unsigned int i = 0; i < app.world.body_pool.n_bodies; i++)
     {
         uint8_t draw_color[3] = {not_collide_color[0], not_collide_color[1], not_collide_color[2]};
 
@@ -238,14 +214,24 @@ void app_render()
         //     draw_color[2] = collide_color[2];
         // }
 
-        Body *b = (Body *)n->data;
+        Body *b = &app.world.body_pool.bodies[i];
+        Vec2 position;
+        float theta;
+        body_interpolate(b, app.step.alpha, &position, &theta);
 
-        if (b->shape_type == CIRCLE)
+        if (!b->is_awake && b->inv_mass != 0.0)
         {
+            draw_color[0] = sleeping_color[0];
+            draw_color[1] = sleeping_color[1];
+            draw_color[2] = sleeping_color[2];
+        }
+
+        if (b->shape.type == CIRCLE)
+        {
+            Circle *c = &b->shape.circle;
             if (!app.debug && b->texture)
             {
-                Circle *c = (Circle *)(b->shape);
-                gfx_draw_texture(b->texture, b->position.x, b->position.y, b->theta, c->radius * 2, c->radius * 2);
+                gfx_draw_texture(b->texture, position.x, position.y, theta, c->radius * 2, c->radius * 2);
             }
             else if (!app.debug && b->fill_color[0] >= 0)
             {
@@ -253,30 +239,30 @@ void app_render()
             }
             else
             {
-                Circle *c = (Circle *)(b->shape);
-                gfx_draw_circle(b->position.x, b->position.y, c->radius, b->theta, draw_color);
+                gfx_draw_circle(position.x, position.y, c->radius, theta, draw_color);
             }
         }
-        else if (b->shape_type == BOX)
+        else if (b->shape.type == BOX)
         {
-            Polygon *p = (Polygon *)(b->shape);
-            float width = p->local_vertices[1].x - p->local_vertices[0].x;
-            float height = p->local_vertices[2].y - p->local_vertices[1].y;
+            float width = 2 * b->shape.box.half_extents.x;
+            float height = 2 * b->shape.box.half_extents.y;
 
             if (!app.debug && b->texture)
             {
-                gfx_draw_texture(b->texture, b->position.x, b->position.y, b->theta, width, height);
+                gfx_draw_texture(b->texture, position.x, position.y, theta, width, height);
             }
             else if (!app.debug && b->has_fill_color)
             {
-                gfx_draw_filled_rect(b->position.x, b->position.y, width, height, b->fill_color);
+                gfx_draw_filled_rect(position.x, position.y, width, height, b->fill_color);
             }
             else
             {
-                gfx_draw_polygon(b->position.x, b->position.y, p->global_vertices, p->n_vertices, draw_color);
+                PolygonVertices p;
+                shape_global_vertices(&b->shape, position, theta, &p);
+                gfx_draw_polygon(position.x, position.y, p.vertices, p.n_vertices, draw_color);
             }
         }
-        else if (b->shape_type == POLYGON)
+        else if (b->shape.type == POLYGON)
         {
             // if (!app.debug && b->fill_color[0] >= 0)
             // {
@@ -284,27 +270,44 @@ void app_render()
             // }
             // else
             {
-                Polygon *p = (Polygon *)(b->shape);
-                gfx_draw_polygon(b->position.x, b->position.y, p->global_vertices, p->n_vertices, draw_color);
+                PolygonVertices p;
+                shape_global_vertices(&b->shape, position, theta, &p);
+                gfx_draw_polygon(position.x, position.y, p.vertices, p.n_vertices, draw_color);
             }
         }
-        next = n->next;
     }
 
     for (Node *n = app.world.joint_constraints.start, *next; n; n = next)
     {
         JointConstraint *jc = (JointConstraint *)n->data;
-        Vec2 pa = body_local_to_global_space(jc->a, jc->a_local_anchor);
-        Vec2 pb = body_local_to_global_space(jc->b, jc->a_local_anchor);
+        Vec2 a_position, b_position;
+        float a_theta, b_theta;
+        body_interpolate(jc->a, app.step.alpha, &a_position, &a_theta);
+        body_interpolate(jc->b, app.step.alpha, &b_position, &b_theta);
+        Vec2 pa = vec2_add(a_position, vec2_rotate_rad(jc->a_local_anchor, a_theta));
+        Vec2 pb = vec2_add(b_position, vec2_rotate_rad(jc->b_local_anchor, b_theta));
         gfx_draw_line(pa.x, pa.y, pb.x, pb.y, collide_color);
         next = n->next;
     }
 
+    // what the last step recorded, the contact points
+    DebugDraw *debug_draw = &app.world.debug_draw;
+    for (unsigned int i = 0; i < debug_draw->n_commands; i++)
+    {
+        DebugDrawCommand *c = &debug_draw->commands[i];
+        if (c->type == DEBUG_DRAW_POINT)
+            gfx_draw_filled_square(c->a.x, c->a.y, 8, c->color);
+        else
+            gfx_draw_line(c->a.x, c->a.y, c->b.x, c->b.y, c->color);
+    }
+
     gfx_render_frame();
+    TRACE_END();
 }
 
 void app_destroy()
 {
+    world_destroy(&app.world);
     gfx_close_window();
 }
 
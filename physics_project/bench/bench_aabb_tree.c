@@ -0,0 +1,95 @@
+// gcc -std=c99 -O2 -pthread bench_aabb_tree.c -lm -o bench_aabb_tree
+// ./bench_aabb_tree [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../world.h"
+#include "../timer.h"
+#include "scenes.h"
+
+// floor and walls like app_setup with many small movers
+void add_container(World *w, float width, float height)
+{
+    scene_add(w, box_create(width - 50, 25), width / 2, height - 25, 0.0);
+    scene_add(w, box_create(25, height - 50), 12, height / 2 + 12, 0.0);
+    scene_add(w, box_create(25, height - 50), width - 12, height / 2 + 12, 0.0);
+}
+
+// columns of boxes resting on the floor
+void scene_stacked(World *w, unsigned int n_bodies)
+{
+    unsigned int columns = (unsigned int)sqrtf((float)n_bodies);
+    unsigned int rows = n_bodies / columns;
+    float size = 30;
+    float width = columns * size * 1.5f + 100;
+    float height = rows * size + 200;
+
+    add_container(w, width, height);
+    for (unsigned int c = 0; c < columns; c++)
+    {
+        for (unsigned int r = 0; r < rows; r++)
+        {
+            scene_add(w, box_create(size, size), 50 + size + c * size * 1.5f, height - 50 - size / 2 - r * size, 1.0);
+        }
+    }
+}
+
+// circles and boxes scattered across the container
+void scene_scattered(World *w, unsigned int n_bodies)
+{
+    scene_seed = 12345;
+    float size = sqrtf((float)n_bodies) * 60.0f;
+
+    add_container(w, size, size);
+    for (unsigned int i = 0; i < n_bodies; i++)
+    {
+        float x = scene_random(50, size - 50);
+        float y = scene_random(50, size - 100);
+        if (i % 2 == 0)
+            scene_add(w, circle_create(scene_random(10, 20)), x, y, 1.0);
+        else
+            scene_add(w, box_create(scene_random(20, 40), scene_random(20, 40)), x, y, 1.0);
+    }
+}
+
+void bench(void (*scene)(World *, unsigned int), const char *scene_name, BroadphaseType type, const char *name, unsigned int n_bodies, unsigned int frames)
+{
+    World w;
+    world_create(&w, -9.8f);
+    world_set_broadphase(&w, type);
+    scene(&w, n_bodies);
+
+    unsigned long pairs_tested = 0;
+    double broadphase_time = 0;
+    double start = timer_now();
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        pairs_tested += w.stats.n_pairs_tested;
+        broadphase_time += w.stats.broadphase_time;
+    }
+    double elapsed = timer_now() - start;
+
+    printf("%-10s %-14s %8u %14lu %16.3f %14.3f\n", scene_name, name, n_bodies, pairs_tested / frames, 1000.0 * broadphase_time / frames, 1000.0 * elapsed / frames);
+
+    world_destroy(&w);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int frames = (argc > 1) ? (unsigned int)atoi(argv[1]) : 10;
+    unsigned int sizes[2] = {2000, 10000};
+
+    printf("%-10s %-14s %8s %14s %16s %14s\n", "scene", "broadphase", "bodies", "pairs tested", "broadphase ms", "ms per frame");
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        bench(scene_stacked, "stacked", BROADPHASE_BRUTE_FORCE, "brute force", sizes[i], frames);
+        bench(scene_stacked, "stacked", BROADPHASE_SPATIAL_HASH, "spatial hash", sizes[i], frames);
+        bench(scene_stacked, "stacked", BROADPHASE_AABB_TREE, "aabb tree", sizes[i], frames);
+        bench(scene_scattered, "scattered", BROADPHASE_BRUTE_FORCE, "brute force", sizes[i], frames);
+        bench(scene_scattered, "scattered", BROADPHASE_SPATIAL_HASH, "spatial hash", sizes[i], frames);
+        bench(scene_scattered, "scattered", BROADPHASE_AABB_TREE, "aabb tree", sizes[i], frames);
+    }
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+// gcc -std=c99 -O2 -pthread bench_broadphase.c -lm -o bench_broadphase
+// ./bench_broadphase [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../world.h"
+#include "../timer.h"
+#include "scenes.h"
+
+// circles and boxes scattered at a fixed density over a floor, like a scaled up app_setup
+void scene_scattered(World *w, unsigned int n_bodies)
+{
+    scene_seed = 12345;
+    float world_size = sqrtf((float)n_bodies) * 60.0f;
+
+    for (unsigned int i = 0; i < n_bodies; i++)
+    {
+        Body b;
+        float x = scene_random(0, world_size);
+        float y = scene_random(0, world_size);
+        if (i % 2 == 0)
+        {
+            b = body_create(circle_create(scene_random(10, 20)), x, y, 1.0);
+        }
+        else
+        {
+            b = body_create(box_create(scene_random(20, 40), scene_random(20, 40)), x, y, 1.0);
+        }
+        b.friction = 0.4;
+        b.restitution = 0.2;
+        world_add_body(w, b);
+    }
+
+    Body f = body_create(box_create(world_size, 50), world_size / 2, world_size + 25, 0.0);
+    f.friction = 0.5;
+    f.restitution = 0.1;
+    world_add_body(w, f);
+}
+
+void bench(BroadphaseType type, const char *name, unsigned int n_bodies, unsigned int frames)
+{
+    World w;
+    world_create(&w, -9.8f);
+    world_set_broadphase(&w, type);
+    scene_scattered(&w, n_bodies);
+
+    unsigned long pairs_tested = 0;
+    unsigned long candidate_pairs = 0;
+    double start = timer_now();
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        pairs_tested += w.stats.n_pairs_tested;
+        candidate_pairs += w.stats.n_candidate_pairs;
+    }
+    double elapsed = timer_now() - start;
+
+    printf("%-14s %8u %16lu %12lu %14.3f\n", name, n_bodies, pairs_tested / frames, candidate_pairs / frames, 1000.0 * elapsed / frames);
+
+    world_destroy(&w);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int frames = (argc > 1) ? (unsigned int)atoi(argv[1]) : 5;
+    unsigned int sizes[3] = {1000, 10000, 50000};
+
+    printf("%-14s %8s %16s %12s %14s\n", "broadphase", "bodies", "pairs tested", "candidates", "ms per frame");
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        bench(BROADPHASE_BRUTE_FORCE, "brute force", sizes[i], frames);
+        bench(BROADPHASE_SPATIAL_HASH, "spatial hash", sizes[i], frames);
+        bench(BROADPHASE_SWEEP_AND_PRUNE, "sweep prune", sizes[i], frames);
+    }
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+// gcc -std=c99 -O2 -pthread bench_coloring.c -lm -o bench_coloring
+// ./bench_coloring [max threads] [frames]
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../world.h"
+#include "../timer.h"
+#include "scenes.h"
+
+// one pyramid, a single island of base * (base + 1) / 2 boxes, rows start slightly
+// overlapping so every contact exists from the first step
+void scene_single_pyramid(World *w, unsigned int base)
+{
+    float size = 20;
+    float floor_y = base * size + 100;
+    scene_box(w, base * size, floor_y + 25, base * size * 4, 50, 0.0);
+
+    for (unsigned int row = 0; row < base; row++)
+    {
+        for (unsigned int i = 0; i < base - row; i++)
+        {
+            float x = base * size / 2 + (row * 0.5f + i) * (size + 1.0f);
+            scene_box(w, x, floor_y - size / 2 + 0.1f - row * (size - 0.1f), size, size, 1.0);
+        }
+    }
+}
+
+void bench(const char *name, unsigned int coloring_threshold, ContactSolver solver, unsigned int n_threads, unsigned int base, unsigned int frames, double *serial)
+{
+    World w;
+    world_create(&w, -9.8f);
+    world_set_workers(&w, n_threads - 1);
+    w.allow_sleeping = false;
+    w.coloring_threshold = coloring_threshold;
+    w.contact_solver = solver;
+    scene_single_pyramid(&w, base);
+
+    // the first step has no manifolds to warm start from
+    world_update(&w, 1.0f / 60.0f);
+
+    double solver_time = 0;
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        solver_time += w.stats.solver_time;
+    }
+
+    double ms = 1000.0 * solver_time / frames;
+    if (n_threads == 1)
+        *serial = ms;
+    printf("%-8s %8u %8lu %10lu %16.3f %14.3f %10.2f\n", name, n_threads, w.stats.n_colors, w.stats.n_colored_constraints + w.stats.n_overflow_constraints, ms, ms / w.constraint_iterations, *serial / ms);
+
+    world_destroy(&w);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int max_threads = (argc > 1) ? (unsigned int)atoi(argv[1]) : 8;
+    unsigned int frames = (argc > 2) ? (unsigned int)atoi(argv[2]) : 20;
+    unsigned int base = 141;
+
+    printf("pyramid of %u boxes, %u frames\n", base * (base + 1) / 2, frames);
+    printf("%-8s %8s %8s %10s %16s %14s %10s\n", "solver", "threads", "colors", "colored", "solver ms/frame", "ms/iteration", "speedup");
+
+    double serial = 0;
+    for (unsigned int n_threads = 1; n_threads <= max_threads; n_threads *= 2)
+    {
+        bench("islands", UINT_MAX, CONTACT_SOLVER_SCALAR, n_threads, base, frames, &serial);
+    }
+    for (unsigned int n_threads = 1; n_threads <= max_threads; n_threads *= 2)
+    {
+        bench("colors", 512, CONTACT_SOLVER_SCALAR, n_threads, base, frames, &serial);
+    }
+    for (unsigned int n_threads = 1; n_threads <= max_threads; n_threads *= 2)
+    {
+        bench("rows", 512, CONTACT_SOLVER_SIMD, n_threads, base, frames, &serial);
+    }
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+// gcc -std=c99 -O2 -pthread bench_constraint_solve.c -lm -o bench_constraint_solve
+// ./bench_constraint_solve [constraints] [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../world.h"
+#include "../timer.h"
+#include "scenes.h"
+
+// pairs of boxes resting on each other, bodies[2 * i] on top of bodies[2 * i + 1]
+void setup_bodies(Body *bodies, unsigned int n_pairs)
+{
+    scene_seed = 12345;
+    for (unsigned int i = 0; i < n_pairs; i++)
+    {
+        float x = scene_random(0, 2000);
+        float y = scene_random(0, 2000);
+        bodies[2 * i] = body_create(box_create(40, 40), x + scene_random(-5, 5), y - 39.5f, 1.0);
+        bodies[2 * i + 1] = body_create(box_create(40, 40), x, y, scene_random(0, 1) < 0.25f ? 0.0 : 1.0);
+        for (unsigned int k = 0; k < 2; k++)
+        {
+            Body *b = &bodies[2 * i + k];
+            b->friction = 0.5;
+            b->restitution = 0.0;
+            b->velocity = (Vec2){.x = scene_random(-20, 20), .y = scene_random(-20, 20)};
+            b->omega = scene_random(-1, 1);
+        }
+    }
+}
+
+// nanoseconds per solve of one constraint, over iterations sweeps of all of them
+double bench_contacts(unsigned int n_pairs, unsigned int iterations)
+{
+    Body *bodies = malloc(2 * n_pairs * sizeof(Body));
+    PenetrationConstraint *contacts = malloc(n_pairs * sizeof(PenetrationConstraint));
+    setup_bodies(bodies, n_pairs);
+
+    for (unsigned int i = 0; i < n_pairs; i++)
+    {
+        Body *a = &bodies[2 * i];
+        Body *b = &bodies[2 * i + 1];
+        Vec2 pa = vec2_add(a->position, (Vec2){.x = -15, .y = 20.5f});
+        Vec2 pb = vec2_add(b->position, (Vec2){.x = -15, .y = -20});
+        penetration_constraint_create(&contacts[i], a, b, pa, pb, (Vec2){.x = 0, .y = 1});
+        penetration_constraint_pre_solve(&contacts[i], 1.0f / 60.0f, 0.2f);
+    }
+
+    double start = timer_now();
+    for (unsigned int iter = 0; iter < iterations; iter++)
+    {
+        for (unsigned int i = 0; i < n_pairs; i++)
+        {
+            penetration_constraint_solve(&contacts[i]);
+        }
+    }
+    double ns = 1e9 * (timer_now() - start) / ((double)iterations * n_pairs);
+
+    free(contacts);
+    free(bodies);
+    return ns;
+}
+
+double bench_joints(unsigned int n_pairs, unsigned int iterations)
+{
+    Body *bodies = malloc(2 * n_pairs * sizeof(Body));
+    JointConstraint *joints = malloc(n_pairs * sizeof(JointConstraint));
+    setup_bodies(bodies, n_pairs);
+
+    for (unsigned int i = 0; i < n_pairs; i++)
+    {
+        Body *a = &bodies[2 * i];
+        Body *b = &bodies[2 * i + 1];
+        joint_constraint_create(&joints[i], a, b, vec2_scale(vec2_add(a->position, b->position), 0.5f));
+        joint_constraint_pre_solve(&joints[i], 1.0f / 60.0f, 0.1f);
+    }
+
+    double start = timer_now();
+    for (unsigned int iter = 0; iter < iterations; iter++)
+    {
+        for (unsigned int i = 0; i < n_pairs; i++)
+        {
+            joint_constraint_solve(&joints[i]);
+        }
+    }
+    double ns = 1e9 * (timer_now() - start) / ((double)iterations * n_pairs);
+
+    free(joints);
+    free(bodies);
+    return ns;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int n_constraints = (argc > 1) ? (unsigned int)atoi(argv[1]) : 4096;
+    unsigned int iterations = (argc > 2) ? (unsigned int)atoi(argv[2]) : 200;
+
+    printf("%u constraints, %u iterations\n", n_constraints, iterations);
+    printf("%-12s %14s %18s\n", "constraint", "ns/solve", "Msolves/s");
+
+    double ns = bench_contacts(n_constraints, iterations);
+    printf("%-12s %14.1f %18.2f\n", "penetration", ns, 1e3 / ns);
+    ns = bench_joints(n_constraints, iterations);
+    printf("%-12s %14.1f %18.2f\n", "joint", ns, 1e3 / ns);
+
+    return 0;
+}
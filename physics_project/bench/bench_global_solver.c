@@ -0,0 +1,74 @@
+// gcc -std=c99 -O2 -pthread bench_global_solver.c -lm -o bench_global_solver
+// ./bench_global_solver [stacks] [height] [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../world.h"
+#include "../timer.h"
+#include "scenes.h"
+
+// side by side stacks of boxes on one floor
+void scene_stacks(World *w, unsigned int n_stacks, unsigned int height)
+{
+    float size = 20;
+    float floor_y = height * size + 100;
+    scene_box(w, n_stacks * size, floor_y + 25, n_stacks * size * 4, 50, 0.0);
+    for (unsigned int s = 0; s < n_stacks; s++)
+    {
+        for (unsigned int i = 0; i < height; i++)
+        {
+            scene_box(w, s * size * 2, floor_y - size / 2 - i * (size + 0.5f), size, size, 1.0);
+        }
+    }
+}
+
+// sweeps is both the per-constraint passes and the PGS sweeps
+void bench(const char *name, bool global_solver, unsigned int sweeps, unsigned int n_stacks, unsigned int height, unsigned int frames)
+{
+    World w;
+    world_create(&w, -9.8f);
+    w.allow_sleeping = false;
+    w.global_solver = global_solver;
+    w.constraint_iterations = sweeps;
+    w.gauss_seidel_iterations = sweeps;
+    scene_stacks(&w, n_stacks, height);
+
+    double pre_solve = 0, solve = 0;
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        pre_solve += w.stats.stage_time[WORLD_STAGE_PRE_SOLVE];
+        solve += w.stats.stage_time[WORLD_STAGE_SOLVE];
+    }
+
+    // how far the tops of the stacks are below where they started, toppled stacks count
+    float size = 20;
+    float floor_y = height * size + 100;
+    float sink = 0;
+    for (unsigned int s = 0; s < n_stacks; s++)
+    {
+        Body *top = &w.body_pool.bodies[1 + s * height + height - 1];
+        sink += top->position.y - (floor_y - size / 2 - (height - 1) * size);
+    }
+
+    printf("%-16s %8u %10lu %10u %12u %14.3f %10.3f %12.2f\n", name, sweeps, w.stats.n_contacts, global_solver ? w.system.jacobian.m : 0, global_solver ? w.system.lhs.nnz : 0,
+           1000.0 * pre_solve / frames, 1000.0 * solve / frames, sink / n_stacks);
+    world_destroy(&w);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int n_stacks = (argc > 1) ? (unsigned int)atoi(argv[1]) : 50;
+    unsigned int height = (argc > 2) ? (unsigned int)atoi(argv[2]) : 20;
+    unsigned int frames = (argc > 3) ? (unsigned int)atoi(argv[3]) : 120;
+
+    printf("%u stacks of %u boxes, %u frames\n", n_stacks, height, frames);
+    printf("%-16s %8s %10s %10s %12s %14s %10s %12s\n", "solver", "sweeps", "contacts", "rows", "lhs entries", "pre-solve ms", "solve ms", "sink px");
+    for (unsigned int sweeps = 5; sweeps <= 20; sweeps *= 2)
+    {
+        bench("per constraint", false, sweeps, n_stacks, height, frames);
+        bench("global pgs", true, sweeps, n_stacks, height, frames);
+    }
+
+    return 0;
+}
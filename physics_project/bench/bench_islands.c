@@ -0,0 +1,56 @@
+// gcc -std=c99 -O2 -pthread bench_islands.c -lm -o bench_islands
+// ./bench_islands [max threads] [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../world.h"
+#include "../timer.h"
+#include "scenes.h"
+
+double bench(unsigned int n_threads, unsigned int n_piles, unsigned int frames, float *checksum)
+{
+    World w;
+    world_create(&w, -9.8f);
+    world_set_workers(&w, n_threads - 1);
+    w.allow_sleeping = false;
+    scene_piles(&w, n_piles, 5);
+
+    double solver_time = 0;
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        solver_time += w.stats.solver_time;
+    }
+
+    *checksum = 0;
+    for (unsigned int i = 0; i < w.body_pool.n_bodies; i++)
+    {
+        Body *b = &w.body_pool.bodies[i];
+        *checksum += b->position.x + b->position.y + b->theta;
+    }
+
+    world_destroy(&w);
+    return 1000.0 * solver_time / frames;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int max_threads = (argc > 1) ? (unsigned int)atoi(argv[1]) : 8;
+    unsigned int frames = (argc > 2) ? (unsigned int)atoi(argv[2]) : 60;
+    unsigned int n_piles = 2000;
+
+    printf("%u piles of 5 boxes, %u frames\n", n_piles, frames);
+    printf("%8s %16s %10s %16s\n", "threads", "solver ms/frame", "speedup", "checksum");
+
+    double serial = 0;
+    for (unsigned int n_threads = 1; n_threads <= max_threads; n_threads *= 2)
+    {
+        float checksum;
+        double ms = bench(n_threads, n_piles, frames, &checksum);
+        if (n_threads == 1)
+            serial = ms;
+        printf("%8u %16.3f %10.2f %16.4f\n", n_threads, ms, serial / ms, checksum);
+    }
+
+    return 0;
+}
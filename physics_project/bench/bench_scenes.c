@@ -0,0 +1,180 @@
+// gcc -std=c99 -O2 -pthread bench_scenes.c -lm -o bench_scenes
+// ./bench_scenes [csv|json] [frames] [threads] [scene|all] [trace file]
+// steps each standard scene of scenes.h, or only the one named, for a fixed number of frames
+// and prints one record per scene, to keep the output of a baseline and diff against it.
+// Built with -DDEBUG_TRACE it writes the last frames as Chrome trace JSON to the trace file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../world.h"
+#include "../timer.h"
+#include "../trace.h"
+#include "scenes.h"
+
+typedef struct
+{
+    const char *scene;
+    unsigned int n_bodies;
+    unsigned int n_joints;
+    // ms per frame of the whole world_update and of each stage
+    double total_ms;
+    double stage_ms[WORLD_STAGE_COUNT];
+    // per frame
+    double contacts;
+    double pairs_tested;
+    double manifolds;
+    double solver_iterations;
+    // heap allocations while stepping, the building of the scene left out
+    unsigned long heap_calls;
+    unsigned long heap_bytes;
+    // sum of the final body positions and angles, differs when the simulation does
+    double checksum;
+} SceneResult;
+
+SceneResult bench(Scene *scene, unsigned int n_threads, unsigned int frames)
+{
+    SceneResult r;
+    memset(&r, 0, sizeof(r));
+    r.scene = scene->name;
+
+    World w;
+    scene_build(scene, &w);
+    world_set_workers(&w, n_threads - 1);
+    // sleeping would leave most of the frames with nothing to do
+    w.allow_sleeping = false;
+
+    r.n_bodies = w.body_pool.n_bodies;
+    for (Node *n = w.joint_constraints.start; n; n = n->next)
+    {
+        r.n_joints++;
+    }
+
+    unsigned long heap_calls = mem_log.heap_memory_calls;
+    unsigned long heap_bytes = mem_log.heap_memory_allocated;
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        double start = timer_now();
+        world_update(&w, 1.0f / 60.0f);
+        r.total_ms += 1000.0 * (timer_now() - start) / frames;
+        for (unsigned int s = 0; s < WORLD_STAGE_COUNT; s++)
+        {
+            r.stage_ms[s] += 1000.0 * w.stats.stage_time[s] / frames;
+        }
+        r.contacts += (double)w.stats.n_contacts / frames;
+        r.pairs_tested += (double)w.stats.n_pairs_tested / frames;
+        r.manifolds += (double)w.stats.n_manifolds / frames;
+        r.solver_iterations += (double)w.stats.n_solver_iterations / frames;
+    }
+    r.heap_calls = mem_log.heap_memory_calls - heap_calls;
+    r.heap_bytes = mem_log.heap_memory_allocated - heap_bytes;
+
+    for (unsigned int i = 0; i < w.body_pool.n_bodies; i++)
+    {
+        Body *b = &w.body_pool.bodies[i];
+        r.checksum += b->position.x + b->position.y + b->theta;
+    }
+
+    world_destroy(&w);
+    return r;
+}
+
+// stage name as a column or key, "pre-solve" as pre_solve
+void print_stage_key(unsigned int stage)
+{
+    for (const char *c = world_stage_names[stage]; *c; c++)
+    {
+        putchar((*c == ' ' || *c == '-') ? '_' : *c);
+    }
+}
+
+void print_csv_header()
+{
+    printf("scene,threads,frames,bodies,joints,total_ms");
+    for (unsigned int s = 0; s < WORLD_STAGE_COUNT; s++)
+    {
+        putchar(',');
+        print_stage_key(s);
+        printf("_ms");
+    }
+    printf(",contacts,pairs_tested,manifolds,solver_iterations,heap_calls,heap_bytes,checksum\n");
+}
+
+void print_csv(SceneResult *r, unsigned int n_threads, unsigned int frames)
+{
+    printf("%s,%u,%u,%u,%u,%.4f", r->scene, n_threads, frames, r->n_bodies, r->n_joints, r->total_ms);
+    for (unsigned int s = 0; s < WORLD_STAGE_COUNT; s++)
+    {
+        printf(",%.4f", r->stage_ms[s]);
+    }
+    printf(",%.1f,%.1f,%.1f,%.1f,%lu,%lu,%.4f\n", r->contacts, r->pairs_tested, r->manifolds, r->solver_iterations, r->heap_calls, r->heap_bytes, r->checksum);
+}
+
+void print_json(SceneResult *r, unsigned int n_threads, unsigned int frames, bool last)
+{
+    printf("  {\"scene\": \"%s\", \"threads\": %u, \"frames\": %u, \"bodies\": %u, \"joints\": %u, \"total_ms\": %.4f,\n", r->scene, n_threads, frames, r->n_bodies,
+           r->n_joints, r->total_ms);
+    printf("   \"stage_ms\": {");
+    for (unsigned int s = 0; s < WORLD_STAGE_COUNT; s++)
+    {
+        printf("%s\"", s ? ", " : "");
+        print_stage_key(s);
+        printf("\": %.4f", r->stage_ms[s]);
+    }
+    printf("},\n");
+    printf("   \"contacts\": %.1f, \"pairs_tested\": %.1f, \"manifolds\": %.1f, \"solver_iterations\": %.1f, \"heap_calls\": %lu, \"heap_bytes\": %lu, "
+           "\"checksum\": %.4f}%s\n",
+           r->contacts, r->pairs_tested, r->manifolds, r->solver_iterations, r->heap_calls, r->heap_bytes, r->checksum, last ? "" : ",");
+}
+
+int main(int argc, char *argv[])
+{
+    bool json = (argc > 1) && strcmp(argv[1], "json") == 0;
+    unsigned int frames = (argc > 2) ? (unsigned int)atoi(argv[2]) : 300;
+    unsigned int n_threads = (argc > 3) ? (unsigned int)atoi(argv[3]) : 1;
+    const char *only = (argc > 4 && strcmp(argv[4], "all") != 0) ? argv[4] : NULL;
+    const char *trace_file = (argc > 5) ? argv[5] : NULL;
+
+    unsigned int n_selected = 0;
+    for (unsigned int i = 0; i < SCENE_COUNT; i++)
+    {
+        n_selected += !only || strcmp(only, scenes[i].name) == 0;
+    }
+    if (n_selected == 0)
+    {
+        fprintf(stderr, "no scene %s, the scenes are:", only);
+        for (unsigned int i = 0; i < SCENE_COUNT; i++)
+        {
+            fprintf(stderr, " %s", scenes[i].name);
+        }
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    if (json)
+        printf("[\n");
+    else
+        print_csv_header();
+
+    for (unsigned int i = 0, done = 0; i < SCENE_COUNT; i++)
+    {
+        if (only && strcmp(only, scenes[i].name) != 0)
+            continue;
+        SceneResult r = bench(&scenes[i], n_threads, frames);
+        if (json)
+            print_json(&r, n_threads, frames, ++done == n_selected);
+        else
+            print_csv(&r, n_threads, frames);
+        fflush(stdout);
+    }
+
+    if (json)
+        printf("]\n");
+
+    if (trace_file && !trace_write_chrome_json(trace_file))
+    {
+        fprintf(stderr, "could not write %s\n", trace_file);
+        return 1;
+    }
+    return 0;
+}
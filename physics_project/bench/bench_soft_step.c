@@ -0,0 +1,86 @@
+// gcc -std=c99 -O2 -pthread bench_soft_step.c -lm -o bench_soft_step
+// ./bench_soft_step [stacks] [height] [frames]
+// stack height stability against solver time, the soft step at 1 to 4 substeps each after
+// Baumgarte at four iterations per substep, which costs about the same
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../world.h"
+#include "../timer.h"
+#include "scenes.h"
+
+// side by side stacks of boxes on one floor, far enough apart to be islands of their own
+void scene_stacks(World *w, unsigned int n_stacks, unsigned int height)
+{
+    float size = 40;
+    float floor_y = height * size + 100;
+    scene_box(w, n_stacks * size * 1.5f, floor_y + 25, n_stacks * size * 4, 50, 0.0);
+    for (unsigned int s = 0; s < n_stacks; s++)
+    {
+        for (unsigned int i = 0; i < height; i++)
+        {
+            scene_box(w, s * size * 3, floor_y - size / 2 - i * (size + 0.5f), size, size, 1.0);
+        }
+    }
+}
+
+// count is constraint iterations with Baumgarte and substeps with the soft step
+void bench(SolverMode mode, unsigned int count, unsigned int n_stacks, unsigned int height, unsigned int frames)
+{
+    World w;
+    world_create(&w, -9.8f);
+    w.allow_sleeping = false;
+    w.solver_mode = mode;
+    w.constraint_iterations = count;
+    w.substeps = count;
+    scene_stacks(&w, n_stacks, height);
+
+    // jitter is the fastest a top box still moves over the last half of the frames
+    double solve = 0;
+    float jitter = 0;
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        solve += w.stats.stage_time[WORLD_STAGE_INTEGRATE_FORCES] + w.stats.stage_time[WORLD_STAGE_PRE_SOLVE] + w.stats.stage_time[WORLD_STAGE_SOLVE] +
+                 w.stats.stage_time[WORLD_STAGE_INTEGRATE_VELOCITIES];
+        for (unsigned int s = 0; frame >= frames / 2 && s < n_stacks; s++)
+        {
+            Body *top = &w.body_pool.bodies[1 + s * height + height - 1];
+            jitter = MAX(jitter, vec2_norm(top->velocity));
+        }
+    }
+
+    // how far the tops of the stacks sank and slid from where they started, toppled stacks count
+    float size = 40;
+    float floor_y = height * size + 100;
+    float sink = 0, slide = 0;
+    unsigned int toppled = 0;
+    for (unsigned int s = 0; s < n_stacks; s++)
+    {
+        Body *top = &w.body_pool.bodies[1 + s * height + height - 1];
+        sink += top->position.y - (floor_y - size / 2 - (height - 1) * (size + 0.5f));
+        slide += fabsf(top->position.x - s * size * 3);
+        toppled += fabsf(top->position.x - s * size * 3) > size / 2;
+    }
+
+    printf("%-10s %8u %12.3f %10.2f %10.2f %10.2f %10u\n", mode == SOLVER_MODE_SOFT_STEP ? "soft step" : "baumgarte", count, 1000.0 * solve / frames, sink / n_stacks,
+           slide / n_stacks, jitter, toppled);
+    world_destroy(&w);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int n_stacks = (argc > 1) ? (unsigned int)atoi(argv[1]) : 20;
+    unsigned int height = (argc > 2) ? (unsigned int)atoi(argv[2]) : 12;
+    unsigned int frames = (argc > 3) ? (unsigned int)atoi(argv[3]) : 300;
+
+    printf("%u stacks of %u boxes, %u frames\n", n_stacks, height, frames);
+    printf("%-10s %8s %12s %10s %10s %10s %10s\n", "solver", "passes", "solver ms", "sink px", "slide px", "jitter", "toppled");
+    for (unsigned int substeps = 1; substeps <= 4; substeps++)
+    {
+        bench(SOLVER_MODE_BAUMGARTE, 4 * substeps, n_stacks, height, frames);
+        bench(SOLVER_MODE_SOFT_STEP, substeps, n_stacks, height, frames);
+    }
+
+    return 0;
+}
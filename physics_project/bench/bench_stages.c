@@ -0,0 +1,124 @@
+// gcc -std=c99 -O2 -pthread bench_stages.c -lm -o bench_stages
+// ./bench_stages [max threads] [frames] [piles]
+
+#define _GNU_SOURCE
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "../world.h"
+#include "../timer.h"
+#include "scenes.h"
+
+// counts the last level cache misses of this process from here on, -1 if perf events are not
+// available (no permission, or inside a container)
+int perf_open_cache_misses()
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.inherit = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+long long perf_read(int fd)
+{
+    long long count = 0;
+    if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count))
+        return -1;
+    return count;
+}
+
+// milliseconds per frame of every stage and of the whole world_update
+void bench(unsigned int n_threads, unsigned int n_piles, unsigned int frames, double stage_ms[WORLD_STAGE_COUNT], double *total_ms, long long *cache_misses)
+{
+    World w;
+    world_create(&w, -9.8f);
+    world_set_workers(&w, n_threads - 1);
+    w.allow_sleeping = false;
+    scene_piles(&w, n_piles, 5);
+
+    for (unsigned int s = 0; s < WORLD_STAGE_COUNT; s++)
+    {
+        stage_ms[s] = 0;
+    }
+
+    int perf = perf_open_cache_misses();
+    long long misses_start = perf_read(perf);
+    double start = timer_now();
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        for (unsigned int s = 0; s < WORLD_STAGE_COUNT; s++)
+        {
+            stage_ms[s] += 1000.0 * w.stats.stage_time[s] / frames;
+        }
+    }
+    *total_ms = 1000.0 * (timer_now() - start) / frames;
+    *cache_misses = (perf >= 0) ? (perf_read(perf) - misses_start) / frames : -1;
+    if (perf >= 0)
+        close(perf);
+
+    world_destroy(&w);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int max_threads = (argc > 1) ? (unsigned int)atoi(argv[1]) : 8;
+    unsigned int frames = (argc > 2) ? (unsigned int)atoi(argv[2]) : 60;
+    unsigned int n_piles = (argc > 3) ? (unsigned int)atoi(argv[3]) : 2000;
+
+    printf("%u piles of 5 boxes, %u frames, ms/frame per stage\n", n_piles, frames);
+    printf("%-22s", "threads");
+    for (unsigned int n_threads = 1; n_threads <= max_threads; n_threads *= 2)
+    {
+        printf(" %10u", n_threads);
+    }
+    printf("\n");
+
+    unsigned int n_runs = 0;
+    double stage_ms[8][WORLD_STAGE_COUNT];
+    double total_ms[8];
+    long long cache_misses[8];
+    for (unsigned int n_threads = 1; n_threads <= max_threads && n_runs < 8; n_threads *= 2, n_runs++)
+    {
+        bench(n_threads, n_piles, frames, stage_ms[n_runs], &total_ms[n_runs], &cache_misses[n_runs]);
+    }
+
+    // stages overlap in the task graph, so they need not add up to the total
+    for (unsigned int s = 0; s < WORLD_STAGE_COUNT; s++)
+    {
+        printf("%-22s", world_stage_names[s]);
+        for (unsigned int r = 0; r < n_runs; r++)
+        {
+            printf(" %10.3f", stage_ms[r][s]);
+        }
+        printf("\n");
+    }
+
+    printf("%-22s", "world_update");
+    for (unsigned int r = 0; r < n_runs; r++)
+    {
+        printf(" %10.3f", total_ms[r]);
+    }
+    printf("\n%-22s", "cache misses/frame");
+    for (unsigned int r = 0; r < n_runs; r++)
+    {
+        if (cache_misses[r] < 0)
+            printf(" %10s", "n/a");
+        else
+            printf(" %10lld", cache_misses[r]);
+    }
+    printf("\n%-22s", "speedup");
+    for (unsigned int r = 0; r < n_runs; r++)
+    {
+        printf(" %10.2f", total_ms[0] / total_ms[r]);
+    }
+    printf("\n");
+
+    return 0;
+}
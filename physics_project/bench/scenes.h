@@ -0,0 +1,212 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+// The standard scenes the benchmarks step. Each one is built the same way every time, random
+// sizes and offsets come from scene_random with a fixed seed, so two runs of a scene simulate
+// the same bodies and differ only in how fast they go.
+
+#include "../world.h"
+
+typedef struct
+{
+    const char *name;
+    void (*build)(World *w);
+} Scene;
+
+// linear congruential generator, rand() differs between C libraries
+unsigned int scene_seed = 1;
+
+float scene_random(float min, float max)
+{
+    scene_seed = scene_seed * 1664525u + 1013904223u;
+    return min + (max - min) * (float)(scene_seed >> 8) / (float)(1u << 24);
+}
+
+BodyHandle scene_add(World *w, Shape shape, float x, float y, float mass)
+{
+    Body b = body_create(shape, x, y, mass);
+    b.friction = 0.5;
+    b.restitution = (mass == 0.0) ? 0.1 : 0.2;
+    return world_add_body(w, b);
+}
+
+// box with friction that does not bounce, what the stacking benchmarks are built from
+BodyHandle scene_box(World *w, float x, float y, float width, float height, float mass)
+{
+    Body b = body_create(box_create(width, height), x, y, mass);
+    b.friction = 0.5;
+    b.restitution = 0.0;
+    return world_add_body(w, b);
+}
+
+// rows of separate piles resting on floors, every pile is its own island
+void scene_piles(World *w, unsigned int n_piles, unsigned int pile_height)
+{
+    unsigned int piles_per_row = 100;
+    unsigned int rows = (n_piles + piles_per_row - 1) / piles_per_row;
+    float row_height = pile_height * 41 + 100;
+
+    for (unsigned int r = 0; r < rows; r++)
+    {
+        float floor_y = (r + 1) * row_height;
+        scene_box(w, piles_per_row * 50, floor_y + 25, piles_per_row * 100, 50, 0.0);
+        for (unsigned int p = 0; p < piles_per_row && r * piles_per_row + p < n_piles; p++)
+        {
+            for (unsigned int i = 0; i < pile_height; i++)
+            {
+                scene_box(w, 50 + p * 100 + (i % 2) * 2, floor_y - 20 - i * 40.5f, 40, 40, 1.0);
+            }
+        }
+    }
+}
+
+// floor with walls either side, width wide and its top at y
+void scene_container(World *w, float x, float y, float width, float wall_height)
+{
+    scene_add(w, box_create(width, 50), x, y + 25, 0.0);
+    scene_add(w, box_create(50, wall_height), x - width / 2 - 25, y - wall_height / 2, 0.0);
+    scene_add(w, box_create(50, wall_height), x + width / 2 + 25, y - wall_height / 2, 0.0);
+}
+
+// 5 pyramids of 40 px boxes 20 at the base side by side on one floor, 1050 boxes. Each is
+// one island big enough to be colored. Bigger pyramids or bouncier boxes collapse with the
+// default solver settings.
+void scene_pyramid(World *w)
+{
+    unsigned int n_pyramids = 5, base = 20;
+    float size = 40;
+    float floor_y = base * size + 100;
+    float pyramid_width = (base + 2) * size;
+    scene_add(w, box_create(n_pyramids * pyramid_width + 400, 50), n_pyramids * pyramid_width / 2, floor_y + 25, 0.0);
+    for (unsigned int p = 0; p < n_pyramids; p++)
+    {
+        for (unsigned int row = 0; row < base; row++)
+        {
+            for (unsigned int i = 0; i < base - row; i++)
+            {
+                float x = p * pyramid_width + (row + 2 * i) * size / 2 + size;
+                BodyHandle h = scene_add(w, box_create(size, size), x, floor_y - size / 2 - row * size, 1.0);
+                world_get_body(w, h)->restitution = 0.0;
+            }
+        }
+    }
+}
+
+// 2000 circles of random sizes dropped into a container in loose rows
+void scene_circle_rain(World *w)
+{
+    unsigned int n = 2000, per_row = 50;
+    float spacing = 40;
+    float width = per_row * spacing;
+    scene_container(w, width / 2, 3000, width + 40, 3000);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        float x = 20 + (i % per_row) * spacing + scene_random(-5, 5);
+        float y = 2900 - (i / per_row) * spacing * 1.5f;
+        scene_add(w, circle_create(scene_random(8, 18)), x, y, 1.0);
+    }
+}
+
+// 100 chains of 10 links hanging from static pins, the links made of a box and circles like
+// the chain of app_setup, let go level so they swing down and fold up against themselves.
+// Longer chains stretch out a lot under their own weight with the default iterations.
+void scene_chains(World *w)
+{
+    unsigned int n_chains = 100, n_links = 10;
+    float link_length = 30, spacing = n_links * link_length + 100;
+    for (unsigned int c = 0; c < n_chains; c++)
+    {
+        float x = c * spacing;
+        BodyHandle previous = scene_add(w, circle_create(10), x, 100, 0.0);
+        Vec2 anchor = (Vec2){.x = x, .y = 100};
+        for (unsigned int l = 1; l <= n_links; l++)
+        {
+            Vec2 position = (Vec2){.x = x + l * link_length, .y = 100};
+            Shape shape = (l % 3 == 1) ? box_create(link_length * 0.8f, 10) : circle_create(8);
+            BodyHandle link = scene_add(w, shape, position.x, position.y, 1.0);
+            world_add_joint(w, previous, link, anchor);
+            previous = link;
+            anchor = position;
+        }
+    }
+}
+
+// regular polygon of n sides on a circle of the given radius
+Shape scene_regular_polygon(unsigned int n, float radius)
+{
+    Vec2 vertices[8];
+    for (unsigned int i = 0; i < n; i++)
+    {
+        float angle = 2.0f * M_PI * i / n;
+        vertices[i] = (Vec2){.x = radius * cosf(angle), .y = radius * sinf(angle)};
+    }
+    return polygon_create(vertices, n);
+}
+
+// 1500 boxes, circles, triangles to octagons and the pentagon of the app, mixed in a container
+void scene_polygons(World *w)
+{
+    unsigned int n = 1500, per_row = 40;
+    float spacing = 50;
+    float width = per_row * spacing;
+    scene_container(w, width / 2, 3000, width + 40, 3000);
+    Vec2 pentagon[5] = {{.x = 10, .y = 30}, {.x = -20, .y = 10}, {.x = -10, .y = -30}, {.x = 10, .y = -30}, {.x = 20, .y = 10}};
+    for (unsigned int i = 0; i < n; i++)
+    {
+        float x = 25 + (i % per_row) * spacing;
+        float y = 2900 - (i / per_row) * spacing * 1.5f;
+        unsigned int kind = (unsigned int)scene_random(0, 8);
+        Shape shape;
+        if (kind == 0)
+            shape = box_create(scene_random(15, 35), scene_random(15, 35));
+        else if (kind == 1)
+            shape = circle_create(scene_random(8, 18));
+        else if (kind == 2)
+            shape = polygon_create(pentagon, 5);
+        else
+            shape = scene_regular_polygon(kind + 1, scene_random(12, 20));
+        BodyHandle h = scene_add(w, shape, x, y, 1.0);
+        world_get_body(w, h)->theta = scene_random(0, 2.0f * M_PI);
+    }
+}
+
+// a bumpy floor of 4000 static tiles walled in at the ends and 500 bodies falling onto it
+// here and there, most of the bodies never move
+void scene_static_floor(World *w)
+{
+    unsigned int n_tiles = 4000, n_falling = 500;
+    float tile = 50;
+    for (unsigned int i = 0; i < n_tiles; i++)
+    {
+        scene_add(w, box_create(tile, tile), i * tile, 2000 - (i % 7) * 4.0f, 0.0);
+    }
+    scene_add(w, box_create(tile, 1000), -tile, 1500, 0.0);
+    scene_add(w, box_create(tile, 1000), n_tiles * tile, 1500, 0.0);
+    for (unsigned int i = 0; i < n_falling; i++)
+    {
+        float x = scene_random(0, n_tiles * tile);
+        float y = scene_random(1500, 1800);
+        Shape shape = (i % 2) ? circle_create(scene_random(10, 20)) : box_create(scene_random(20, 40), scene_random(20, 40));
+        scene_add(w, shape, x, y, 1.0);
+    }
+}
+
+Scene scenes[] = {
+    {"pyramid", scene_pyramid},
+    {"circle_rain", scene_circle_rain},
+    {"chains", scene_chains},
+    {"polygons", scene_polygons},
+    {"static_floor", scene_static_floor},
+};
+
+#define SCENE_COUNT (sizeof(scenes) / sizeof(scenes[0]))
+
+// builds the scene into a new world, the same bodies in the same order every time
+void scene_build(Scene *scene, World *w)
+{
+    world_create(w, -9.8f);
+    scene_seed = 1;
+    scene->build(w);
+}
+
+#endif
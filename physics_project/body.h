@@ -1,22 +1,36 @@
 #ifndef BODY_H
 #define BODY_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "vec2.h"
 #include "shape.h"
-#include "graphics.h"
 
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
+// Stable name of a body in a world. Bodies move around in the world's array as others are
+// added and removed, a handle keeps finding the same body until it is removed.
+typedef struct
+{
+    unsigned int slot;
+    unsigned int generation;
+} BodyHandle;
+
+#define BODY_HANDLE_NULL ((BodyHandle){0xffffffffu, 0})
+
+// broadphase_proxy of a body the broadphase has not seen yet
+#define BODY_PROXY_NULL -1
 
 typedef struct
 {
     Vec2 position;
     Vec2 velocity;
-    Vec2 acceleration;
 
     float theta;
     float omega;
-    float alpha;
+
+    // where the body was before the last world step, to draw it between the last two steps
+    Vec2 previous_position;
+    float previous_theta;
 
     float mass;
     float inv_mass;
@@ -26,27 +40,37 @@ typedef struct
     float inv_inertia;
     float torque;
 
-    ShapeType shape_type;
-    void *shape;
+    Shape shape;
 
     float restitution;
     float friction;
 
-    SDL_Texture *texture;
+    // handle of the body in the broadphase structure, BODY_PROXY_NULL until it is first seen
+    int broadphase_proxy;
+
+    // sleeping bodies are skipped by integration and solving until their island is woken
+    bool is_awake;
+    float sleep_time;
+    // position of the body in the world's body array
+    unsigned int world_index;
+    BodyHandle handle;
+
+    // how the application draws the body, the physics leaves them alone
+    void *texture;
     uint8_t fill_color[3];
     bool has_fill_color;
 } Body;
 
 void body_clear_force(Body *);
 void body_clear_torque(Body *);
+void body_set_awake(Body *, bool);
 
-Body body_create(ShapeType shape_type, void *shape, float x_pos, float y_pos, float mass)
+Body body_create(Shape shape, float x_pos, float y_pos, float mass)
 {
     Body b;
 
     b.position = (Vec2){x_pos, y_pos};
     b.velocity = (Vec2){0, 0};
-    b.acceleration = (Vec2){0, 0};
 
     b.mass = mass;
     if (b.mass != 0.0)
@@ -61,11 +85,12 @@ Body body_create(ShapeType shape_type, void *shape, float x_pos, float y_pos, fl
 
     b.theta = 0;
     b.omega = 0;
-    b.alpha = 0;
 
-    b.shape_type = shape_type;
+    b.previous_position = b.position;
+    b.previous_theta = b.theta;
+
     b.shape = shape;
-    b.inertia = shape_moment_of_inertia(b.shape_type, b.shape) * b.mass;
+    b.inertia = shape_moment_of_inertia(&b.shape) * b.mass;
     if (b.inertia != 0.0)
     {
         b.inv_inertia = 1.0 / b.inertia;
@@ -79,7 +104,12 @@ Body body_create(ShapeType shape_type, void *shape, float x_pos, float y_pos, fl
     b.restitution = 1.0;
     b.friction = 0.0;
 
-    shape_update_vertices(b.theta, b.position, b.shape_type, b.shape);
+    b.broadphase_proxy = BODY_PROXY_NULL;
+
+    b.is_awake = true;
+    b.sleep_time = 0.0f;
+    b.world_index = 0;
+    b.handle = BODY_HANDLE_NULL;
 
     b.texture = NULL;
     b.has_fill_color = false;
@@ -87,16 +117,6 @@ Body body_create(ShapeType shape_type, void *shape, float x_pos, float y_pos, fl
     return b;
 }
 
-void body_set_texture(Body *b, char *texture_file_name)
-{
-    SDL_Surface *surface = IMG_Load(texture_file_name);
-    if (surface)
-    {
-        b->texture = SDL_CreateTextureFromSurface(gfx.renderer, surface);
-        SDL_FreeSurface(surface);
-    }
-}
-
 void body_set_fill_color(Body *b, uint8_t color[3])
 {
     b->has_fill_color = true;
@@ -105,6 +125,20 @@ void body_set_fill_color(Body *b, uint8_t color[3])
     b->fill_color[2] = color[2];
 }
 
+// position and angle alpha of the way from the previous step to the last, the angle turning
+// the short way across the wrap to [0, 2 pi)
+void body_interpolate(Body *b, float alpha, Vec2 *position, float *theta)
+{
+    *position = vec2_add(b->previous_position, vec2_scale(vec2_sub(b->position, b->previous_position), alpha));
+
+    float turn = b->theta - b->previous_theta;
+    if (turn > M_PI)
+        turn -= 2.0f * M_PI;
+    else if (turn < -M_PI)
+        turn += 2.0f * M_PI;
+    *theta = b->previous_theta + turn * alpha;
+}
+
 Vec2 body_local_to_global_space(Body *b, Vec2 point)
 {
     Vec2 rotated = vec2_rotate_rad(point, b->theta);
@@ -121,17 +155,21 @@ Vec2 body_global_to_local_space(Body *b, Vec2 point)
     return (Vec2){rotated_x, rotated_y};
 }
 
+AABB body_aabb(Body *b)
+{
+    return shape_aabb(&b->shape, b->position, b->theta);
+}
+
+// The world integrates all its bodies at once with body_state.h. These two integrate a single
+// body the same way and are kept only as the reference test_body_state checks that against.
 void body_integrate_forces(Body *b, float delta_time)
 {
     if (b->inv_mass == 0)
         return;
 
-    b->acceleration = vec2_scale(b->force, b->inv_mass);
-    Vec2 dv = vec2_scale(b->acceleration, delta_time);
-    b->velocity = vec2_add(b->velocity, dv);
-
-    b->alpha = b->torque * b->inv_inertia;
-    b->omega += b->alpha * delta_time;
+    Vec2 acceleration = vec2_scale(b->force, b->inv_mass);
+    b->velocity = vec2_add(b->velocity, vec2_scale(acceleration, delta_time));
+    b->omega += b->torque * b->inv_inertia * delta_time;
 
     body_clear_force(b);
     body_clear_torque(b);
@@ -148,12 +186,25 @@ void body_integrate_velocities(Body *b, float delta_time)
     b->theta += b->omega * delta_time;
     b->theta = (b->theta + 2.0 * M_PI);
     b->theta = fmodf(b->theta, 2.0 * M_PI);
+}
 
-    shape_update_vertices(b->theta, b->position, b->shape_type, b->shape);
+void body_set_awake(Body *b, bool awake)
+{
+    b->is_awake = awake;
+    b->sleep_time = 0.0f;
+    if (!awake)
+    {
+        b->velocity = (Vec2){.x = 0, .y = 0};
+        b->omega = 0.0f;
+        body_clear_force(b);
+        body_clear_torque(b);
+    }
 }
 
 void body_add_force(Body *b, Vec2 force)
 {
+    if (!b->is_awake)
+        body_set_awake(b, true);
     b->force = vec2_add(b->force, force);
 }
 
@@ -164,6 +215,8 @@ void body_clear_force(Body *b)
 
 void body_add_torque(Body *b, float torque)
 {
+    if (!b->is_awake)
+        body_set_awake(b, true);
     b->torque += torque;
 }
 
@@ -0,0 +1,106 @@
+#ifndef BODY_POOL_H
+#define BODY_POOL_H
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "body.h"
+#include "mem.h"
+
+typedef struct
+{
+    // index of the body in the dense array while the slot is used, next free slot otherwise
+    unsigned int dense;
+    // bumped when the body of the slot is removed, so old handles stop matching
+    unsigned int generation;
+} BodySlot;
+
+// Bodies packed in one array, removal moves the last body into the hole. Pointers to the
+// bodies are only good until the next add or remove, handles stay good until the body is
+// removed.
+typedef struct
+{
+    Body *bodies;
+    unsigned int capacity;
+    unsigned int n_bodies;
+
+    BodySlot *slots;
+    unsigned int slots_capacity;
+    unsigned int n_slots;
+    unsigned int free_slot;
+} BodyPool;
+
+#define BODY_POOL_NULL 0xffffffffu
+
+void body_pool_create(BodyPool *pool)
+{
+    memset(pool, 0, sizeof(BodyPool));
+    pool->free_slot = BODY_POOL_NULL;
+}
+
+void body_pool_destroy(BodyPool *pool)
+{
+    mem_free(pool->bodies);
+    mem_free(pool->slots);
+    body_pool_create(pool);
+}
+
+BodyHandle body_pool_add(BodyPool *pool, Body body)
+{
+    unsigned int slot = pool->free_slot;
+    if (slot != BODY_POOL_NULL)
+    {
+        pool->free_slot = pool->slots[slot].dense;
+    }
+    else
+    {
+        slot = pool->n_slots++;
+        pool->slots = (BodySlot *)mem_grow(pool->slots, &pool->slots_capacity, pool->n_slots, sizeof(BodySlot));
+        pool->slots[slot].generation = 0;
+    }
+
+    unsigned int dense = pool->n_bodies++;
+    pool->bodies = (Body *)mem_grow(pool->bodies, &pool->capacity, pool->n_bodies, sizeof(Body));
+    pool->slots[slot].dense = dense;
+
+    BodyHandle handle = {slot, pool->slots[slot].generation};
+    pool->bodies[dense] = body;
+    pool->bodies[dense].world_index = dense;
+    pool->bodies[dense].handle = handle;
+    return handle;
+}
+
+bool body_pool_valid(BodyPool *pool, BodyHandle handle)
+{
+    return handle.slot < pool->n_slots && pool->slots[handle.slot].generation == handle.generation;
+}
+
+// body of the handle, NULL once it was removed
+Body *body_pool_get(BodyPool *pool, BodyHandle handle)
+{
+    if (!body_pool_valid(pool, handle))
+        return NULL;
+    return &pool->bodies[pool->slots[handle.slot].dense];
+}
+
+void body_pool_remove(BodyPool *pool, BodyHandle handle)
+{
+    if (!body_pool_valid(pool, handle))
+        return;
+
+    BodySlot *slot = &pool->slots[handle.slot];
+    unsigned int dense = slot->dense;
+    unsigned int last = --pool->n_bodies;
+    if (dense != last)
+    {
+        pool->bodies[dense] = pool->bodies[last];
+        pool->bodies[dense].world_index = dense;
+        pool->slots[pool->bodies[dense].handle.slot].dense = dense;
+    }
+
+    slot->generation++;
+    slot->dense = pool->free_slot;
+    pool->free_slot = handle.slot;
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef BODY_STATE_H
+#define BODY_STATE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "body.h"
+#include "mem.h"
+
+// Hot state of the bodies as structure of arrays, index i holds the body at index i of the
+// world's body array. The integrators load a run of bodies, integrate 4 (SSE2) or 8 (AVX)
+// bodies per instruction and store the result back into the bodies.
+typedef struct
+{
+    float *position_x;
+    float *position_y;
+    float *velocity_x;
+    float *velocity_y;
+    float *theta;
+    float *omega;
+    float *force_x;
+    float *force_y;
+    float *torque;
+    float *inv_mass;
+    float *inv_inertia;
+    // all bits set where the body is awake and not static, lanes without them are left as they are
+    int32_t *moves;
+
+    unsigned int n_bodies;
+    unsigned int capacity;
+} BodyState;
+
+void body_state_create(BodyState *s)
+{
+    memset(s, 0, sizeof(BodyState));
+}
+
+void body_state_destroy(BodyState *s)
+{
+    mem_free(s->position_x);
+    mem_free(s->position_y);
+    mem_free(s->velocity_x);
+    mem_free(s->velocity_y);
+    mem_free(s->theta);
+    mem_free(s->omega);
+    mem_free(s->force_x);
+    mem_free(s->force_y);
+    mem_free(s->torque);
+    mem_free(s->inv_mass);
+    mem_free(s->inv_inertia);
+    mem_free(s->moves);
+    body_state_create(s);
+}
+
+// makes room for n_bodies bodies, the contents are loaded by the stages that use them
+void body_state_resize(BodyState *s, unsigned int n_bodies)
+{
+    s->n_bodies = n_bodies;
+    if (n_bodies <= s->capacity)
+        return;
+
+    s->capacity = (2 * s->capacity > n_bodies) ? 2 * s->capacity : n_bodies;
+    size_t size = s->capacity * sizeof(float);
+    s->position_x = (float *)mem_realloc(s->position_x, size);
+    s->position_y = (float *)mem_realloc(s->position_y, size);
+    s->velocity_x = (float *)mem_realloc(s->velocity_x, size);
+    s->velocity_y = (float *)mem_realloc(s->velocity_y, size);
+    s->theta = (float *)mem_realloc(s->theta, size);
+    s->omega = (float *)mem_realloc(s->omega, size);
+    s->force_x = (float *)mem_realloc(s->force_x, size);
+    s->force_y = (float *)mem_realloc(s->force_y, size);
+    s->torque = (float *)mem_realloc(s->torque, size);
+    s->inv_mass = (float *)mem_realloc(s->inv_mass, size);
+    s->inv_inertia = (float *)mem_realloc(s->inv_inertia, size);
+    s->moves = (int32_t *)mem_realloc(s->moves, s->capacity * sizeof(int32_t));
+}
+
+// loads what body_state_integrate_forces reads for the bodies in [begin, end)
+void body_state_load_forces(BodyState *s, Body *bodies, unsigned int begin, unsigned int end)
+{
+    for (unsigned int i = begin; i < end; i++)
+    {
+        Body *b = &bodies[i];
+        s->velocity_x[i] = b->velocity.x;
+        s->velocity_y[i] = b->velocity.y;
+        s->omega[i] = b->omega;
+        s->force_x[i] = b->force.x;
+        s->force_y[i] = b->force.y;
+        s->torque[i] = b->torque;
+        s->inv_mass[i] = b->inv_mass;
+        s->inv_inertia[i] = b->inv_inertia;
+        s->moves[i] = (b->is_awake && b->inv_mass != 0) ? -1 : 0;
+    }
+}
+
+// loads what body_state_integrate_velocities reads for the bodies in [begin, end)
+void body_state_load_velocities(BodyState *s, Body *bodies, unsigned int begin, unsigned int end)
+{
+    for (unsigned int i = begin; i < end; i++)
+    {
+        Body *b = &bodies[i];
+        s->position_x[i] = b->position.x;
+        s->position_y[i] = b->position.y;
+        s->velocity_x[i] = b->velocity.x;
+        s->velocity_y[i] = b->velocity.y;
+        s->theta[i] = b->theta;
+        s->omega[i] = b->omega;
+        s->moves[i] = (b->is_awake && b->inv_mass != 0) ? -1 : 0;
+    }
+}
+
+// writes back the velocities of the moving bodies and clears their forces, as
+// body_integrate_forces does
+void body_state_store_velocities(BodyState *s, Body *bodies, unsigned int begin, unsigned int end)
+{
+    for (unsigned int i = begin; i < end; i++)
+    {
+        if (!s->moves[i])
+            continue;
+        Body *b = &bodies[i];
+        b->velocity = (Vec2){.x = s->velocity_x[i], .y = s->velocity_y[i]};
+        b->omega = s->omega[i];
+        body_clear_force(b);
+        body_clear_torque(b);
+    }
+}
+
+// writes back the positions of the moving bodies
+void body_state_store_positions(BodyState *s, Body *bodies, unsigned int begin, unsigned int end)
+{
+    for (unsigned int i = begin; i < end; i++)
+    {
+        if (!s->moves[i])
+            continue;
+        Body *b = &bodies[i];
+        b->position = (Vec2){.x = s->position_x[i], .y = s->position_y[i]};
+        b->theta = s->theta[i];
+    }
+}
+
+void body_state_integrate_forces_lane(BodyState *s, unsigned int i, float delta_time)
+{
+    if (!s->moves[i])
+        return;
+    s->velocity_x[i] += s->force_x[i] * s->inv_mass[i] * delta_time;
+    s->velocity_y[i] += s->force_y[i] * s->inv_mass[i] * delta_time;
+    s->omega[i] += s->torque[i] * s->inv_inertia[i] * delta_time;
+}
+
+void body_state_integrate_velocities_lane(BodyState *s, unsigned int i, float delta_time)
+{
+    if (!s->moves[i])
+        return;
+    float two_pi = 2.0f * M_PI;
+    s->position_x[i] += s->velocity_x[i] * delta_time;
+    s->position_y[i] += s->velocity_y[i] * delta_time;
+    s->theta[i] = fmodf(s->theta[i] + s->omega[i] * delta_time + two_pi, two_pi);
+}
+
+// velocities from the forces for the bodies in [begin, end), agrees with body_integrate_forces
+void body_state_integrate_forces(BodyState *s, unsigned int begin, unsigned int end, float delta_time)
+{
+    unsigned int i = begin;
+#if defined(__AVX__)
+    __m256 dt8 = _mm256_set1_ps(delta_time);
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 moves = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *)&s->moves[i]));
+        __m256 inv_mass = _mm256_loadu_ps(&s->inv_mass[i]);
+        __m256 dvx = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(&s->force_x[i]), inv_mass), dt8);
+        __m256 dvy = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(&s->force_y[i]), inv_mass), dt8);
+        __m256 dw = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(&s->torque[i]), _mm256_loadu_ps(&s->inv_inertia[i])), dt8);
+        _mm256_storeu_ps(&s->velocity_x[i], _mm256_add_ps(_mm256_loadu_ps(&s->velocity_x[i]), _mm256_and_ps(dvx, moves)));
+        _mm256_storeu_ps(&s->velocity_y[i], _mm256_add_ps(_mm256_loadu_ps(&s->velocity_y[i]), _mm256_and_ps(dvy, moves)));
+        _mm256_storeu_ps(&s->omega[i], _mm256_add_ps(_mm256_loadu_ps(&s->omega[i]), _mm256_and_ps(dw, moves)));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128 dt4 = _mm_set1_ps(delta_time);
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 moves = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)&s->moves[i]));
+        __m128 inv_mass = _mm_loadu_ps(&s->inv_mass[i]);
+        __m128 dvx = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&s->force_x[i]), inv_mass), dt4);
+        __m128 dvy = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&s->force_y[i]), inv_mass), dt4);
+        __m128 dw = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&s->torque[i]), _mm_loadu_ps(&s->inv_inertia[i])), dt4);
+        _mm_storeu_ps(&s->velocity_x[i], _mm_add_ps(_mm_loadu_ps(&s->velocity_x[i]), _mm_and_ps(dvx, moves)));
+        _mm_storeu_ps(&s->velocity_y[i], _mm_add_ps(_mm_loadu_ps(&s->velocity_y[i]), _mm_and_ps(dvy, moves)));
+        _mm_storeu_ps(&s->omega[i], _mm_add_ps(_mm_loadu_ps(&s->omega[i]), _mm_and_ps(dw, moves)));
+    }
+#endif
+    for (; i < end; i++)
+    {
+        body_state_integrate_forces_lane(s, i, delta_time);
+    }
+}
+
+// Positions from the velocities for the bodies in [begin, end), agrees with
+// body_integrate_velocities. theta is wrapped like fmodf does, by truncating the quotient.
+void body_state_integrate_velocities(BodyState *s, unsigned int begin, unsigned int end, float delta_time)
+{
+    unsigned int i = begin;
+#if defined(__AVX__)
+    __m256 dt8 = _mm256_set1_ps(delta_time);
+    __m256 two_pi8 = _mm256_set1_ps(2.0f * M_PI);
+    __m256 inv_two_pi8 = _mm256_set1_ps(1.0f / (2.0f * M_PI));
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 moves = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *)&s->moves[i]));
+        __m256 dx = _mm256_mul_ps(_mm256_loadu_ps(&s->velocity_x[i]), dt8);
+        __m256 dy = _mm256_mul_ps(_mm256_loadu_ps(&s->velocity_y[i]), dt8);
+        _mm256_storeu_ps(&s->position_x[i], _mm256_add_ps(_mm256_loadu_ps(&s->position_x[i]), _mm256_and_ps(dx, moves)));
+        _mm256_storeu_ps(&s->position_y[i], _mm256_add_ps(_mm256_loadu_ps(&s->position_y[i]), _mm256_and_ps(dy, moves)));
+
+        __m256 theta = _mm256_loadu_ps(&s->theta[i]);
+        __m256 t = _mm256_add_ps(_mm256_add_ps(theta, _mm256_mul_ps(_mm256_loadu_ps(&s->omega[i]), dt8)), two_pi8);
+        __m256 turns = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(_mm256_mul_ps(t, inv_two_pi8)));
+        t = _mm256_sub_ps(t, _mm256_mul_ps(turns, two_pi8));
+        _mm256_storeu_ps(&s->theta[i], _mm256_or_ps(_mm256_and_ps(moves, t), _mm256_andnot_ps(moves, theta)));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128 dt4 = _mm_set1_ps(delta_time);
+    __m128 two_pi4 = _mm_set1_ps(2.0f * M_PI);
+    __m128 inv_two_pi4 = _mm_set1_ps(1.0f / (2.0f * M_PI));
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 moves = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)&s->moves[i]));
+        __m128 dx = _mm_mul_ps(_mm_loadu_ps(&s->velocity_x[i]), dt4);
+        __m128 dy = _mm_mul_ps(_mm_loadu_ps(&s->velocity_y[i]), dt4);
+        _mm_storeu_ps(&s->position_x[i], _mm_add_ps(_mm_loadu_ps(&s->position_x[i]), _mm_and_ps(dx, moves)));
+        _mm_storeu_ps(&s->position_y[i], _mm_add_ps(_mm_loadu_ps(&s->position_y[i]), _mm_and_ps(dy, moves)));
+
+        __m128 theta = _mm_loadu_ps(&s->theta[i]);
+        __m128 t = _mm_add_ps(_mm_add_ps(theta, _mm_mul_ps(_mm_loadu_ps(&s->omega[i]), dt4)), two_pi4);
+        __m128 turns = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(t, inv_two_pi4)));
+        t = _mm_sub_ps(t, _mm_mul_ps(turns, two_pi4));
+        _mm_storeu_ps(&s->theta[i], _mm_or_ps(_mm_and_ps(moves, t), _mm_andnot_ps(moves, theta)));
+    }
+#endif
+    for (; i < end; i++)
+    {
+        body_state_integrate_velocities_lane(s, i, delta_time);
+    }
+}
+
+#endif
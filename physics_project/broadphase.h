@@ -0,0 +1,444 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "aabb.h"
+#include "aabb_tree.h"
+#include "body.h"
+#include "mem.h"
+#include "sap.h"
+
+// Hierarchical spatial hash, each level has cells SPATIAL_HASH_LEVEL_RATIO times larger
+// than the one below so a 1900px floor and a 20px circle each get a fitting cell size
+#define SPATIAL_HASH_LEVELS 8
+#define SPATIAL_HASH_LEVEL_RATIO 4
+#define SPATIAL_HASH_CELL_SIZE 64.0f
+
+typedef enum
+{
+    BROADPHASE_BRUTE_FORCE,
+    BROADPHASE_SPATIAL_HASH,
+    BROADPHASE_AABB_TREE,
+    BROADPHASE_SWEEP_AND_PRUNE
+} BroadphaseType;
+
+typedef struct
+{
+    // indices into Broadphase.bodies, a < b
+    unsigned int a;
+    unsigned int b;
+} BroadphasePair;
+
+typedef struct
+{
+    int cx;
+    int cy;
+    unsigned int level;
+    unsigned int body;
+    unsigned int bucket;
+} SpatialHashEntry;
+
+typedef struct
+{
+    float cell_size[SPATIAL_HASH_LEVELS];
+    unsigned int level_count[SPATIAL_HASH_LEVELS];
+
+    unsigned int *body_level;
+    unsigned int body_level_capacity;
+
+    SpatialHashEntry *entries;
+    unsigned int entries_capacity;
+    SpatialHashEntry *sorted_entries;
+    unsigned int sorted_entries_capacity;
+    unsigned int n_entries;
+
+    // entries of bucket i are sorted_entries[bucket_start[i]] to sorted_entries[bucket_start[i + 1]]
+    unsigned int *bucket_start;
+    unsigned int bucket_start_capacity;
+    unsigned int n_buckets;
+} SpatialHash;
+
+typedef struct
+{
+    BroadphaseType type;
+
+    // the world's body array, the pairs index into it
+    Body *bodies;
+    AABB *aabbs;
+    unsigned int aabbs_capacity;
+    unsigned int n_bodies;
+
+    // candidate pairs for the narrowphase, sorted by (a, b)
+    BroadphasePair *pairs;
+    unsigned int pairs_capacity;
+    unsigned int n_pairs;
+
+    unsigned long n_pairs_tested;
+
+    SpatialHash hash;
+    AABBTree tree;
+    SweepAndPrune sap;
+} Broadphase;
+
+void broadphase_create(Broadphase *bp, BroadphaseType type)
+{
+    memset(bp, 0, sizeof(Broadphase));
+    bp->type = type;
+
+    float cell_size = SPATIAL_HASH_CELL_SIZE;
+    for (unsigned int level = 0; level < SPATIAL_HASH_LEVELS; level++)
+    {
+        bp->hash.cell_size[level] = cell_size;
+        cell_size *= SPATIAL_HASH_LEVEL_RATIO;
+    }
+
+    aabb_tree_create(&bp->tree);
+    sap_create(&bp->sap, 2);
+}
+
+void broadphase_destroy(Broadphase *bp)
+{
+    mem_free(bp->aabbs);
+    mem_free(bp->pairs);
+    mem_free(bp->hash.body_level);
+    mem_free(bp->hash.entries);
+    mem_free(bp->hash.sorted_entries);
+    mem_free(bp->hash.bucket_start);
+    aabb_tree_destroy(&bp->tree);
+    sap_destroy(&bp->sap);
+    memset(bp, 0, sizeof(Broadphase));
+}
+
+void broadphase_add_pair(Broadphase *bp, unsigned int i, unsigned int j)
+{
+    bp->pairs = (BroadphasePair *)mem_grow(bp->pairs, &bp->pairs_capacity, bp->n_pairs + 1, sizeof(BroadphasePair));
+    if (i < j)
+        bp->pairs[bp->n_pairs] = (BroadphasePair){i, j};
+    else
+        bp->pairs[bp->n_pairs] = (BroadphasePair){j, i};
+    bp->n_pairs++;
+}
+
+int broadphase_pair_compare(const void *p0, const void *p1)
+{
+    const BroadphasePair *a = (const BroadphasePair *)p0;
+    const BroadphasePair *b = (const BroadphasePair *)p1;
+
+    if (a->a != b->a)
+        return (a->a < b->a) ? -1 : 1;
+    if (a->b != b->b)
+        return (a->b < b->b) ? -1 : 1;
+    return 0;
+}
+
+void broadphase_gather(Broadphase *bp, Body *bodies, unsigned int n_bodies)
+{
+    bp->bodies = bodies;
+    bp->n_bodies = n_bodies;
+    bp->aabbs = (AABB *)mem_grow(bp->aabbs, &bp->aabbs_capacity, n_bodies, sizeof(AABB));
+    for (unsigned int i = 0; i < n_bodies; i++)
+    {
+        bp->aabbs[i] = body_aabb(&bodies[i]);
+    }
+}
+
+void broadphase_brute_force(Broadphase *bp)
+{
+    for (unsigned int i = 0; i < bp->n_bodies; i++)
+    {
+        for (unsigned int j = i + 1; j < bp->n_bodies; j++)
+        {
+            bp->n_pairs_tested++;
+            if (aabb_overlap(bp->aabbs[i], bp->aabbs[j]))
+            {
+                broadphase_add_pair(bp, i, j);
+            }
+        }
+    }
+}
+
+unsigned int spatial_hash_cell(int cx, int cy, unsigned int level)
+{
+    return ((unsigned int)cx * 73856093u) ^ ((unsigned int)cy * 19349663u) ^ (level * 83492791u);
+}
+
+int spatial_hash_coord(float x, float cell_size)
+{
+    return (int)floorf(x / cell_size);
+}
+
+void spatial_hash_build(SpatialHash *hash, AABB *aabbs, unsigned int n_bodies)
+{
+    memset(hash->level_count, 0, sizeof(hash->level_count));
+    hash->body_level = (unsigned int *)mem_grow(hash->body_level, &hash->body_level_capacity, n_bodies, sizeof(unsigned int));
+    hash->n_entries = 0;
+
+    for (unsigned int i = 0; i < n_bodies; i++)
+    {
+        float extent = fmaxf(aabb_width(aabbs[i]), aabb_height(aabbs[i]));
+        unsigned int level = 0;
+        while (level < SPATIAL_HASH_LEVELS - 1 && hash->cell_size[level] < extent)
+        {
+            level++;
+        }
+        hash->body_level[i] = level;
+        hash->level_count[level]++;
+
+        // the cell is at least as large as the body, so this is at most 2x2 cells below the top level
+        float cell_size = hash->cell_size[level];
+        int x0 = spatial_hash_coord(aabbs[i].min.x, cell_size);
+        int x1 = spatial_hash_coord(aabbs[i].max.x, cell_size);
+        int y0 = spatial_hash_coord(aabbs[i].min.y, cell_size);
+        int y1 = spatial_hash_coord(aabbs[i].max.y, cell_size);
+
+        for (int cy = y0; cy <= y1; cy++)
+        {
+            for (int cx = x0; cx <= x1; cx++)
+            {
+                hash->entries = (SpatialHashEntry *)mem_grow(hash->entries, &hash->entries_capacity, hash->n_entries + 1, sizeof(SpatialHashEntry));
+                hash->entries[hash->n_entries++] = (SpatialHashEntry){.cx = cx, .cy = cy, .level = level, .body = i};
+            }
+        }
+    }
+
+    hash->n_buckets = 64;
+    while (hash->n_buckets < 2 * hash->n_entries)
+    {
+        hash->n_buckets *= 2;
+    }
+    hash->bucket_start = (unsigned int *)mem_grow(hash->bucket_start, &hash->bucket_start_capacity, hash->n_buckets + 1, sizeof(unsigned int));
+    hash->sorted_entries = (SpatialHashEntry *)mem_grow(hash->sorted_entries, &hash->sorted_entries_capacity, hash->n_entries, sizeof(SpatialHashEntry));
+    memset(hash->bucket_start, 0, (hash->n_buckets + 1) * sizeof(unsigned int));
+
+    // counting sort of the entries by bucket
+    unsigned int mask = hash->n_buckets - 1;
+    for (unsigned int e = 0; e < hash->n_entries; e++)
+    {
+        SpatialHashEntry *entry = &hash->entries[e];
+        entry->bucket = spatial_hash_cell(entry->cx, entry->cy, entry->level) & mask;
+        hash->bucket_start[entry->bucket + 1]++;
+    }
+    for (unsigned int b = 0; b < hash->n_buckets; b++)
+    {
+        hash->bucket_start[b + 1] += hash->bucket_start[b];
+    }
+    for (unsigned int e = 0; e < hash->n_entries; e++)
+    {
+        hash->sorted_entries[hash->bucket_start[hash->entries[e].bucket]++] = hash->entries[e];
+    }
+    // the scatter advanced each start to the start of the next bucket, shift them back
+    for (unsigned int b = hash->n_buckets; b > 0; b--)
+    {
+        hash->bucket_start[b] = hash->bucket_start[b - 1];
+    }
+    hash->bucket_start[0] = 0;
+}
+
+void broadphase_spatial_hash(Broadphase *bp)
+{
+    SpatialHash *hash = &bp->hash;
+    spatial_hash_build(hash, bp->aabbs, bp->n_bodies);
+
+    unsigned int mask = hash->n_buckets - 1;
+
+    // A body only searches its own level and the coarser ones, the coarser body never
+    // looks back down. Pairs on the same level are only reported by the lower index.
+    for (unsigned int i = 0; i < bp->n_bodies; i++)
+    {
+        AABB a = bp->aabbs[i];
+        unsigned int body_level = hash->body_level[i];
+
+        for (unsigned int level = body_level; level < SPATIAL_HASH_LEVELS; level++)
+        {
+            if (hash->level_count[level] == 0)
+                continue;
+
+            float cell_size = hash->cell_size[level];
+            int x0 = spatial_hash_coord(a.min.x, cell_size);
+            int x1 = spatial_hash_coord(a.max.x, cell_size);
+            int y0 = spatial_hash_coord(a.min.y, cell_size);
+            int y1 = spatial_hash_coord(a.max.y, cell_size);
+
+            for (int cy = y0; cy <= y1; cy++)
+            {
+                for (int cx = x0; cx <= x1; cx++)
+                {
+                    unsigned int bucket = spatial_hash_cell(cx, cy, level) & mask;
+                    for (unsigned int k = hash->bucket_start[bucket]; k < hash->bucket_start[bucket + 1]; k++)
+                    {
+                        SpatialHashEntry *entry = &hash->sorted_entries[k];
+                        if (entry->cx != cx || entry->cy != cy || entry->level != level)
+                            continue;
+
+                        unsigned int j = entry->body;
+                        if (level == body_level && j <= i)
+                            continue;
+
+                        bp->n_pairs_tested++;
+                        AABB b = bp->aabbs[j];
+                        if (!aabb_overlap(a, b))
+                            continue;
+
+                        // bodies sharing several cells are reported once, from the cell
+                        // holding the min corner of their overlap
+                        float overlap_x = fmaxf(a.min.x, b.min.x);
+                        float overlap_y = fmaxf(a.min.y, b.min.y);
+                        if (spatial_hash_coord(overlap_x, cell_size) != cx || spatial_hash_coord(overlap_y, cell_size) != cy)
+                            continue;
+
+                        broadphase_add_pair(bp, i, j);
+                    }
+                }
+            }
+        }
+    }
+
+    // same order as the brute force loop so both give identical simulations
+    qsort(bp->pairs, bp->n_pairs, sizeof(BroadphasePair), broadphase_pair_compare);
+}
+
+typedef struct
+{
+    Broadphase *bp;
+    unsigned int body;
+} AABBTreePairQuery;
+
+void broadphase_aabb_tree_pair_callback(void *context, int j)
+{
+    AABBTreePairQuery *query = (AABBTreePairQuery *)context;
+    Broadphase *bp = query->bp;
+    unsigned int i = query->body;
+
+    // each pair is seen from both sides, keep the one from the lower index
+    if ((unsigned int)j <= i)
+        return;
+
+    bp->n_pairs_tested++;
+    if (aabb_overlap(bp->aabbs[i], bp->aabbs[j]))
+    {
+        broadphase_add_pair(bp, i, j);
+    }
+}
+
+void broadphase_aabb_tree(Broadphase *bp)
+{
+    for (unsigned int i = 0; i < bp->n_bodies; i++)
+    {
+        Body *b = &bp->bodies[i];
+        Vec2 displacement = vec2_scale(b->velocity, AABB_TREE_DISPLACEMENT_TIME);
+
+        if (b->broadphase_proxy == AABB_TREE_NULL)
+        {
+            b->broadphase_proxy = aabb_tree_create_proxy(&bp->tree, bp->aabbs[i], displacement, i);
+        }
+        else
+        {
+            aabb_tree_move_proxy(&bp->tree, b->broadphase_proxy, bp->aabbs[i], displacement);
+            bp->tree.nodes[b->broadphase_proxy].body = i;
+        }
+    }
+
+    // the tight AABB of a body is inside its own fat leaf, so querying with it finds
+    // every leaf the brute force loop would
+    AABBTreePairQuery query = {.bp = bp};
+    for (unsigned int i = 0; i < bp->n_bodies; i++)
+    {
+        query.body = i;
+        aabb_tree_query(&bp->tree, bp->aabbs[i], broadphase_aabb_tree_pair_callback, &query);
+    }
+
+    qsort(bp->pairs, bp->n_pairs, sizeof(BroadphasePair), broadphase_pair_compare);
+}
+
+void broadphase_sweep_and_prune(Broadphase *bp)
+{
+    SweepAndPrune *sap = &bp->sap;
+
+    for (unsigned int i = 0; i < bp->n_bodies; i++)
+    {
+        Body *b = &bp->bodies[i];
+        if (b->broadphase_proxy == SAP_NULL)
+            b->broadphase_proxy = sap_create_proxy(sap, bp->aabbs[i], i);
+        else
+            sap_set_proxy(sap, b->broadphase_proxy, bp->aabbs[i], i);
+    }
+
+    sap_update(sap);
+    bp->n_pairs_tested = sap->n_overlap_tests;
+
+    // the pair set is already exact with two axes, one axis still needs the y test
+    for (unsigned int p = 0; p < sap->pairs.n_keys; p++)
+    {
+        unsigned int i = sap->proxies[sap->pairs.keys[p].a].body;
+        unsigned int j = sap->proxies[sap->pairs.keys[p].b].body;
+        if (sap->n_axes == 1)
+        {
+            bp->n_pairs_tested++;
+            if (!aabb_overlap(bp->aabbs[i], bp->aabbs[j]))
+                continue;
+        }
+        broadphase_add_pair(bp, i, j);
+    }
+
+    qsort(bp->pairs, bp->n_pairs, sizeof(BroadphasePair), broadphase_pair_compare);
+}
+
+// Drops every proxy so the bodies are inserted again by the next update, needed when
+// switching broadphase type
+void broadphase_reset(Broadphase *bp, Body *bodies, unsigned int n_bodies)
+{
+    for (unsigned int i = 0; i < n_bodies; i++)
+    {
+        bodies[i].broadphase_proxy = BODY_PROXY_NULL;
+    }
+    aabb_tree_destroy(&bp->tree);
+    sap_destroy(&bp->sap);
+}
+
+// Drops the proxy of a body that leaves the world. Sweep and prune can not remove a single
+// proxy, so it starts over from the remaining bodies.
+void broadphase_remove_body(Broadphase *bp, Body *b, Body *bodies, unsigned int n_bodies)
+{
+    if (b->broadphase_proxy == BODY_PROXY_NULL)
+        return;
+
+    if (bp->type == BROADPHASE_AABB_TREE)
+    {
+        aabb_tree_destroy_proxy(&bp->tree, b->broadphase_proxy);
+        b->broadphase_proxy = BODY_PROXY_NULL;
+    }
+    else if (bp->type == BROADPHASE_SWEEP_AND_PRUNE)
+    {
+        broadphase_reset(bp, bodies, n_bodies);
+    }
+}
+
+void broadphase_update(Broadphase *bp, Body *bodies, unsigned int n_bodies)
+{
+    broadphase_gather(bp, bodies, n_bodies);
+
+    bp->n_pairs = 0;
+    bp->n_pairs_tested = 0;
+
+    switch (bp->type)
+    {
+    case BROADPHASE_BRUTE_FORCE:
+        broadphase_brute_force(bp);
+        break;
+    case BROADPHASE_SPATIAL_HASH:
+        broadphase_spatial_hash(bp);
+        break;
+    case BROADPHASE_AABB_TREE:
+        broadphase_aabb_tree(bp);
+        break;
+    case BROADPHASE_SWEEP_AND_PRUNE:
+        broadphase_sweep_and_prune(bp);
+        break;
+    }
+}
+
+#endif
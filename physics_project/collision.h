@@ -8,6 +8,9 @@
 #include "body.h"
 #include "vec2.h"
 
+// pixels by which the separation of b has to beat a's for b to give the reference edge
+#define COLLISION_REFERENCE_TOLERANCE 0.1f
+
 typedef struct
 {
     Body *a;
@@ -17,27 +20,49 @@ typedef struct
     Vec2 end;
     Vec2 normal;
     float depth;
+
+    // which features of the two shapes made the contact, see contact_feature
+    unsigned int feature;
 } Collision_Info;
 
+typedef enum
+{
+    FEATURE_CIRCLE_CIRCLE,
+    FEATURE_REFERENCE_A,
+    FEATURE_REFERENCE_B,
+    FEATURE_CIRCLE_VERTEX,
+    FEATURE_CIRCLE_EDGE
+} ContactFeatureKind;
+
+// Packs the features behind a contact into an id that stays the same from one step to the
+// next while the shapes keep touching the same way, e.g. reference edge, incident edge and
+// clip point for two polygons
+unsigned int contact_feature(ContactFeatureKind kind, unsigned int i, unsigned int j, unsigned int k)
+{
+    return ((unsigned int)kind << 24) | ((i & 0xff) << 16) | ((j & 0xff) << 8) | (k & 0xff);
+}
+
 bool collision_circle_circle(Body *, Body *, Collision_Info[], unsigned int *);
 bool collision_polygon_polygon(Body *, Body *, Collision_Info[], unsigned int *);
 bool collision_polygon_circle(Body *, Body *, Collision_Info[], unsigned int *);
 
 bool collision(Body *a, Body *b, Collision_Info info[], unsigned int *n_collisions)
 {
-    if (a->shape_type == CIRCLE && b->shape_type == CIRCLE)
+    ShapeType type_a = a->shape.type;
+    ShapeType type_b = b->shape.type;
+    if (type_a == CIRCLE && type_b == CIRCLE)
     {
         return collision_circle_circle(a, b, info, n_collisions);
     }
-    else if ((a->shape_type == POLYGON || a->shape_type == BOX) && (b->shape_type == POLYGON || b->shape_type == BOX))
+    else if (type_a != CIRCLE && type_b != CIRCLE)
     {
         return collision_polygon_polygon(a, b, info, n_collisions);
     }
-    else if ((a->shape_type == POLYGON || a->shape_type == BOX) && b->shape_type == CIRCLE)
+    else if (type_a != CIRCLE && type_b == CIRCLE)
     {
         return collision_polygon_circle(a, b, info, n_collisions);
     }
-    else if (a->shape_type == CIRCLE && (b->shape_type == POLYGON || b->shape_type == BOX))
+    else if (type_a == CIRCLE && type_b != CIRCLE)
     {
         return collision_polygon_circle(b, a, info, n_collisions);
     }
@@ -51,8 +76,8 @@ bool collision_circle_circle(Body *a, Body *b, Collision_Info info[], unsigned i
 {
     Collision_Info *contact = &info[*n_collisions];
 
-    Circle *c_a = (Circle *)a->shape;
-    Circle *c_b = (Circle *)b->shape;
+    Circle *c_a = &a->shape.circle;
+    Circle *c_b = &b->shape.circle;
 
     float distance = vec2_norm(vec2_sub(b->position, a->position));
 
@@ -70,6 +95,7 @@ bool collision_circle_circle(Body *a, Body *b, Collision_Info info[], unsigned i
         contact->end = vec2_add(a->position, foo);
 
         contact->depth = vec2_norm(vec2_sub(contact->end, contact->start));
+        contact->feature = contact_feature(FEATURE_CIRCLE_CIRCLE, 0, 0, 0);
 
         (*n_collisions)++;
         return true;
@@ -80,13 +106,13 @@ bool collision_circle_circle(Body *a, Body *b, Collision_Info info[], unsigned i
     }
 }
 
-float collision_find_minimum_separation(Polygon *a, Polygon *b, unsigned int *index_reference_edge, Vec2 *support_point)
+float collision_find_minimum_separation(PolygonVertices *a, PolygonVertices *b, unsigned int *index_reference_edge, Vec2 *support_point)
 {
     float separation = -FLT_MAX;
 
     for (unsigned int i = 0; i < a->n_vertices; i++)
     {
-        Vec2 va = a->global_vertices[i];
+        Vec2 va = a->vertices[i];
         Vec2 normal = vec2_normal(polygon_edge_at(a, i));
 
         float min_separation = FLT_MAX;
@@ -94,7 +120,7 @@ float collision_find_minimum_separation(Polygon *a, Polygon *b, unsigned int *in
 
         for (int j = 0; j < b->n_vertices; j++)
         {
-            Vec2 vb = b->global_vertices[j];
+            Vec2 vb = b->vertices[j];
 
             float projection = vec2_dot(vec2_sub(vb, va), normal);
 
@@ -114,7 +140,7 @@ float collision_find_minimum_separation(Polygon *a, Polygon *b, unsigned int *in
     return separation;
 }
 
-unsigned int polygon_find_incident_edge(Polygon *shape, Vec2 normal)
+unsigned int polygon_find_incident_edge(PolygonVertices *shape, Vec2 normal)
 {
     unsigned int incident_edge;
     float min_projection = FLT_MAX;
@@ -131,8 +157,9 @@ unsigned int polygon_find_incident_edge(Polygon *shape, Vec2 normal)
     return incident_edge;
 }
 
-int polygon_clip_segment_to_line(Polygon *shape, Vec2 contacts_in[2], Vec2 contacts_out[2], Vec2 *c0, Vec2 *c1)
+int polygon_clip_segment_to_line(PolygonVertices *shape, Vec2 contacts_in[2], Vec2 contacts_out[2], Vec2 *c0, Vec2 *c1)
 {
+    (void)shape;
     unsigned int num_out = 0;
 
     Vec2 normal = vec2_unitvector(vec2_sub(*c1, *c0));
@@ -162,11 +189,14 @@ int polygon_clip_segment_to_line(Polygon *shape, Vec2 contacts_in[2], Vec2 conta
 
 bool collision_polygon_polygon(Body *a, Body *b, Collision_Info info[], unsigned int *n_collisions)
 {
+    PolygonVertices pa, pb;
+    shape_global_vertices(&a->shape, a->position, a->theta, &pa);
+    shape_global_vertices(&b->shape, b->position, b->theta, &pb);
 
     unsigned int a_index_reference_edge, b_index_reference_edge;
     Vec2 a_support_point, b_support_point;
-    float sep_ab = collision_find_minimum_separation((Polygon *)a->shape, (Polygon *)b->shape, &a_index_reference_edge, &a_support_point);
-    float sep_ba = collision_find_minimum_separation((Polygon *)b->shape, (Polygon *)a->shape, &b_index_reference_edge, &b_support_point);
+    float sep_ab = collision_find_minimum_separation(&pa, &pb, &a_index_reference_edge, &a_support_point);
+    float sep_ba = collision_find_minimum_separation(&pb, &pa, &b_index_reference_edge, &b_support_point);
 
     if (sep_ab >= 0)
     {
@@ -177,19 +207,23 @@ bool collision_polygon_polygon(Body *a, Body *b, Collision_Info info[], unsigned
         return false;
     }
 
-    Polygon *reference_shape;
-    Polygon *incident_shape;
+    // b only becomes the reference when clearly better, so equal faces resting on each other
+    // keep the same reference from one step to the next
+    bool b_is_reference = sep_ba > sep_ab + COLLISION_REFERENCE_TOLERANCE;
+
+    PolygonVertices *reference_shape;
+    PolygonVertices *incident_shape;
     unsigned int index_reference_edge;
-    if (sep_ab > sep_ba)
+    if (!b_is_reference)
     {
-        reference_shape = (Polygon *)a->shape;
-        incident_shape = (Polygon *)b->shape;
+        reference_shape = &pa;
+        incident_shape = &pb;
         index_reference_edge = a_index_reference_edge;
     }
     else
     {
-        reference_shape = (Polygon *)b->shape;
-        incident_shape = (Polygon *)a->shape;
+        reference_shape = &pb;
+        incident_shape = &pa;
         index_reference_edge = b_index_reference_edge;
     }
 
@@ -197,8 +231,8 @@ bool collision_polygon_polygon(Body *a, Body *b, Collision_Info info[], unsigned
 
     unsigned int incident_index = polygon_find_incident_edge(incident_shape, vec2_normal(reference_edge));
     unsigned int incident_next_index = (incident_index + 1) % (incident_shape->n_vertices);
-    Vec2 v0 = incident_shape->global_vertices[incident_index];
-    Vec2 v1 = incident_shape->global_vertices[incident_next_index];
+    Vec2 v0 = incident_shape->vertices[incident_index];
+    Vec2 v1 = incident_shape->vertices[incident_next_index];
 
     Vec2 contact_points[2] = {v0, v1};
     Vec2 clipped_points[2] = {v0, v1};
@@ -208,8 +242,8 @@ bool collision_polygon_polygon(Body *a, Body *b, Collision_Info info[], unsigned
         if (i == index_reference_edge)
             continue;
 
-        Vec2 c0 = reference_shape->global_vertices[i];
-        Vec2 c1 = reference_shape->global_vertices[(i + 1) % reference_shape->n_vertices];
+        Vec2 c0 = reference_shape->vertices[i];
+        Vec2 c1 = reference_shape->vertices[(i + 1) % reference_shape->n_vertices];
 
         int num_clipped = polygon_clip_segment_to_line(reference_shape, contact_points, clipped_points, &c0, &c1);
         if (num_clipped < 2)
@@ -221,7 +255,7 @@ bool collision_polygon_polygon(Body *a, Body *b, Collision_Info info[], unsigned
         contact_points[1] = clipped_points[1];
     }
 
-    Vec2 *vref = &reference_shape->global_vertices[index_reference_edge];
+    Vec2 *vref = &reference_shape->vertices[index_reference_edge];
 
     for (unsigned int i = 0; i < 2; i++)
     {
@@ -235,7 +269,8 @@ bool collision_polygon_polygon(Body *a, Body *b, Collision_Info info[], unsigned
             contact->normal = vec2_normal(reference_edge);
             contact->start = vclip;
             contact->end = vec2_add(vclip, vec2_scale(contact->normal, -1.0 * separation));
-            if (sep_ba >= sep_ab)
+            contact->feature = contact_feature(b_is_reference ? FEATURE_REFERENCE_B : FEATURE_REFERENCE_A, index_reference_edge, incident_index, i);
+            if (b_is_reference)
             {
                 Vec2 temp_start = contact->start;
                 Vec2 temp_end = contact->end;
@@ -255,13 +290,17 @@ bool collision_polygon_circle(Body *a, Body *b, Collision_Info info[], unsigned
 {
     Collision_Info *contact = &info[*n_collisions];
 
-    Polygon *p = (Polygon *)a->shape;
-    Circle *c = (Circle *)b->shape;
+    PolygonVertices polygon;
+    shape_global_vertices(&a->shape, a->position, a->theta, &polygon);
+    PolygonVertices *p = &polygon;
+    Circle *c = &b->shape.circle;
 
     bool is_outside = false;
     Vec2 min_current_vertex;
     Vec2 min_next_vertex;
-    float distance_circle_edge = FLT_MIN;
+    unsigned int min_current_index = 0;
+    unsigned int min_next_index = 0;
+    float distance_circle_edge = -FLT_MAX;
 
     for (int i = 0; i < p->n_vertices; i++)
     {
@@ -269,14 +308,16 @@ bool collision_polygon_circle(Body *a, Body *b, Collision_Info info[], unsigned
         Vec2 edge = polygon_edge_at(p, i);
         Vec2 normal = vec2_normal(edge);
 
-        Vec2 circle_center = vec2_sub(b->position, p->global_vertices[i]);
+        Vec2 circle_center = vec2_sub(b->position, p->vertices[i]);
         float projection = vec2_dot(circle_center, normal);
 
         if (projection > 0)
         {
             distance_circle_edge = projection;
-            min_current_vertex = p->global_vertices[i];
-            min_next_vertex = p->global_vertices[i_next];
+            min_current_vertex = p->vertices[i];
+            min_next_vertex = p->vertices[i_next];
+            min_current_index = i;
+            min_next_index = i_next;
             is_outside = true;
             break;
         }
@@ -285,8 +326,10 @@ bool collision_polygon_circle(Body *a, Body *b, Collision_Info info[], unsigned
             if (projection > distance_circle_edge)
             {
                 distance_circle_edge = projection;
-                min_current_vertex = p->global_vertices[i];
-                min_next_vertex = p->global_vertices[i_next];
+                min_current_vertex = p->vertices[i];
+                min_next_vertex = p->vertices[i_next];
+                min_current_index = i;
+                min_next_index = i_next;
             }
         }
     }
@@ -310,6 +353,7 @@ bool collision_polygon_circle(Body *a, Body *b, Collision_Info info[], unsigned
                 contact->normal = vec2_unitvector(v1);
                 contact->start = vec2_add(b->position, vec2_scale(contact->normal, -1.0 * c->radius));
                 contact->end = vec2_add(contact->start, vec2_scale(contact->normal, contact->depth));
+                contact->feature = contact_feature(FEATURE_CIRCLE_VERTEX, min_current_index, 0, 0);
             }
         }
         else
@@ -330,6 +374,7 @@ bool collision_polygon_circle(Body *a, Body *b, Collision_Info info[], unsigned
                     contact->normal = vec2_unitvector(v1);
                     contact->start = vec2_add(b->position, vec2_scale(contact->normal, -1.0 * c->radius));
                     contact->end = vec2_add(contact->start, vec2_scale(contact->normal, contact->depth));
+                    contact->feature = contact_feature(FEATURE_CIRCLE_VERTEX, min_next_index, 0, 0);
                 }
             }
             else
@@ -346,6 +391,7 @@ bool collision_polygon_circle(Body *a, Body *b, Collision_Info info[], unsigned
                     contact->normal = vec2_normal(vec2_sub(min_next_vertex, min_current_vertex));
                     contact->start = vec2_add(b->position, vec2_scale(contact->normal, -1.0 * c->radius));
                     contact->end = vec2_add(contact->start, vec2_scale(contact->normal, contact->depth));
+                    contact->feature = contact_feature(FEATURE_CIRCLE_EDGE, min_current_index, 0, 0);
                 }
             }
         }
@@ -358,6 +404,7 @@ bool collision_polygon_circle(Body *a, Body *b, Collision_Info info[], unsigned
         contact->normal = vec2_normal(vec2_sub(min_next_vertex, min_current_vertex));
         contact->start = vec2_add(b->position, vec2_scale(contact->normal, -1.0 * c->radius));
         contact->end = vec2_add(contact->start, vec2_scale(contact->normal, contact->depth));
+        contact->feature = contact_feature(FEATURE_CIRCLE_EDGE, min_current_index, 0, 0);
     }
 
     (*n_collisions)++;
@@ -0,0 +1,162 @@
+#ifndef COLORING_H
+#define COLORING_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "body.h"
+#include "constraint.h"
+#include "island.h"
+#include "mem.h"
+
+#define COLORING_MAX_COLORS 32
+// constraints that find no free color, solved one after another after the colors
+#define COLORING_OVERFLOW COLORING_MAX_COLORS
+
+// Splits constraints into colors so no two constraints of a color touch the same dynamic
+// body, which lets a color be solved in any order or all at once. Static bodies are never
+// written by the solver and do not conflict.
+typedef struct
+{
+    // bit k set if the body has a constraint of color k, indexed by world_index
+    uint32_t *body_colors;
+    unsigned int body_colors_capacity;
+
+    unsigned char *joint_color;
+    unsigned int joint_color_capacity;
+    unsigned char *contact_color;
+    unsigned int contact_color_capacity;
+
+    // color k owns joints[joint_start[k]..joint_start[k + 1]) and likewise for contacts,
+    // the overflow color is k = COLORING_OVERFLOW
+    JointConstraint **joints;
+    unsigned int joints_capacity;
+    unsigned int joint_start[COLORING_MAX_COLORS + 2];
+    PenetrationConstraint **contacts;
+    unsigned int contacts_capacity;
+    unsigned int contact_start[COLORING_MAX_COLORS + 2];
+
+    // colors 0..n_colors - 1 hold constraints
+    unsigned int n_colors;
+} ConstraintColoring;
+
+void coloring_create(ConstraintColoring *c)
+{
+    memset(c, 0, sizeof(ConstraintColoring));
+}
+
+void coloring_destroy(ConstraintColoring *c)
+{
+    mem_free(c->body_colors);
+    mem_free(c->joint_color);
+    mem_free(c->contact_color);
+    mem_free(c->joints);
+    mem_free(c->contacts);
+    coloring_create(c);
+}
+
+// lowest color used by neither body, marks it as used by the dynamic ones
+unsigned int coloring_pick(ConstraintColoring *c, Body *a, Body *b)
+{
+    bool a_dynamic = a->inv_mass != 0.0;
+    bool b_dynamic = b->inv_mass != 0.0;
+    uint32_t used = (a_dynamic ? c->body_colors[a->world_index] : 0) | (b_dynamic ? c->body_colors[b->world_index] : 0);
+    if (used == 0xffffffffu)
+        return COLORING_OVERFLOW;
+
+    unsigned int color = __builtin_ctz(~used);
+    if (a_dynamic)
+        c->body_colors[a->world_index] |= 1u << color;
+    if (b_dynamic)
+        c->body_colors[b->world_index] |= 1u << color;
+    return color;
+}
+
+unsigned int coloring_n_joints(ConstraintColoring *c, unsigned int color)
+{
+    return c->joint_start[color + 1] - c->joint_start[color];
+}
+
+unsigned int coloring_n_contacts(ConstraintColoring *c, unsigned int color)
+{
+    return c->contact_start[color + 1] - c->contact_start[color];
+}
+
+// Colors the constraints of the first n_islands awake islands, the largest ones. Greedy
+// coloring in island order, then a counting sort by color that keeps that order within a color.
+void coloring_build(ConstraintColoring *c, Islands *is, unsigned int n_islands)
+{
+    unsigned int n_joints = 0;
+    unsigned int n_contacts = 0;
+    for (unsigned int i = 0; i < n_islands; i++)
+    {
+        unsigned int island = is->awake_islands[i].island;
+        n_joints += is->joint_start[island + 1] - is->joint_start[island];
+        n_contacts += is->contact_start[island + 1] - is->contact_start[island];
+    }
+
+    c->body_colors = (uint32_t *)mem_grow(c->body_colors, &c->body_colors_capacity, is->n_bodies, sizeof(uint32_t));
+    memset(c->body_colors, 0, is->n_bodies * sizeof(uint32_t));
+    c->joint_color = (unsigned char *)mem_grow(c->joint_color, &c->joint_color_capacity, n_joints, sizeof(unsigned char));
+    c->contact_color = (unsigned char *)mem_grow(c->contact_color, &c->contact_color_capacity, n_contacts, sizeof(unsigned char));
+    memset(c->joint_start, 0, sizeof(c->joint_start));
+    memset(c->contact_start, 0, sizeof(c->contact_start));
+
+    unsigned int j = 0;
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < n_islands; i++)
+    {
+        unsigned int island = is->awake_islands[i].island;
+        for (unsigned int p = is->joint_start[island]; p < is->joint_start[island + 1]; p++, j++)
+        {
+            c->joint_color[j] = coloring_pick(c, is->joints[p]->a, is->joints[p]->b);
+            c->joint_start[c->joint_color[j] + 1]++;
+        }
+        for (unsigned int p = is->contact_start[island]; p < is->contact_start[island + 1]; p++, k++)
+        {
+            c->contact_color[k] = coloring_pick(c, is->contacts[p]->a, is->contacts[p]->b);
+            c->contact_start[c->contact_color[k] + 1]++;
+        }
+    }
+
+    c->n_colors = 0;
+    for (unsigned int color = 0; color < COLORING_MAX_COLORS; color++)
+    {
+        if (c->joint_start[color + 1] + c->contact_start[color + 1] > 0)
+            c->n_colors = color + 1;
+    }
+
+    for (unsigned int color = 0; color <= COLORING_OVERFLOW; color++)
+    {
+        c->joint_start[color + 1] += c->joint_start[color];
+        c->contact_start[color + 1] += c->contact_start[color];
+    }
+
+    // the starts serve as insertion cursors, then get shifted back
+    c->joints = (JointConstraint **)mem_grow(c->joints, &c->joints_capacity, n_joints, sizeof(JointConstraint *));
+    c->contacts = (PenetrationConstraint **)mem_grow(c->contacts, &c->contacts_capacity, n_contacts, sizeof(PenetrationConstraint *));
+    j = 0;
+    k = 0;
+    for (unsigned int i = 0; i < n_islands; i++)
+    {
+        unsigned int island = is->awake_islands[i].island;
+        for (unsigned int p = is->joint_start[island]; p < is->joint_start[island + 1]; p++, j++)
+        {
+            c->joints[c->joint_start[c->joint_color[j]]++] = is->joints[p];
+        }
+        for (unsigned int p = is->contact_start[island]; p < is->contact_start[island + 1]; p++, k++)
+        {
+            c->contacts[c->contact_start[c->contact_color[k]]++] = is->contacts[p];
+        }
+    }
+
+    for (unsigned int color = COLORING_OVERFLOW + 1; color > 0; color--)
+    {
+        c->joint_start[color] = c->joint_start[color - 1];
+        c->contact_start[color] = c->contact_start[color - 1];
+    }
+    c->joint_start[0] = 0;
+    c->contact_start[0] = 0;
+}
+
+#endif
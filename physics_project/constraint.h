@@ -3,21 +3,29 @@
 
 #include "body.h"
 #include "vec2.h"
-#include "matmn.h"
+#include "matfix.h"
 #include "util.h"
 #include "mem.h"
 
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 
+// penetration in pixels left uncorrected, keeps warm started contacts touching between steps
+#define PENETRATION_SLOP 1.0f
+
 typedef struct
 {
     Body *a;
     Body *b;
+    // the world looks a and b up again from these every step, as bodies move in its array
+    BodyHandle a_handle;
+    BodyHandle b_handle;
     Vec2 a_local_anchor;
     Vec2 b_local_anchor;
-    MatMN jacobian;
-    MatMN cached_lambda;
+    Mat16 jacobian;
+    // 1 / (J @ invM @ J.T), from pre-solve
+    float effective_mass;
+    Mat11 cached_lambda;
     float bias;
 } JointConstraint;
 
@@ -27,30 +35,93 @@ typedef struct
     Body *b;
     Vec2 a_collision;
     Vec2 b_collision;
-    MatMN jacobian;
-    MatMN cached_lambda;
-    float bias;
     Vec2 normal;
+    // fixed for the step by pre-solve: world space normal and tangent, the arms from the
+    // centers of a and b to the contact and the inverse effective mass of (normal, tangent)
+    Vec2 n;
+    Vec2 t;
+    Vec2 ra;
+    Vec2 rb;
+    Mat22 inv_effective_mass;
+    Mat21 cached_lambda;
+    // with the soft step the bias is only the restitution, the separation is followed from
+    // the angles of a and b at pre-solve on and the normal and tangent are solved one after
+    // the other, each with the effective mass along it alone. max_normal_impulse is the
+    // largest the normal impulse got in any substep.
+    float bias;
     float friction;
+    float a_theta;
+    float b_theta;
+    float normal_mass;
+    float tangent_mass;
+    float max_normal_impulse;
 } PenetrationConstraint;
 
+// How soft a constraint is in the soft step, a spring of some stiffness (hertz) and damping
+// ratio pulling its error in over substeps of h seconds. The bias velocity is bias_rate times
+// the error, the impulse is scaled by mass_scale and relaxed by impulse_scale times the one
+// accumulated so far.
+typedef struct
+{
+    float bias_rate;
+    float mass_scale;
+    float impulse_scale;
+} Softness;
+
+Softness softness_create(float hertz, float damping_ratio, float h)
+{
+    if (hertz == 0)
+        return (Softness){0.0f, 1.0f, 0.0f};
+
+    float omega = 2.0f * M_PI * hertz;
+    float a1 = 2.0f * damping_ratio + h * omega;
+    float a2 = h * omega * a1;
+    float a3 = 1.0f / (1.0f + a2);
+    return (Softness){omega / a1, a2 * a3, a3};
+}
+
+// How far the accumulated impulses moved during one solver iteration. A constraint moved by
+// the largest change of any of its impulses.
+typedef struct
+{
+    float max;
+    float sum_squares;
+    unsigned int n;
+} SolverResidual;
+
+void solver_residual_add(SolverResidual *r, float delta)
+{
+    r->max = MAX(r->max, delta);
+    r->sum_squares += delta * delta;
+    r->n++;
+}
+
+void solver_residual_merge(SolverResidual *r, SolverResidual *other)
+{
+    r->max = MAX(r->max, other->max);
+    r->sum_squares += other->sum_squares;
+    r->n += other->n;
+}
+
+float solver_residual_rms(SolverResidual *r)
+{
+    return (r->n > 0) ? sqrtf(r->sum_squares / r->n) : 0.0f;
+}
+
 void joint_constraint_create(JointConstraint *jc, Body *a, Body *b, Vec2 anchor)
 {
     jc->a = a;
     jc->b = b;
+    jc->a_handle = a->handle;
+    jc->b_handle = b->handle;
     jc->a_local_anchor = body_global_to_local_space(a, anchor);
     jc->b_local_anchor = body_global_to_local_space(b, anchor);
-    jc->jacobian = matmn_create(1, 6, MEM_HEAP);
-    jc->cached_lambda = matmn_create(1, 1, MEM_HEAP);
+    jc->jacobian = mat16_zero();
+    jc->effective_mass = 0;
+    jc->cached_lambda = mat11_zero();
     jc->bias = 0;
 }
 
-void joint_constraint_destroy(JointConstraint *jc)
-{
-    matmn_destroy(&jc->jacobian);
-    matmn_destroy(&jc->cached_lambda);
-}
-
 void penetration_constraint_create(PenetrationConstraint *pc, Body *a, Body *b, Vec2 a_collision, Vec2 b_collision, Vec2 normal)
 {
     pc->a = a;
@@ -58,144 +129,128 @@ void penetration_constraint_create(PenetrationConstraint *pc, Body *a, Body *b,
     pc->a_collision = body_global_to_local_space(a, a_collision);
     pc->b_collision = body_global_to_local_space(b, b_collision);
     pc->normal = body_global_to_local_space(a, normal);
-    pc->jacobian = matmn_create(2, 6, MEM_HEAP);
-    pc->cached_lambda = matmn_create(2, 1, MEM_HEAP);
+    pc->n = (Vec2){.x = 0, .y = 0};
+    pc->t = (Vec2){.x = 0, .y = 0};
+    pc->ra = (Vec2){.x = 0, .y = 0};
+    pc->rb = (Vec2){.x = 0, .y = 0};
+    pc->inv_effective_mass = mat22_zero();
+    pc->cached_lambda = mat21_zero();
     pc->bias = 0;
     pc->friction = 0.0;
+    pc->a_theta = 0;
+    pc->b_theta = 0;
+    pc->normal_mass = 0;
+    pc->tangent_mass = 0;
+    pc->max_normal_impulse = 0;
 }
 
-void penetration_constraint_destroy(PenetrationConstraint *pc)
+InvMass6 constraint_inv_mass(Body *a, Body *b)
 {
-    matmn_destroy(&pc->jacobian);
-    matmn_destroy(&pc->cached_lambda);
+    return (InvMass6){{a->inv_mass, a->inv_mass, a->inv_inertia, b->inv_mass, b->inv_mass, b->inv_inertia}};
 }
 
-void constraint_get_inv_m(Body *a, Body *b, MatMN *z)
+Vec6 constraint_velocities(Body *a, Body *b)
 {
-    assert(z->m == 6);
-    assert(z->n == 6);
-
-    memset(z->data, 0, sizeof(z->data[0]) * z->m * z->n);
-
-    MATMN_AT(*z, 0, 0) = a->inv_mass;
-    MATMN_AT(*z, 1, 1) = a->inv_mass;
-    MATMN_AT(*z, 2, 2) = a->inv_inertia;
-    MATMN_AT(*z, 3, 3) = b->inv_mass;
-    MATMN_AT(*z, 4, 4) = b->inv_mass;
-    MATMN_AT(*z, 5, 5) = b->inv_inertia;
+    return (Vec6){{{a->velocity.x}, {a->velocity.y}, {a->omega}, {b->velocity.x}, {b->velocity.y}, {b->omega}}};
 }
 
-void constraint_velocities(Body *a, Body *b, MatMN *z)
+void constraint_apply_impulses(Body *a, Body *b, Vec6 *impulses)
 {
-    assert(z->m == 6);
-    assert(z->n == 1);
+    body_apply_impulse_linear(a, (Vec2){.x = impulses->data[0][0], .y = impulses->data[1][0]});
+    body_apply_impulse_angular(a, impulses->data[2][0]);
 
-    MATMN_AT(*z, 0, 0) = a->velocity.x;
-    MATMN_AT(*z, 0, 1) = a->velocity.y;
-    MATMN_AT(*z, 0, 2) = a->omega;
-    MATMN_AT(*z, 0, 3) = b->velocity.x;
-    MATMN_AT(*z, 0, 4) = b->velocity.y;
-    MATMN_AT(*z, 0, 5) = b->omega;
+    body_apply_impulse_linear(b, (Vec2){.x = impulses->data[3][0], .y = impulses->data[4][0]});
+    body_apply_impulse_angular(b, impulses->data[5][0]);
 }
 
-void joint_constraint_pre_solve(JointConstraint *c, float delta_time, float beta)
+// jacobian and effective mass of the joint, returns the squared distance between the anchors
+float joint_constraint_prepare(JointConstraint *c)
 {
-    mem_reset_scratch_pool();
-
     Vec2 pa = body_local_to_global_space(c->a, c->a_local_anchor);
     Vec2 pb = body_local_to_global_space(c->b, c->b_local_anchor);
 
-    Vec2 j1 = vec2_scale(vec2_sub(pa, pb), 2.0);
-    MATMN_AT(c->jacobian, 0, 0) = j1.x;
-    MATMN_AT(c->jacobian, 0, 1) = j1.y;
-
     Vec2 ra = vec2_sub(pa, c->a->position);
     Vec2 rb = vec2_sub(pb, c->b->position);
 
-    float j2 = 2.0 * vec2_cross(ra, vec2_sub(pa, pb));
-    MATMN_AT(c->jacobian, 0, 2) = j2;
-
+    Vec2 j1 = vec2_scale(vec2_sub(pa, pb), 2.0);
     Vec2 j3 = vec2_scale(vec2_sub(pb, pa), 2.0);
-    MATMN_AT(c->jacobian, 0, 3) = j3.x;
-    MATMN_AT(c->jacobian, 0, 4) = j3.y;
-
-    float j4 = 2.0 * vec2_cross(rb, vec2_sub(pb, pa));
-    MATMN_AT(c->jacobian, 0, 5) = j4;
-
-    MatMN jacobian_T = matmn_create(c->jacobian.n, c->jacobian.m, MEM_SCRATCH_POOL);
-    matmn_transpose(&(c->jacobian), &jacobian_T);
-
-    MatMN impulses = matmn_create(jacobian_T.m, c->cached_lambda.n, MEM_SCRATCH_POOL);
-    matmn_mul(&jacobian_T, &c->cached_lambda, &impulses);
+    c->jacobian.data[0][0] = j1.x;
+    c->jacobian.data[0][1] = j1.y;
+    c->jacobian.data[0][2] = 2.0 * vec2_cross(ra, vec2_sub(pa, pb));
+    c->jacobian.data[0][3] = j3.x;
+    c->jacobian.data[0][4] = j3.y;
+    c->jacobian.data[0][5] = 2.0 * vec2_cross(rb, vec2_sub(pb, pa));
+
+    InvMass6 inv_m = constraint_inv_mass(c->a, c->b);
+    Mat11 lhs = mat16_effective_mass(&c->jacobian, &inv_m);
+    c->effective_mass = (lhs.data[0][0] != 0) ? 1.0f / lhs.data[0][0] : 0.0f;
+
+    return vec2_dot(vec2_sub(pb, pa), vec2_sub(pb, pa));
+}
 
-    body_apply_impulse_linear(c->a, (Vec2){MATMN_AT(impulses, 0, 0), MATMN_AT(impulses, 1, 0)});
-    body_apply_impulse_angular(c->a, MATMN_AT(impulses, 2, 0));
+void joint_constraint_warm_start(JointConstraint *c)
+{
+    Vec6 impulses = mat16_transpose_mul_mat11(&c->jacobian, &c->cached_lambda);
+    constraint_apply_impulses(c->a, c->b, &impulses);
+}
 
-    body_apply_impulse_linear(c->b, (Vec2){MATMN_AT(impulses, 3, 0), MATMN_AT(impulses, 4, 0)});
-    body_apply_impulse_angular(c->b, MATMN_AT(impulses, 5, 0));
+void joint_constraint_pre_solve(JointConstraint *c, float delta_time, float beta)
+{
+    float C = joint_constraint_prepare(c);
+    joint_constraint_warm_start(c);
 
-    float C = vec2_dot(vec2_sub(pb, pa), vec2_sub(pb, pa));
     C = MAX(0.0, C - 0.01f);
     c->bias = beta / delta_time * C;
 }
 
-void joint_constraint_post_solve(JointConstraint *c)
+// adds lambda to the accumulated impulse and applies it, returns how much it changed
+float joint_constraint_accumulate(JointConstraint *c, Mat11 lambda)
 {
-}
+    c->cached_lambda = mat11_add(c->cached_lambda, lambda);
 
-void joint_constraint_solve(JointConstraint *c, unsigned int iterations)
-{   
-    mem_reset_scratch_pool();
-
-    MatMN v = matmn_create(6, 1, MEM_SCRATCH_POOL);
-    constraint_velocities(c->a, c->b, &v);
-    MatMN invM = matmn_create(6, 6, MEM_SCRATCH_POOL);
-    constraint_get_inv_m(c->a, c->b, &invM);
-
-    MatMN jacobian_T = matmn_create(c->jacobian.n, c->jacobian.m, MEM_SCRATCH_POOL);
-    matmn_transpose(&(c->jacobian), &jacobian_T);
-
-    // lhs = J @ invM @ J.T
-    MatMN lhs = matmn_create(c->jacobian.m, jacobian_T.n, MEM_SCRATCH_POOL);
-    MATMN_AT(lhs, 0, 0) = MATMN_AT(c->jacobian, 0, 0) * MATMN_AT(c->jacobian, 0, 0) * MATMN_AT(invM, 0, 0);
-    MATMN_AT(lhs, 0, 0) += MATMN_AT(c->jacobian, 0, 1) * MATMN_AT(c->jacobian, 0, 1) * MATMN_AT(invM, 1, 1);
-    MATMN_AT(lhs, 0, 0) += MATMN_AT(c->jacobian, 0, 2) * MATMN_AT(c->jacobian, 0, 2) * MATMN_AT(invM, 2, 2);
-    MATMN_AT(lhs, 0, 0) += MATMN_AT(c->jacobian, 0, 3) * MATMN_AT(c->jacobian, 0, 3) * MATMN_AT(invM, 3, 3);
-    MATMN_AT(lhs, 0, 0) += MATMN_AT(c->jacobian, 0, 4) * MATMN_AT(c->jacobian, 0, 4) * MATMN_AT(invM, 4, 4);
-    MATMN_AT(lhs, 0, 0) += MATMN_AT(c->jacobian, 0, 5) * MATMN_AT(c->jacobian, 0, 5) * MATMN_AT(invM, 5, 5);
-    
-    // rhs = - (J @ v)
-    MatMN rhs = matmn_create(c->jacobian.m, v.n, MEM_SCRATCH_POOL);
-    MATMN_AT(rhs, 0, 0) = -1.0f * (MATMN_AT(c->jacobian, 0, 0) * MATMN_AT(v, 0, 0));
-    MATMN_AT(rhs, 0, 0) += -1.0f * (MATMN_AT(c->jacobian, 0, 1) * MATMN_AT(v, 1, 0));
-    MATMN_AT(rhs, 0, 0) += -1.0f * (MATMN_AT(c->jacobian, 0, 2) * MATMN_AT(v, 2, 0));
-    MATMN_AT(rhs, 0, 0) += -1.0f * (MATMN_AT(c->jacobian, 0, 3) * MATMN_AT(v, 3, 0));
-    MATMN_AT(rhs, 0, 0) += -1.0f * (MATMN_AT(c->jacobian, 0, 4) * MATMN_AT(v, 4, 0));
-    MATMN_AT(rhs, 0, 0) += -1.0f * (MATMN_AT(c->jacobian, 0, 5) * MATMN_AT(v, 5, 0));
-    MATMN_AT(rhs, 0, 0) -= c->bias;
-
-    MatMN lambda = matmn_create(1, 1, MEM_SCRATCH_POOL);
-    // matmn_solve_gauss_seidel(&lhs, &rhs, &lambda, iterations);
-    if (MATMN_AT(lhs, 0, 0) != 0)
-    {
-        MATMN_AT(lambda, 0, 0) = MATMN_AT(rhs, 0, 0) / MATMN_AT(lhs, 0, 0);
-    }
-    matmn_add(&c->cached_lambda, &lambda, &c->cached_lambda);
+    Vec6 impulses = mat16_transpose_mul_mat11(&c->jacobian, &lambda);
+    constraint_apply_impulses(c->a, c->b, &impulses);
+    return fabsf(lambda.data[0][0]);
+}
 
-    MatMN impulses = matmn_create(jacobian_T.m, lambda.n, MEM_SCRATCH_POOL);
-    matmn_mul(&jacobian_T, &lambda, &impulses);
+// returns how much the accumulated impulse changed
+float joint_constraint_solve(JointConstraint *c)
+{
+    Vec6 v = constraint_velocities(c->a, c->b);
 
-    body_apply_impulse_linear(c->a, (Vec2){MATMN_AT(impulses, 0, 0), MATMN_AT(impulses, 1, 0)});
-    body_apply_impulse_angular(c->a, MATMN_AT(impulses, 2, 0));
+    // lambda = -(J @ v + bias) / (J @ invM @ J.T)
+    Mat11 lambda = mat16_mul_vec6(&c->jacobian, &v);
+    lambda.data[0][0] = -(lambda.data[0][0] + c->bias) * c->effective_mass;
 
-    body_apply_impulse_linear(c->b, (Vec2){MATMN_AT(impulses, 3, 0), MATMN_AT(impulses, 4, 0)});
-    body_apply_impulse_angular(c->b, MATMN_AT(impulses, 5, 0));
+    return joint_constraint_accumulate(c, lambda);
 }
 
-void penetration_constraint_pre_solve(PenetrationConstraint *c, float delta_time, float beta)
+// One soft step iteration. With use_bias the error at the current positions is pulled in
+// softly, without it the velocity the bias added is taken out again.
+float joint_constraint_solve_soft(JointConstraint *c, Softness soft, bool use_bias)
 {
-    mem_reset_scratch_pool();
+    Vec6 v = constraint_velocities(c->a, c->b);
+    Mat11 lambda = mat16_mul_vec6(&c->jacobian, &v);
+
+    if (use_bias)
+    {
+        Vec2 pa = body_local_to_global_space(c->a, c->a_local_anchor);
+        Vec2 pb = body_local_to_global_space(c->b, c->b_local_anchor);
+        float C = MAX(0.0f, vec2_dot(vec2_sub(pb, pa), vec2_sub(pb, pa)) - 0.01f);
+        lambda.data[0][0] = -(lambda.data[0][0] + soft.bias_rate * C) * c->effective_mass * soft.mass_scale - soft.impulse_scale * c->cached_lambda.data[0][0];
+    }
+    else
+    {
+        lambda.data[0][0] = -lambda.data[0][0] * c->effective_mass;
+    }
+
+    return joint_constraint_accumulate(c, lambda);
+}
 
+// Normal, tangent, arms and inverse effective mass of the contact into c and its jacobian into
+// jacobian. Returns the separation along the normal, negative while they overlap.
+float penetration_constraint_prepare(PenetrationConstraint *c, Mat26 *jacobian)
+{
     Vec2 pa = body_local_to_global_space(c->a, c->a_collision);
     Vec2 pb = body_local_to_global_space(c->b, c->b_collision);
     Vec2 n = body_local_to_global_space(c->a, c->normal);
@@ -203,168 +258,251 @@ void penetration_constraint_pre_solve(PenetrationConstraint *c, float delta_time
     Vec2 ra = vec2_sub(pa, c->a->position);
     Vec2 rb = vec2_sub(pb, c->b->position);
 
-    Vec2 j1 = vec2_scale(n, -1.0);
-    MATMN_AT(c->jacobian, 0, 0) = j1.x;
-    MATMN_AT(c->jacobian, 0, 1) = j1.y;
-
-    float j2 = vec2_cross(vec2_scale(ra, -1.0), n);
-    MATMN_AT(c->jacobian, 0, 2) = j2;
-
-    Vec2 j3 = n;
-    MATMN_AT(c->jacobian, 0, 3) = j3.x;
-    MATMN_AT(c->jacobian, 0, 4) = j3.y;
+    c->n = n;
+    c->t = vec2_normal(n);
+    c->ra = ra;
+    c->rb = rb;
+    c->friction = MAX(c->a->friction, c->b->friction);
 
-    float j4 = vec2_cross(rb, n);
-    MATMN_AT(c->jacobian, 0, 5) = j4;
+    // row 0 along the normal, row 1 along the tangent, left zero without friction
+    *jacobian = mat26_zero();
+    jacobian->data[0][0] = -n.x;
+    jacobian->data[0][1] = -n.y;
+    jacobian->data[0][2] = vec2_cross(vec2_scale(ra, -1.0), n);
+    jacobian->data[0][3] = n.x;
+    jacobian->data[0][4] = n.y;
+    jacobian->data[0][5] = vec2_cross(rb, n);
 
-    c->friction = MAX(c->a->friction, c->b->friction);
+    InvMass6 inv_m = constraint_inv_mass(c->a, c->b);
     if (c->friction > 0.0)
     {
-        Vec2 t = vec2_normal(n);
-        MATMN_AT(c->jacobian, 1, 0) = -(t.x);
-        MATMN_AT(c->jacobian, 1, 1) = -(t.y);
-        MATMN_AT(c->jacobian, 1, 2) = -(vec2_cross(ra, t));
-
-        MATMN_AT(c->jacobian, 1, 3) = t.x;
-        MATMN_AT(c->jacobian, 1, 4) = t.y;
-        MATMN_AT(c->jacobian, 1, 5) = vec2_cross(rb, t);
+        jacobian->data[1][0] = -(c->t.x);
+        jacobian->data[1][1] = -(c->t.y);
+        jacobian->data[1][2] = -(vec2_cross(ra, c->t));
+        jacobian->data[1][3] = c->t.x;
+        jacobian->data[1][4] = c->t.y;
+        jacobian->data[1][5] = vec2_cross(rb, c->t);
+
+        Mat22 lhs = mat26_effective_mass(jacobian, &inv_m);
+        c->inv_effective_mass = mat22_inverse(&lhs);
+    }
+    else
+    {
+        // the tangent row is empty, solve the normal alone
+        Mat22 lhs = mat26_effective_mass(jacobian, &inv_m);
+        c->inv_effective_mass = mat22_zero();
+        if (lhs.data[0][0] != 0)
+            c->inv_effective_mass.data[0][0] = 1.0f / lhs.data[0][0];
     }
 
-    MatMN jacobian_T = matmn_create(c->jacobian.n, c->jacobian.m, MEM_SCRATCH_POOL);
-    matmn_transpose(&(c->jacobian), &jacobian_T);
-
-    MatMN impulses = matmn_create(jacobian_T.m, c->cached_lambda.n, MEM_SCRATCH_POOL);
-    matmn_mul(&jacobian_T, &c->cached_lambda, &impulses);
+    return vec2_dot(vec2_sub(pb, pa), vec2_scale(n, -1.0));
+}
 
-    body_apply_impulse_linear(c->a, (Vec2){MATMN_AT(impulses, 0, 0), MATMN_AT(impulses, 1, 0)});
-    body_apply_impulse_angular(c->a, MATMN_AT(impulses, 2, 0));
+// relative velocity of the contact points along the normal, positive while they approach
+float penetration_constraint_approach(PenetrationConstraint *c)
+{
+    Vec2 va = vec2_add(c->a->velocity, (Vec2){.x = -(c->a->omega) * c->ra.y, .y = c->a->omega * c->ra.x});
+    Vec2 vb = vec2_add(c->b->velocity, (Vec2){.x = -(c->b->omega) * c->rb.y, .y = c->b->omega * c->rb.x});
+    return vec2_dot(vec2_sub(va, vb), c->n);
+}
 
-    body_apply_impulse_linear(c->b, (Vec2){MATMN_AT(impulses, 3, 0), MATMN_AT(impulses, 4, 0)});
-    body_apply_impulse_angular(c->b, MATMN_AT(impulses, 5, 0));
+void penetration_constraint_pre_solve(PenetrationConstraint *c, float delta_time, float beta)
+{
+    Mat26 jacobian;
+    float C = penetration_constraint_prepare(c, &jacobian);
 
-    float C = vec2_dot(vec2_sub(pb, pa), vec2_scale(n, -1.0));
-    C = MIN(0.0, C + 0.01f);
+    Vec6 impulses = mat26_transpose_mul_mat21(&jacobian, &c->cached_lambda);
+    constraint_apply_impulses(c->a, c->b, &impulses);
 
-    Vec2 va = vec2_add(c->a->velocity, (Vec2){-(c->a->omega) * ra.y, c->a->omega * ra.x});
-    Vec2 vb = vec2_add(c->b->velocity, (Vec2){-(c->b->omega) * rb.y, c->b->omega * rb.x});
-    float vrel_dot_normal = vec2_dot(vec2_sub(va, vb), n);
+    C = MIN(0.0, C + PENETRATION_SLOP);
+    float vrel_dot_normal = penetration_constraint_approach(c);
 
     float e = MIN(c->a->restitution, c->b->restitution);
     c->bias = beta / delta_time * C + (e * vrel_dot_normal);
+}
 
-    // matmn_destroy(&jacobian_T);
-    // matmn_destroy(&impulses);
+// inverse of J @ invM @ J.T of the contact along axis alone
+float penetration_constraint_axis_mass(PenetrationConstraint *c, Vec2 axis)
+{
+    float ra = vec2_cross(c->ra, axis);
+    float rb = vec2_cross(c->rb, axis);
+    float k = c->a->inv_mass + c->b->inv_mass + c->a->inv_inertia * ra * ra + c->b->inv_inertia * rb * rb;
+    return (k != 0) ? 1.0f / k : 0.0f;
 }
 
-void penetration_constraint_post_solve(PenetrationConstraint *c)
+// Pre-solve of the soft step, which warm starts every substep and follows the separation as
+// the bodies move. The bias is the restitution alone, bouncing back with e times the velocity
+// the bodies approach with before the first substep.
+void penetration_constraint_pre_solve_soft(PenetrationConstraint *c)
 {
+    Mat26 jacobian;
+    penetration_constraint_prepare(c, &jacobian);
+    c->a_theta = c->a->theta;
+    c->b_theta = c->b->theta;
+    c->normal_mass = penetration_constraint_axis_mass(c, c->n);
+    c->tangent_mass = penetration_constraint_axis_mass(c, c->t);
+    c->max_normal_impulse = 0;
+
+    float e = MIN(c->a->restitution, c->b->restitution);
+    c->bias = -e * penetration_constraint_approach(c);
 }
 
-void penetration_constraint_solve(PenetrationConstraint *c, unsigned int iterations)
-{
-    mem_reset_scratch_pool();
-    
-    MatMN v = matmn_create(6, 1, MEM_SCRATCH_POOL);
-    constraint_velocities(c->a, c->b, &v);
-    MatMN invM = matmn_create(6, 6, MEM_SCRATCH_POOL);
-    constraint_get_inv_m(c->a, c->b, &invM);
-
-    MatMN jacobian_T = matmn_create(c->jacobian.n, c->jacobian.m, MEM_SCRATCH_POOL);
-    matmn_transpose(&(c->jacobian), &jacobian_T);
-
-    // MatMN aa_2 = matmn_create(c->jacobian.m, invM.n, MEM_SCRATCH_POOL);
-    // matmn_mul(&c->jacobian, &invM, &aa_2);
-    // MatMN lhs = matmn_create(aa_2.m, jacobian_T.n, MEM_SCRATCH_POOL);
-    // matmn_mul(&aa_2, &jacobian_T, &lhs);
-
-    // lhs = J @ invM @ J.T
-    MatMN lhs = matmn_create(c->jacobian.m, jacobian_T.n, MEM_SCRATCH_POOL);
-    MATMN_AT(lhs, 0, 0) = MATMN_AT(c->jacobian, 0, 0) * MATMN_AT(invM, 0, 0) * MATMN_AT(c->jacobian, 0, 0);
-    MATMN_AT(lhs, 0, 0) += MATMN_AT(c->jacobian, 0, 1) * MATMN_AT(invM, 1, 1) * MATMN_AT(c->jacobian, 0, 1);
-    MATMN_AT(lhs, 0, 0) += MATMN_AT(c->jacobian, 0, 2) * MATMN_AT(invM, 2, 2) * MATMN_AT(c->jacobian, 0, 2);
-    MATMN_AT(lhs, 0, 0) += MATMN_AT(c->jacobian, 0, 3) * MATMN_AT(invM, 3, 3) * MATMN_AT(c->jacobian, 0, 3);
-    MATMN_AT(lhs, 0, 0) += MATMN_AT(c->jacobian, 0, 4) * MATMN_AT(invM, 4, 4) * MATMN_AT(c->jacobian, 0, 4);
-    MATMN_AT(lhs, 0, 0) += MATMN_AT(c->jacobian, 0, 5) * MATMN_AT(invM, 5, 5) * MATMN_AT(c->jacobian, 0, 5);
-
-    MATMN_AT(lhs, 0, 1) = MATMN_AT(c->jacobian, 0, 0) * MATMN_AT(invM, 0, 0) * MATMN_AT(c->jacobian, 1, 0);
-    MATMN_AT(lhs, 0, 1) += MATMN_AT(c->jacobian, 0, 1) * MATMN_AT(invM, 1, 1) * MATMN_AT(c->jacobian, 1, 1);
-    MATMN_AT(lhs, 0, 1) += MATMN_AT(c->jacobian, 0, 2) * MATMN_AT(invM, 2, 2) * MATMN_AT(c->jacobian, 1, 2);
-    MATMN_AT(lhs, 0, 1) += MATMN_AT(c->jacobian, 0, 3) * MATMN_AT(invM, 3, 3) * MATMN_AT(c->jacobian, 1, 3);
-    MATMN_AT(lhs, 0, 1) += MATMN_AT(c->jacobian, 0, 4) * MATMN_AT(invM, 4, 4) * MATMN_AT(c->jacobian, 1, 4);
-    MATMN_AT(lhs, 0, 1) += MATMN_AT(c->jacobian, 0, 5) * MATMN_AT(invM, 5, 5) * MATMN_AT(c->jacobian, 1, 5);
-
-    MATMN_AT(lhs, 1, 0) = MATMN_AT(lhs, 0, 1);
-
-    MATMN_AT(lhs, 1, 1) = MATMN_AT(c->jacobian, 1, 0) * MATMN_AT(invM, 0, 0) * MATMN_AT(c->jacobian, 1, 0);
-    MATMN_AT(lhs, 1, 1) += MATMN_AT(c->jacobian, 1, 1) * MATMN_AT(invM, 1, 1) * MATMN_AT(c->jacobian, 1, 1);
-    MATMN_AT(lhs, 1, 1) += MATMN_AT(c->jacobian, 1, 2) * MATMN_AT(invM, 2, 2) * MATMN_AT(c->jacobian, 1, 2);
-    MATMN_AT(lhs, 1, 1) += MATMN_AT(c->jacobian, 1, 3) * MATMN_AT(invM, 3, 3) * MATMN_AT(c->jacobian, 1, 3);
-    MATMN_AT(lhs, 1, 1) += MATMN_AT(c->jacobian, 1, 4) * MATMN_AT(invM, 4, 4) * MATMN_AT(c->jacobian, 1, 4);
-    MATMN_AT(lhs, 1, 1) += MATMN_AT(c->jacobian, 1, 5) * MATMN_AT(invM, 5, 5) * MATMN_AT(c->jacobian, 1, 5);
-
-    // rhs = - (J @ v)
-    MatMN rhs = matmn_create(c->jacobian.m, v.n, MEM_SCRATCH_POOL);
-    MATMN_AT(rhs, 0, 0) = -1.0f * MATMN_AT(c->jacobian, 0, 0) * MATMN_AT(v, 0, 0);
-    MATMN_AT(rhs, 0, 0) += -1.0f * MATMN_AT(c->jacobian, 0, 1) * MATMN_AT(v, 1, 0);
-    MATMN_AT(rhs, 0, 0) += -1.0f * MATMN_AT(c->jacobian, 0, 2) * MATMN_AT(v, 2, 0);
-    MATMN_AT(rhs, 0, 0) += -1.0f * MATMN_AT(c->jacobian, 0, 3) * MATMN_AT(v, 3, 0);
-    MATMN_AT(rhs, 0, 0) += -1.0f * MATMN_AT(c->jacobian, 0, 4) * MATMN_AT(v, 4, 0);
-    MATMN_AT(rhs, 0, 0) += -1.0f * MATMN_AT(c->jacobian, 0, 5) * MATMN_AT(v, 5, 0);
-    MATMN_AT(rhs, 0, 0) -= c->bias;
-
-    MATMN_AT(rhs, 1, 0) = -1.0f * MATMN_AT(c->jacobian, 1, 0) * MATMN_AT(v, 0, 0);
-    MATMN_AT(rhs, 1, 0) += -1.0f * MATMN_AT(c->jacobian, 1, 1) * MATMN_AT(v, 1, 0);
-    MATMN_AT(rhs, 1, 0) += -1.0f * MATMN_AT(c->jacobian, 1, 2) * MATMN_AT(v, 2, 0);
-    MATMN_AT(rhs, 1, 0) += -1.0f * MATMN_AT(c->jacobian, 1, 3) * MATMN_AT(v, 3, 0);
-    MATMN_AT(rhs, 1, 0) += -1.0f * MATMN_AT(c->jacobian, 1, 4) * MATMN_AT(v, 4, 0);
-    MATMN_AT(rhs, 1, 0) += -1.0f * MATMN_AT(c->jacobian, 1, 5) * MATMN_AT(v, 5, 0);
-
-    MatMN lambda = matmn_create(2, 1, MEM_SCRATCH_POOL);
-    // matmn_solve_gauss_seidel(&lhs, &rhs, &lambda, iterations);
-    MATMN_AT(lambda, 0, 0) = MATMN_AT(lhs, 1, 1) * MATMN_AT(rhs, 0, 0) - MATMN_AT(lhs, 0, 1) * MATMN_AT(rhs, 1, 0);
-    MATMN_AT(lambda, 0, 0) /= MATMN_AT(lhs, 0, 0) * MATMN_AT(lhs, 1, 1) - MATMN_AT(lhs, 0, 1) * MATMN_AT(lhs, 1, 0);
-    MATMN_AT(lambda, 1, 0) = MATMN_AT(lhs, 1, 0) * MATMN_AT(rhs, 0, 0) - MATMN_AT(lhs, 0, 0) * MATMN_AT(rhs, 1, 0);
-    MATMN_AT(lambda, 1, 0) /= -1.0f * MATMN_AT(lhs, 0, 0) * MATMN_AT(lhs, 1, 1) + MATMN_AT(lhs, 0, 1) * MATMN_AT(lhs, 1, 0);
-
-
-    MatMN old_lambda = matmn_create_zero_like(&c->cached_lambda, MEM_SCRATCH_POOL);
-    matmn_copy(&c->cached_lambda, &old_lambda);
-    matmn_add(&c->cached_lambda, &lambda, &c->cached_lambda);
-
-    if (c->cached_lambda.data[0] < 0.0)
-        c->cached_lambda.data[0] = 0.0;
+// applies the accumulated impulses again
+void penetration_constraint_warm_start(PenetrationConstraint *c)
+{
+    Vec2 p = vec2_add(vec2_scale(c->n, c->cached_lambda.data[0][0]), vec2_scale(c->t, c->cached_lambda.data[1][0]));
+    body_apply_impulse_at_r(c->a, vec2_scale(p, -1.0f), c->ra);
+    body_apply_impulse_at_r(c->b, p, c->rb);
+}
+
+// Adds lambda to the accumulated impulses, keeps the normal one pushing and the tangent one
+// inside the friction cone and applies what changed. Returns the largest change.
+float penetration_constraint_accumulate(PenetrationConstraint *c, Mat21 lambda)
+{
+    Mat21 old_lambda = c->cached_lambda;
+    c->cached_lambda = mat21_add(c->cached_lambda, lambda);
+
+    if (c->cached_lambda.data[0][0] < 0.0)
+        c->cached_lambda.data[0][0] = 0.0;
 
     if (c->friction > 0)
     {
-        float max_friction = c->cached_lambda.data[0] * c->friction;
+        float max_friction = c->cached_lambda.data[0][0] * c->friction;
 
-        if (c->cached_lambda.data[1] < -max_friction)
+        if (c->cached_lambda.data[1][0] < -max_friction)
         {
-            c->cached_lambda.data[1] = -max_friction;
+            c->cached_lambda.data[1][0] = -max_friction;
         }
-        else if (c->cached_lambda.data[1] > max_friction)
+        else if (c->cached_lambda.data[1][0] > max_friction)
         {
-            c->cached_lambda.data[1] = max_friction;
+            c->cached_lambda.data[1][0] = max_friction;
         }
     }
 
-    matmn_sub(&c->cached_lambda, &old_lambda, &lambda);
+    lambda = mat21_sub(c->cached_lambda, old_lambda);
 
-    MatMN impulses = matmn_create(jacobian_T.m, lambda.n, MEM_SCRATCH_POOL);
+    // J.T @ lambda, an impulse p at the contact, pushing a back and b forward
+    Vec2 p = vec2_add(vec2_scale(c->n, lambda.data[0][0]), vec2_scale(c->t, lambda.data[1][0]));
+    body_apply_impulse_at_r(c->a, vec2_scale(p, -1.0f), c->ra);
+    body_apply_impulse_at_r(c->b, p, c->rb);
+    return MAX(fabsf(lambda.data[0][0]), fabsf(lambda.data[1][0]));
+}
 
-    MATMN_AT(impulses, 0, 0) = MATMN_AT(c->jacobian, 0, 0) * MATMN_AT(lambda, 0, 0) + MATMN_AT(c->jacobian, 1, 0) * MATMN_AT(lambda, 1, 0);
-    MATMN_AT(impulses, 1, 0) = MATMN_AT(c->jacobian, 0, 1) * MATMN_AT(lambda, 0, 0) + MATMN_AT(c->jacobian, 1, 1) * MATMN_AT(lambda, 1, 0);
-    MATMN_AT(impulses, 2, 0) = MATMN_AT(c->jacobian, 0, 2) * MATMN_AT(lambda, 0, 0) + MATMN_AT(c->jacobian, 1, 2) * MATMN_AT(lambda, 1, 0);
-    MATMN_AT(impulses, 3, 0) = MATMN_AT(c->jacobian, 0, 3) * MATMN_AT(lambda, 0, 0) + MATMN_AT(c->jacobian, 1, 3) * MATMN_AT(lambda, 1, 0);
-    MATMN_AT(impulses, 4, 0) = MATMN_AT(c->jacobian, 0, 4) * MATMN_AT(lambda, 0, 0) + MATMN_AT(c->jacobian, 1, 4) * MATMN_AT(lambda, 1, 0);
-    MATMN_AT(impulses, 5, 0) = MATMN_AT(c->jacobian, 0, 5) * MATMN_AT(lambda, 0, 0) + MATMN_AT(c->jacobian, 1, 5) * MATMN_AT(lambda, 1, 0);
+// J @ v, the relative velocity of the contact points along the normal and tangent
+Vec2 penetration_constraint_relative_velocity(PenetrationConstraint *c)
+{
+    Body *a = c->a;
+    Body *b = c->b;
+    Vec2 va = vec2_add(a->velocity, (Vec2){.x = -(a->omega) * c->ra.y, .y = a->omega * c->ra.x});
+    Vec2 vb = vec2_add(b->velocity, (Vec2){.x = -(b->omega) * c->rb.y, .y = b->omega * c->rb.x});
+    Vec2 dv = vec2_sub(vb, va);
+    return (Vec2){.x = vec2_dot(dv, c->n), .y = vec2_dot(dv, c->t)};
+}
 
+// returns the largest change of the normal and tangent impulses
+float penetration_constraint_solve(PenetrationConstraint *c)
+{
+    Vec2 jv = penetration_constraint_relative_velocity(c);
+    Mat21 rhs = {{{-jv.x - c->bias}, {-jv.y}}};
+    Mat21 lambda = mat22_mul_mat21(&c->inv_effective_mass, &rhs);
 
-    body_apply_impulse_linear(c->a, (Vec2){MATMN_AT(impulses, 0, 0), MATMN_AT(impulses, 1, 0)});
-    body_apply_impulse_angular(c->a, MATMN_AT(impulses, 2, 0));
+    return penetration_constraint_accumulate(c, lambda);
+}
+
+// change of an angle since theta_start, taking the wrap to [0, 2 pi) out
+float constraint_angle_change(float theta, float theta_start)
+{
+    float d = theta - theta_start;
+    if (d > M_PI)
+        d -= 2.0f * M_PI;
+    else if (d < -M_PI)
+        d += 2.0f * M_PI;
+    return d;
+}
+
+// relative velocity of the contact points of c along axis
+float penetration_constraint_axis_velocity(PenetrationConstraint *c, Vec2 axis)
+{
+    Body *a = c->a;
+    Body *b = c->b;
+    float dvx = b->velocity.x - b->omega * c->rb.y - a->velocity.x + a->omega * c->ra.y;
+    float dvy = b->velocity.y + b->omega * c->rb.x - a->velocity.y - a->omega * c->ra.x;
+    return dvx * axis.x + dvy * axis.y;
+}
+
+// applies impulse along axis at the contact, pushing a back and b forward
+void penetration_constraint_apply_along(PenetrationConstraint *c, Vec2 axis, float impulse)
+{
+    Vec2 p = vec2_scale(axis, impulse);
+    body_apply_impulse_at_r(c->a, vec2_scale(p, -1.0f), c->ra);
+    body_apply_impulse_at_r(c->b, p, c->rb);
+}
+
+// One soft step iteration of a contact. Friction comes first, rigid and bounded by the normal
+// impulse so far, so that the normal, solved last, is what a pass leaves satisfied. The
+// separation follows the bodies from pre-solve on, the arms turned with them to first order.
+// Contacts still apart may close the gap within the substep. With use_bias overlap is pushed
+// out softly, at most max_bias_velocity, without it the velocity the bias added is taken out
+// again. There is no slop: a contact resting slop deep would sit on the edge of the gap case,
+// where nothing is soft, and stacks rock on it. Returns the largest change of the impulses.
+float penetration_constraint_solve_soft(PenetrationConstraint *c, Softness soft, float max_bias_velocity, float inv_h, bool use_bias)
+{
+    Body *a = c->a;
+    Body *b = c->b;
+
+    float delta = 0.0f;
+    if (c->friction > 0)
+    {
+        float max_friction = c->friction * c->cached_lambda.data[0][0];
+        float old_t = c->cached_lambda.data[1][0];
+        float lambda_t = old_t - penetration_constraint_axis_velocity(c, c->t) * c->tangent_mass;
+        lambda_t = MAX(-max_friction, MIN(lambda_t, max_friction));
+        c->cached_lambda.data[1][0] = lambda_t;
+        delta = fabsf(lambda_t - old_t);
+        penetration_constraint_apply_along(c, c->t, lambda_t - old_t);
+    }
+
+    float da = constraint_angle_change(a->theta, c->a_theta);
+    float db = constraint_angle_change(b->theta, c->b_theta);
+    Vec2 pa = vec2_add(a->position, (Vec2){.x = c->ra.x - da * c->ra.y, .y = c->ra.y + da * c->ra.x});
+    Vec2 pb = vec2_add(b->position, (Vec2){.x = c->rb.x - db * c->rb.y, .y = c->rb.y + db * c->rb.x});
+    float separation = vec2_dot(vec2_sub(pa, pb), c->n);
+
+    float bias = 0.0f;
+    float mass_scale = 1.0f;
+    float impulse_scale = 0.0f;
+    if (separation > 0.0f)
+    {
+        bias = separation * inv_h;
+    }
+    else if (use_bias)
+    {
+        bias = MAX(soft.bias_rate * separation, -max_bias_velocity);
+        mass_scale = soft.mass_scale;
+        impulse_scale = soft.impulse_scale;
+    }
+
+    float old_n = c->cached_lambda.data[0][0];
+    float vn = penetration_constraint_axis_velocity(c, c->n);
+    float lambda_n = MAX(old_n - (vn + bias) * c->normal_mass * mass_scale - impulse_scale * old_n, 0.0f);
+    c->cached_lambda.data[0][0] = lambda_n;
+    c->max_normal_impulse = MAX(c->max_normal_impulse, lambda_n);
+    penetration_constraint_apply_along(c, c->n, lambda_n - old_n);
+    return MAX(delta, fabsf(lambda_n - old_n));
+}
+
+// After the last substep, contacts that approached faster than threshold at pre-solve and
+// pushed in some substep bounce back with the restitution. Only the normal impulse changes.
+float penetration_constraint_restitution(PenetrationConstraint *c, float threshold)
+{
+    // the bias is -e times the approach velocity
+    float e = MIN(c->a->restitution, c->b->restitution);
+    if (e == 0.0f || c->bias > -threshold * e || c->max_normal_impulse == 0.0f)
+        return 0.0f;
 
-    body_apply_impulse_linear(c->b, (Vec2){MATMN_AT(impulses, 3, 0), MATMN_AT(impulses, 4, 0)});
-    body_apply_impulse_angular(c->b, MATMN_AT(impulses, 5, 0));
+    Vec2 jv = penetration_constraint_relative_velocity(c);
+    Mat21 lambda = {{{-(jv.x + c->bias) * c->normal_mass}, {0.0f}}};
+    return penetration_constraint_accumulate(c, lambda);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,252 @@
+#ifndef CONSTRAINT_SYSTEM_H
+#define CONSTRAINT_SYSTEM_H
+
+#include <math.h>
+#include <string.h>
+
+#include "body.h"
+#include "constraint.h"
+#include "matmn.h"
+#include "mem.h"
+
+// The pre-solved constraints of a step as one mixed LCP over the velocities of all bodies,
+// J @ invM @ J.T @ lambda = -(J @ v + bias) with bounds on lambda, solved by projected
+// Gauss-Seidel instead of one constraint at a time. Joints add one row, contacts a normal
+// row and a tangent row bounded by friction times the normal impulse. The columns of J are
+// (v.x, v.y, omega) of each body, by world_index.
+typedef struct
+{
+    MatCSR jacobian;
+    MatCSR jacobian_T;
+    MatCSR lhs;
+
+    // per row, lambda_start is the warm start lambda came in with
+    float *rhs;
+    float *lambda;
+    float *lambda_start;
+    float *lo;
+    float *hi;
+    int *findex;
+    float *inv_diagonal;
+    unsigned int row_capacity;
+
+    // per column
+    float *inv_mass;
+    float *velocity;
+    float *impulse;
+    unsigned int col_capacity;
+
+    // the constraints in row order, to hand their impulses back
+    JointConstraint **joints;
+    unsigned int joints_capacity;
+    unsigned int n_joints;
+    PenetrationConstraint **contacts;
+    unsigned int contacts_capacity;
+    unsigned int n_contacts;
+
+    // how far lambda moved in the last sweep of constraint_system_solve
+    SolverResidual residual;
+} ConstraintSystem;
+
+void constraint_system_create(ConstraintSystem *s)
+{
+    memset(s, 0, sizeof(ConstraintSystem));
+    matcsr_create(&s->jacobian);
+    matcsr_create(&s->jacobian_T);
+    matcsr_create(&s->lhs);
+}
+
+void constraint_system_destroy(ConstraintSystem *s)
+{
+    matcsr_destroy(&s->jacobian);
+    matcsr_destroy(&s->jacobian_T);
+    matcsr_destroy(&s->lhs);
+    mem_free(s->rhs);
+    mem_free(s->lambda);
+    mem_free(s->lambda_start);
+    mem_free(s->lo);
+    mem_free(s->hi);
+    mem_free(s->findex);
+    mem_free(s->inv_diagonal);
+    mem_free(s->inv_mass);
+    mem_free(s->velocity);
+    mem_free(s->impulse);
+    mem_free(s->joints);
+    mem_free(s->contacts);
+    constraint_system_create(s);
+}
+
+MatMN constraint_system_vector(float *data, unsigned int m)
+{
+    return (MatMN){m, 1, data};
+}
+
+void constraint_system_begin(ConstraintSystem *s, unsigned int n_bodies)
+{
+    matcsr_clear(&s->jacobian, 3 * n_bodies);
+    s->n_joints = 0;
+    s->n_contacts = 0;
+}
+
+// appends one row of jacobian between a and b, with its bias, bounds and warm start
+void constraint_system_push_row(ConstraintSystem *s, Body *a, Body *b, const float jacobian[6], float bias, float lambda, float lo, float hi, int findex)
+{
+    unsigned int row = s->jacobian.m;
+    if (row + 1 > s->row_capacity)
+    {
+        s->row_capacity = (2 * s->row_capacity > row + 1) ? 2 * s->row_capacity : 64;
+        size_t size = s->row_capacity * sizeof(float);
+        s->rhs = (float *)mem_realloc(s->rhs, size);
+        s->lambda = (float *)mem_realloc(s->lambda, size);
+        s->lambda_start = (float *)mem_realloc(s->lambda_start, size);
+        s->lo = (float *)mem_realloc(s->lo, size);
+        s->hi = (float *)mem_realloc(s->hi, size);
+        s->findex = (int *)mem_realloc(s->findex, s->row_capacity * sizeof(int));
+        s->inv_diagonal = (float *)mem_realloc(s->inv_diagonal, size);
+    }
+
+    for (unsigned int k = 0; k < 3; k++)
+    {
+        if (jacobian[k] != 0)
+            matcsr_push(&s->jacobian, 3 * a->world_index + k, jacobian[k]);
+    }
+    for (unsigned int k = 0; k < 3; k++)
+    {
+        if (jacobian[3 + k] != 0)
+            matcsr_push(&s->jacobian, 3 * b->world_index + k, jacobian[3 + k]);
+    }
+    matcsr_end_row(&s->jacobian);
+
+    // the rest of the rhs is added by constraint_system_end
+    s->rhs[row] = -bias;
+    s->lambda[row] = lambda;
+    s->lambda_start[row] = lambda;
+    s->lo[row] = lo;
+    s->hi[row] = hi;
+    s->findex[row] = findex;
+}
+
+// joints go in before contacts
+void constraint_system_add_joint(ConstraintSystem *s, JointConstraint *c)
+{
+    assert(s->n_contacts == 0);
+
+    s->joints = (JointConstraint **)mem_grow(s->joints, &s->joints_capacity, s->n_joints + 1, sizeof(JointConstraint *));
+    s->joints[s->n_joints++] = c;
+    constraint_system_push_row(s, c->a, c->b, c->jacobian.data[0], c->bias, c->cached_lambda.data[0][0], -INFINITY, INFINITY, MATCSR_NO_FINDEX);
+}
+
+void constraint_system_add_contact(ConstraintSystem *s, PenetrationConstraint *c)
+{
+    s->contacts = (PenetrationConstraint **)mem_grow(s->contacts, &s->contacts_capacity, s->n_contacts + 1, sizeof(PenetrationConstraint *));
+    s->contacts[s->n_contacts++] = c;
+
+    unsigned int normal_row = s->jacobian.m;
+    float normal[6] = {-c->n.x, -c->n.y, -vec2_cross(c->ra, c->n), c->n.x, c->n.y, vec2_cross(c->rb, c->n)};
+    constraint_system_push_row(s, c->a, c->b, normal, c->bias, c->cached_lambda.data[0][0], 0.0f, INFINITY, MATCSR_NO_FINDEX);
+
+    // an empty row without friction, the solver leaves it alone
+    float tangent[6] = {0};
+    if (c->friction > 0)
+    {
+        float row[6] = {-c->t.x, -c->t.y, -vec2_cross(c->ra, c->t), c->t.x, c->t.y, vec2_cross(c->rb, c->t)};
+        memcpy(tangent, row, sizeof(row));
+    }
+    constraint_system_push_row(s, c->a, c->b, tangent, 0.0f, c->cached_lambda.data[1][0], 0.0f, c->friction, (int)normal_row);
+}
+
+// Builds J @ invM @ J.T and the rhs. The bodies carry the warm start impulses already, so the
+// rhs is -(J @ v + bias) + J @ invM @ J.T @ lambda_start, taking them out again.
+void constraint_system_end(ConstraintSystem *s, Body *bodies, unsigned int n_bodies)
+{
+    unsigned int n_cols = 3 * n_bodies;
+    if (n_cols > s->col_capacity)
+    {
+        s->col_capacity = (2 * s->col_capacity > n_cols) ? 2 * s->col_capacity : n_cols;
+        size_t size = s->col_capacity * sizeof(float);
+        s->inv_mass = (float *)mem_realloc(s->inv_mass, size);
+        s->velocity = (float *)mem_realloc(s->velocity, size);
+        s->impulse = (float *)mem_realloc(s->impulse, size);
+    }
+
+    for (unsigned int i = 0; i < n_bodies; i++)
+    {
+        Body *b = &bodies[i];
+        bool moves = b->inv_mass != 0;
+        s->inv_mass[3 * i] = moves ? b->inv_mass : 0.0f;
+        s->inv_mass[3 * i + 1] = moves ? b->inv_mass : 0.0f;
+        s->inv_mass[3 * i + 2] = moves ? b->inv_inertia : 0.0f;
+        s->velocity[3 * i] = b->velocity.x;
+        s->velocity[3 * i + 1] = b->velocity.y;
+        s->velocity[3 * i + 2] = b->omega;
+    }
+
+    MatMN inv_mass = constraint_system_vector(s->inv_mass, n_cols);
+    matcsr_transpose(&s->jacobian, &s->jacobian_T);
+    matcsr_mul_diag_transpose(&s->jacobian, &inv_mass, &s->jacobian_T, &s->lhs);
+
+    MatMN velocity = constraint_system_vector(s->velocity, n_cols);
+    MatMN lambda_start = constraint_system_vector(s->lambda_start, s->jacobian.m);
+    for (unsigned int i = 0; i < s->jacobian.m; i++)
+    {
+        s->rhs[i] += matcsr_row_dot(&s->lhs, i, &lambda_start) - matcsr_row_dot(&s->jacobian, i, &velocity);
+    }
+}
+
+// Sweeps until no lambda moved by more than tolerance, but at least min_iterations and at most
+// max_iterations times. Returns the number of sweeps.
+unsigned int constraint_system_solve(ConstraintSystem *s, unsigned int min_iterations, unsigned int max_iterations, float tolerance)
+{
+    unsigned int m = s->jacobian.m;
+    MatMN rhs = constraint_system_vector(s->rhs, m);
+    MatMN lambda = constraint_system_vector(s->lambda, m);
+    MatMN lo = constraint_system_vector(s->lo, m);
+    MatMN hi = constraint_system_vector(s->hi, m);
+    matcsr_inv_diagonal(&s->lhs, s->inv_diagonal);
+
+    unsigned int iter = 0;
+    s->residual = (SolverResidual){0};
+    while (iter < max_iterations)
+    {
+        s->residual = (SolverResidual){0, 0, m};
+        s->residual.max = matcsr_sweep_pgs(&s->lhs, &rhs, &lambda, &lo, &hi, s->findex, s->inv_diagonal, &s->residual.sum_squares);
+        iter++;
+        if (iter >= min_iterations && s->residual.max <= tolerance)
+            break;
+    }
+    return iter;
+}
+
+// applies J.T @ (lambda - lambda_start) to the bodies and hands lambda back to the constraints
+void constraint_system_apply(ConstraintSystem *s, Body *bodies)
+{
+    unsigned int m = s->jacobian.m;
+    for (unsigned int i = 0; i < m; i++)
+    {
+        s->lambda_start[i] = s->lambda[i] - s->lambda_start[i];
+    }
+    MatMN delta_lambda = constraint_system_vector(s->lambda_start, m);
+    MatMN impulse = constraint_system_vector(s->impulse, s->jacobian.n);
+    matcsr_mul(&s->jacobian_T, &delta_lambda, &impulse);
+
+    for (unsigned int i = 0; 3 * i < s->jacobian.n; i++)
+    {
+        if (s->jacobian_T.row_start[3 * i] == s->jacobian_T.row_start[3 * i + 3])
+            continue;
+        body_apply_impulse_linear(&bodies[i], (Vec2){.x = s->impulse[3 * i], .y = s->impulse[3 * i + 1]});
+        body_apply_impulse_angular(&bodies[i], s->impulse[3 * i + 2]);
+    }
+
+    unsigned int row = 0;
+    for (unsigned int i = 0; i < s->n_joints; i++)
+    {
+        s->joints[i]->cached_lambda.data[0][0] = s->lambda[row++];
+    }
+    for (unsigned int i = 0; i < s->n_contacts; i++)
+    {
+        s->contacts[i]->cached_lambda.data[0][0] = s->lambda[row++];
+        s->contacts[i]->cached_lambda.data[1][0] = s->lambda[row++];
+    }
+}
+
+#endif
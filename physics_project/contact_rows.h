@@ -0,0 +1,380 @@
+#ifndef CONTACT_ROWS_H
+#define CONTACT_ROWS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "body.h"
+#include "constraint.h"
+#include "mem.h"
+
+// rows are solved in batches of this many, runs of rows handed to contact_rows_solve start
+// and end on a multiple of it
+#define CONTACT_ROWS_WIDTH 8
+
+// Pre-solved contact constraints as structure of arrays, one row per contact. No two rows
+// of a batch may share a moving body, as with the constraints of one color. The solver
+// gathers the velocities of 4 (SSE2) or 8 (AVX) rows from the bodies, solves them at once
+// and scatters the new velocities back.
+typedef struct
+{
+    // world_index of the bodies, padding rows point at body 0 and change nothing
+    int32_t *body_a;
+    int32_t *body_b;
+    float *normal_x;
+    float *normal_y;
+    float *tangent_x;
+    float *tangent_y;
+    // angular jacobian terms ra x n, ra x t, rb x n, rb x t
+    float *ra_cross_n;
+    float *ra_cross_t;
+    float *rb_cross_n;
+    float *rb_cross_t;
+    // zero for static bodies, whose velocities are never written
+    float *inv_mass_a;
+    float *inv_inertia_a;
+    float *inv_mass_b;
+    float *inv_inertia_b;
+    // the inverse effective mass of (normal, tangent), it is symmetric
+    float *mass_nn;
+    float *mass_nt;
+    float *mass_tt;
+    float *bias;
+    float *friction;
+    // accumulated impulses
+    float *lambda_n;
+    float *lambda_t;
+
+    unsigned int n_rows;
+    unsigned int capacity;
+} ContactRows;
+
+// velocities of the bodies of a batch, lane k for row begin + k
+typedef struct
+{
+    float vax[CONTACT_ROWS_WIDTH];
+    float vay[CONTACT_ROWS_WIDTH];
+    float wa[CONTACT_ROWS_WIDTH];
+    float vbx[CONTACT_ROWS_WIDTH];
+    float vby[CONTACT_ROWS_WIDTH];
+    float wb[CONTACT_ROWS_WIDTH];
+} ContactLanes;
+
+void contact_rows_create(ContactRows *r)
+{
+    memset(r, 0, sizeof(ContactRows));
+}
+
+void contact_rows_destroy(ContactRows *r)
+{
+    mem_free(r->body_a);
+    mem_free(r->body_b);
+    mem_free(r->normal_x);
+    mem_free(r->normal_y);
+    mem_free(r->tangent_x);
+    mem_free(r->tangent_y);
+    mem_free(r->ra_cross_n);
+    mem_free(r->ra_cross_t);
+    mem_free(r->rb_cross_n);
+    mem_free(r->rb_cross_t);
+    mem_free(r->inv_mass_a);
+    mem_free(r->inv_inertia_a);
+    mem_free(r->inv_mass_b);
+    mem_free(r->inv_inertia_b);
+    mem_free(r->mass_nn);
+    mem_free(r->mass_nt);
+    mem_free(r->mass_tt);
+    mem_free(r->bias);
+    mem_free(r->friction);
+    mem_free(r->lambda_n);
+    mem_free(r->lambda_t);
+    contact_rows_create(r);
+}
+
+// makes room for n_rows rows, filled by contact_rows_set and contact_rows_clear
+void contact_rows_resize(ContactRows *r, unsigned int n_rows)
+{
+    r->n_rows = n_rows;
+    if (n_rows <= r->capacity)
+        return;
+
+    r->capacity = (2 * r->capacity > n_rows) ? 2 * r->capacity : n_rows;
+    size_t size = r->capacity * sizeof(float);
+    r->body_a = (int32_t *)mem_realloc(r->body_a, r->capacity * sizeof(int32_t));
+    r->body_b = (int32_t *)mem_realloc(r->body_b, r->capacity * sizeof(int32_t));
+    r->normal_x = (float *)mem_realloc(r->normal_x, size);
+    r->normal_y = (float *)mem_realloc(r->normal_y, size);
+    r->tangent_x = (float *)mem_realloc(r->tangent_x, size);
+    r->tangent_y = (float *)mem_realloc(r->tangent_y, size);
+    r->ra_cross_n = (float *)mem_realloc(r->ra_cross_n, size);
+    r->ra_cross_t = (float *)mem_realloc(r->ra_cross_t, size);
+    r->rb_cross_n = (float *)mem_realloc(r->rb_cross_n, size);
+    r->rb_cross_t = (float *)mem_realloc(r->rb_cross_t, size);
+    r->inv_mass_a = (float *)mem_realloc(r->inv_mass_a, size);
+    r->inv_inertia_a = (float *)mem_realloc(r->inv_inertia_a, size);
+    r->inv_mass_b = (float *)mem_realloc(r->inv_mass_b, size);
+    r->inv_inertia_b = (float *)mem_realloc(r->inv_inertia_b, size);
+    r->mass_nn = (float *)mem_realloc(r->mass_nn, size);
+    r->mass_nt = (float *)mem_realloc(r->mass_nt, size);
+    r->mass_tt = (float *)mem_realloc(r->mass_tt, size);
+    r->bias = (float *)mem_realloc(r->bias, size);
+    r->friction = (float *)mem_realloc(r->friction, size);
+    r->lambda_n = (float *)mem_realloc(r->lambda_n, size);
+    r->lambda_t = (float *)mem_realloc(r->lambda_t, size);
+}
+
+// fills row i from a contact after penetration_constraint_pre_solve
+void contact_rows_set(ContactRows *r, unsigned int i, PenetrationConstraint *c)
+{
+    bool a_static = c->a->inv_mass == 0;
+    bool b_static = c->b->inv_mass == 0;
+
+    r->body_a[i] = c->a->world_index;
+    r->body_b[i] = c->b->world_index;
+    r->normal_x[i] = c->n.x;
+    r->normal_y[i] = c->n.y;
+    r->tangent_x[i] = c->t.x;
+    r->tangent_y[i] = c->t.y;
+    r->ra_cross_n[i] = vec2_cross(c->ra, c->n);
+    r->ra_cross_t[i] = vec2_cross(c->ra, c->t);
+    r->rb_cross_n[i] = vec2_cross(c->rb, c->n);
+    r->rb_cross_t[i] = vec2_cross(c->rb, c->t);
+    r->inv_mass_a[i] = c->a->inv_mass;
+    r->inv_inertia_a[i] = a_static ? 0.0f : c->a->inv_inertia;
+    r->inv_mass_b[i] = c->b->inv_mass;
+    r->inv_inertia_b[i] = b_static ? 0.0f : c->b->inv_inertia;
+    r->mass_nn[i] = c->inv_effective_mass.data[0][0];
+    r->mass_nt[i] = c->inv_effective_mass.data[0][1];
+    r->mass_tt[i] = c->inv_effective_mass.data[1][1];
+    r->bias[i] = c->bias;
+    r->friction[i] = c->friction;
+    r->lambda_n[i] = c->cached_lambda.data[0][0];
+    r->lambda_t[i] = c->cached_lambda.data[1][0];
+}
+
+// makes row i a padding row, it solves to zero impulses on body 0 and writes nothing
+void contact_rows_clear(ContactRows *r, unsigned int i)
+{
+    r->body_a[i] = 0;
+    r->body_b[i] = 0;
+    r->normal_x[i] = r->normal_y[i] = 0;
+    r->tangent_x[i] = r->tangent_y[i] = 0;
+    r->ra_cross_n[i] = r->ra_cross_t[i] = r->rb_cross_n[i] = r->rb_cross_t[i] = 0;
+    r->inv_mass_a[i] = r->inv_inertia_a[i] = r->inv_mass_b[i] = r->inv_inertia_b[i] = 0;
+    r->mass_nn[i] = r->mass_nt[i] = r->mass_tt[i] = 0;
+    r->bias[i] = r->friction[i] = 0;
+    r->lambda_n[i] = r->lambda_t[i] = 0;
+}
+
+// hands the accumulated impulses of row i back to its contact
+void contact_rows_store_lambda(ContactRows *r, unsigned int i, PenetrationConstraint *c)
+{
+    c->cached_lambda.data[0][0] = r->lambda_n[i];
+    c->cached_lambda.data[1][0] = r->lambda_t[i];
+}
+
+void contact_rows_gather(ContactRows *r, Body *bodies, unsigned int begin, unsigned int width, ContactLanes *l)
+{
+    for (unsigned int k = 0; k < width; k++)
+    {
+        Body *a = &bodies[r->body_a[begin + k]];
+        Body *b = &bodies[r->body_b[begin + k]];
+        l->vax[k] = a->velocity.x;
+        l->vay[k] = a->velocity.y;
+        l->wa[k] = a->omega;
+        l->vbx[k] = b->velocity.x;
+        l->vby[k] = b->velocity.y;
+        l->wb[k] = b->omega;
+    }
+}
+
+// writes back the velocities of the moving bodies, static ones and padding rows are skipped
+void contact_rows_scatter(ContactRows *r, Body *bodies, unsigned int begin, unsigned int width, ContactLanes *l)
+{
+    for (unsigned int k = 0; k < width; k++)
+    {
+        if (r->inv_mass_a[begin + k] != 0)
+        {
+            Body *a = &bodies[r->body_a[begin + k]];
+            a->velocity = (Vec2){.x = l->vax[k], .y = l->vay[k]};
+            a->omega = l->wa[k];
+        }
+        if (r->inv_mass_b[begin + k] != 0)
+        {
+            Body *b = &bodies[r->body_b[begin + k]];
+            b->velocity = (Vec2){.x = l->vbx[k], .y = l->vby[k]};
+            b->omega = l->wb[k];
+        }
+    }
+}
+
+// adds the impulse changes of a batch to residual, padding rows move nothing and are left out
+void contact_rows_add_residual(ContactRows *r, unsigned int begin, unsigned int width, const float *delta, SolverResidual *residual)
+{
+    for (unsigned int k = 0; k < width; k++)
+    {
+        if (r->inv_mass_a[begin + k] != 0 || r->inv_mass_b[begin + k] != 0)
+            solver_residual_add(residual, delta[k]);
+    }
+}
+
+// One row, the scalar reference for the batches below, which compute the same in the same
+// order. Matches penetration_constraint_solve up to rounding. Returns the largest change of
+// the two impulses.
+float contact_rows_solve_lane(ContactRows *r, Body *bodies, unsigned int i)
+{
+    ContactLanes l;
+    contact_rows_gather(r, bodies, i, 1, &l);
+
+    float dvx = l.vbx[0] - l.vax[0];
+    float dvy = l.vby[0] - l.vay[0];
+    float vn = r->normal_x[i] * dvx + r->normal_y[i] * dvy + r->rb_cross_n[i] * l.wb[0] - r->ra_cross_n[i] * l.wa[0];
+    float vt = r->tangent_x[i] * dvx + r->tangent_y[i] * dvy + r->rb_cross_t[i] * l.wb[0] - r->ra_cross_t[i] * l.wa[0];
+    float rhs_n = (0.0f - vn) - r->bias[i];
+    float rhs_t = 0.0f - vt;
+
+    float old_n = r->lambda_n[i];
+    float old_t = r->lambda_t[i];
+    float lambda_n = old_n + (r->mass_nn[i] * rhs_n + r->mass_nt[i] * rhs_t);
+    float lambda_t = old_t + (r->mass_nt[i] * rhs_n + r->mass_tt[i] * rhs_t);
+    lambda_n = (lambda_n > 0.0f) ? lambda_n : 0.0f;
+    float max_friction = lambda_n * r->friction[i];
+    lambda_t = (lambda_t > 0.0f - max_friction) ? lambda_t : 0.0f - max_friction;
+    lambda_t = (lambda_t < max_friction) ? lambda_t : max_friction;
+    r->lambda_n[i] = lambda_n;
+    r->lambda_t[i] = lambda_t;
+
+    float dn = lambda_n - old_n;
+    float dt = lambda_t - old_t;
+    float px = r->normal_x[i] * dn + r->tangent_x[i] * dt;
+    float py = r->normal_y[i] * dn + r->tangent_y[i] * dt;
+    l.vax[0] -= px * r->inv_mass_a[i];
+    l.vay[0] -= py * r->inv_mass_a[i];
+    l.wa[0] -= (r->ra_cross_n[i] * dn + r->ra_cross_t[i] * dt) * r->inv_inertia_a[i];
+    l.vbx[0] += px * r->inv_mass_b[i];
+    l.vby[0] += py * r->inv_mass_b[i];
+    l.wb[0] += (r->rb_cross_n[i] * dn + r->rb_cross_t[i] * dt) * r->inv_inertia_b[i];
+
+    contact_rows_scatter(r, bodies, i, 1, &l);
+    return MAX(fabsf(dn), fabsf(dt));
+}
+
+// One sequential impulse pass over the rows [begin, end), adding how far their impulses moved
+// to residual
+void contact_rows_solve(ContactRows *r, Body *bodies, unsigned int begin, unsigned int end, SolverResidual *residual)
+{
+    unsigned int i = begin;
+    ContactLanes l;
+    float delta[CONTACT_ROWS_WIDTH];
+#if defined(__AVX__)
+    for (; i + 8 <= end; i += 8)
+    {
+        contact_rows_gather(r, bodies, i, 8, &l);
+        __m256 vax = _mm256_loadu_ps(l.vax), vay = _mm256_loadu_ps(l.vay), wa = _mm256_loadu_ps(l.wa);
+        __m256 vbx = _mm256_loadu_ps(l.vbx), vby = _mm256_loadu_ps(l.vby), wb = _mm256_loadu_ps(l.wb);
+        __m256 nx = _mm256_loadu_ps(&r->normal_x[i]), ny = _mm256_loadu_ps(&r->normal_y[i]);
+        __m256 tx = _mm256_loadu_ps(&r->tangent_x[i]), ty = _mm256_loadu_ps(&r->tangent_y[i]);
+        __m256 ran = _mm256_loadu_ps(&r->ra_cross_n[i]), rat = _mm256_loadu_ps(&r->ra_cross_t[i]);
+        __m256 rbn = _mm256_loadu_ps(&r->rb_cross_n[i]), rbt = _mm256_loadu_ps(&r->rb_cross_t[i]);
+        __m256 mass_nt = _mm256_loadu_ps(&r->mass_nt[i]);
+
+        __m256 dvx = _mm256_sub_ps(vbx, vax);
+        __m256 dvy = _mm256_sub_ps(vby, vay);
+        __m256 vn = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, dvx), _mm256_mul_ps(ny, dvy)), _mm256_mul_ps(rbn, wb)), _mm256_mul_ps(ran, wa));
+        __m256 vt = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, dvx), _mm256_mul_ps(ty, dvy)), _mm256_mul_ps(rbt, wb)), _mm256_mul_ps(rat, wa));
+        __m256 rhs_n = _mm256_sub_ps(_mm256_sub_ps(_mm256_setzero_ps(), vn), _mm256_loadu_ps(&r->bias[i]));
+        __m256 rhs_t = _mm256_sub_ps(_mm256_setzero_ps(), vt);
+
+        __m256 old_n = _mm256_loadu_ps(&r->lambda_n[i]);
+        __m256 old_t = _mm256_loadu_ps(&r->lambda_t[i]);
+        __m256 lambda_n = _mm256_add_ps(old_n, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&r->mass_nn[i]), rhs_n), _mm256_mul_ps(mass_nt, rhs_t)));
+        __m256 lambda_t = _mm256_add_ps(old_t, _mm256_add_ps(_mm256_mul_ps(mass_nt, rhs_n), _mm256_mul_ps(_mm256_loadu_ps(&r->mass_tt[i]), rhs_t)));
+        lambda_n = _mm256_max_ps(lambda_n, _mm256_setzero_ps());
+        __m256 max_friction = _mm256_mul_ps(lambda_n, _mm256_loadu_ps(&r->friction[i]));
+        lambda_t = _mm256_max_ps(lambda_t, _mm256_sub_ps(_mm256_setzero_ps(), max_friction));
+        lambda_t = _mm256_min_ps(lambda_t, max_friction);
+        _mm256_storeu_ps(&r->lambda_n[i], lambda_n);
+        _mm256_storeu_ps(&r->lambda_t[i], lambda_t);
+
+        __m256 dn = _mm256_sub_ps(lambda_n, old_n);
+        __m256 dt = _mm256_sub_ps(lambda_t, old_t);
+        __m256 sign = _mm256_set1_ps(-0.0f);
+        _mm256_storeu_ps(delta, _mm256_max_ps(_mm256_andnot_ps(sign, dn), _mm256_andnot_ps(sign, dt)));
+        __m256 px = _mm256_add_ps(_mm256_mul_ps(nx, dn), _mm256_mul_ps(tx, dt));
+        __m256 py = _mm256_add_ps(_mm256_mul_ps(ny, dn), _mm256_mul_ps(ty, dt));
+        __m256 inv_mass_a = _mm256_loadu_ps(&r->inv_mass_a[i]);
+        __m256 inv_mass_b = _mm256_loadu_ps(&r->inv_mass_b[i]);
+        __m256 dwa = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ran, dn), _mm256_mul_ps(rat, dt)), _mm256_loadu_ps(&r->inv_inertia_a[i]));
+        __m256 dwb = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(rbn, dn), _mm256_mul_ps(rbt, dt)), _mm256_loadu_ps(&r->inv_inertia_b[i]));
+        _mm256_storeu_ps(l.vax, _mm256_sub_ps(vax, _mm256_mul_ps(px, inv_mass_a)));
+        _mm256_storeu_ps(l.vay, _mm256_sub_ps(vay, _mm256_mul_ps(py, inv_mass_a)));
+        _mm256_storeu_ps(l.wa, _mm256_sub_ps(wa, dwa));
+        _mm256_storeu_ps(l.vbx, _mm256_add_ps(vbx, _mm256_mul_ps(px, inv_mass_b)));
+        _mm256_storeu_ps(l.vby, _mm256_add_ps(vby, _mm256_mul_ps(py, inv_mass_b)));
+        _mm256_storeu_ps(l.wb, _mm256_add_ps(wb, dwb));
+        contact_rows_scatter(r, bodies, i, 8, &l);
+        contact_rows_add_residual(r, i, 8, delta, residual);
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 4 <= end; i += 4)
+    {
+        contact_rows_gather(r, bodies, i, 4, &l);
+        __m128 vax = _mm_loadu_ps(l.vax), vay = _mm_loadu_ps(l.vay), wa = _mm_loadu_ps(l.wa);
+        __m128 vbx = _mm_loadu_ps(l.vbx), vby = _mm_loadu_ps(l.vby), wb = _mm_loadu_ps(l.wb);
+        __m128 nx = _mm_loadu_ps(&r->normal_x[i]), ny = _mm_loadu_ps(&r->normal_y[i]);
+        __m128 tx = _mm_loadu_ps(&r->tangent_x[i]), ty = _mm_loadu_ps(&r->tangent_y[i]);
+        __m128 ran = _mm_loadu_ps(&r->ra_cross_n[i]), rat = _mm_loadu_ps(&r->ra_cross_t[i]);
+        __m128 rbn = _mm_loadu_ps(&r->rb_cross_n[i]), rbt = _mm_loadu_ps(&r->rb_cross_t[i]);
+        __m128 mass_nt = _mm_loadu_ps(&r->mass_nt[i]);
+
+        __m128 dvx = _mm_sub_ps(vbx, vax);
+        __m128 dvy = _mm_sub_ps(vby, vay);
+        __m128 vn = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, dvx), _mm_mul_ps(ny, dvy)), _mm_mul_ps(rbn, wb)), _mm_mul_ps(ran, wa));
+        __m128 vt = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, dvx), _mm_mul_ps(ty, dvy)), _mm_mul_ps(rbt, wb)), _mm_mul_ps(rat, wa));
+        __m128 rhs_n = _mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), vn), _mm_loadu_ps(&r->bias[i]));
+        __m128 rhs_t = _mm_sub_ps(_mm_setzero_ps(), vt);
+
+        __m128 old_n = _mm_loadu_ps(&r->lambda_n[i]);
+        __m128 old_t = _mm_loadu_ps(&r->lambda_t[i]);
+        __m128 lambda_n = _mm_add_ps(old_n, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&r->mass_nn[i]), rhs_n), _mm_mul_ps(mass_nt, rhs_t)));
+        __m128 lambda_t = _mm_add_ps(old_t, _mm_add_ps(_mm_mul_ps(mass_nt, rhs_n), _mm_mul_ps(_mm_loadu_ps(&r->mass_tt[i]), rhs_t)));
+        lambda_n = _mm_max_ps(lambda_n, _mm_setzero_ps());
+        __m128 max_friction = _mm_mul_ps(lambda_n, _mm_loadu_ps(&r->friction[i]));
+        lambda_t = _mm_max_ps(lambda_t, _mm_sub_ps(_mm_setzero_ps(), max_friction));
+        lambda_t = _mm_min_ps(lambda_t, max_friction);
+        _mm_storeu_ps(&r->lambda_n[i], lambda_n);
+        _mm_storeu_ps(&r->lambda_t[i], lambda_t);
+
+        __m128 dn = _mm_sub_ps(lambda_n, old_n);
+        __m128 dt = _mm_sub_ps(lambda_t, old_t);
+        __m128 sign = _mm_set1_ps(-0.0f);
+        _mm_storeu_ps(delta, _mm_max_ps(_mm_andnot_ps(sign, dn), _mm_andnot_ps(sign, dt)));
+        __m128 px = _mm_add_ps(_mm_mul_ps(nx, dn), _mm_mul_ps(tx, dt));
+        __m128 py = _mm_add_ps(_mm_mul_ps(ny, dn), _mm_mul_ps(ty, dt));
+        __m128 inv_mass_a = _mm_loadu_ps(&r->inv_mass_a[i]);
+        __m128 inv_mass_b = _mm_loadu_ps(&r->inv_mass_b[i]);
+        __m128 dwa = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ran, dn), _mm_mul_ps(rat, dt)), _mm_loadu_ps(&r->inv_inertia_a[i]));
+        __m128 dwb = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(rbn, dn), _mm_mul_ps(rbt, dt)), _mm_loadu_ps(&r->inv_inertia_b[i]));
+        _mm_storeu_ps(l.vax, _mm_sub_ps(vax, _mm_mul_ps(px, inv_mass_a)));
+        _mm_storeu_ps(l.vay, _mm_sub_ps(vay, _mm_mul_ps(py, inv_mass_a)));
+        _mm_storeu_ps(l.wa, _mm_sub_ps(wa, dwa));
+        _mm_storeu_ps(l.vbx, _mm_add_ps(vbx, _mm_mul_ps(px, inv_mass_b)));
+        _mm_storeu_ps(l.vby, _mm_add_ps(vby, _mm_mul_ps(py, inv_mass_b)));
+        _mm_storeu_ps(l.wb, _mm_add_ps(wb, dwb));
+        contact_rows_scatter(r, bodies, i, 4, &l);
+        contact_rows_add_residual(r, i, 4, delta, residual);
+    }
+#endif
+    for (; i < end; i++)
+    {
+        delta[0] = contact_rows_solve_lane(r, bodies, i);
+        contact_rows_add_residual(r, i, 1, delta, residual);
+    }
+}
+
+#endif
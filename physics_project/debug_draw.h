@@ -0,0 +1,73 @@
+#ifndef DEBUG_DRAW_H
+#define DEBUG_DRAW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mem.h"
+#include "vec2.h"
+
+typedef enum
+{
+    DEBUG_DRAW_POINT,
+    DEBUG_DRAW_LINE
+} DebugDrawType;
+
+// a point at a, or a line from a to b
+typedef struct
+{
+    DebugDrawType type;
+    Vec2 a;
+    Vec2 b;
+    uint8_t color[3];
+} DebugDrawCommand;
+
+// What the physics would like drawn, recorded while it runs and drawn by whoever shows the
+// world. Nothing is recorded unless enabled.
+typedef struct
+{
+    bool enabled;
+    DebugDrawCommand *commands;
+    unsigned int n_commands;
+    unsigned int capacity;
+} DebugDraw;
+
+void debug_draw_create(DebugDraw *d)
+{
+    d->enabled = false;
+    d->commands = NULL;
+    d->n_commands = 0;
+    d->capacity = 0;
+}
+
+void debug_draw_destroy(DebugDraw *d)
+{
+    mem_free(d->commands);
+    debug_draw_create(d);
+}
+
+void debug_draw_clear(DebugDraw *d)
+{
+    d->n_commands = 0;
+}
+
+void debug_draw_push(DebugDraw *d, DebugDrawCommand command)
+{
+    if (!d->enabled)
+        return;
+
+    d->commands = (DebugDrawCommand *)mem_grow(d->commands, &d->capacity, d->n_commands + 1, sizeof(DebugDrawCommand));
+    d->commands[d->n_commands++] = command;
+}
+
+void debug_draw_point(DebugDraw *d, Vec2 p, uint8_t color[3])
+{
+    debug_draw_push(d, (DebugDrawCommand){DEBUG_DRAW_POINT, p, p, {color[0], color[1], color[2]}});
+}
+
+void debug_draw_line(DebugDraw *d, Vec2 a, Vec2 b, uint8_t color[3])
+{
+    debug_draw_push(d, (DebugDrawCommand){DEBUG_DRAW_LINE, a, b, {color[0], color[1], color[2]}});
+}
+
+#endif
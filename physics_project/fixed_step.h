@@ -0,0 +1,60 @@
+#ifndef FIXED_STEP_H
+#define FIXED_STEP_H
+
+#include <math.h>
+
+#include "world.h"
+
+// Runs world_update at a fixed rate whatever the frame rate. Frame time is collected and spent
+// in whole steps, at most max_steps a frame, so a slow frame cannot ask for more steps the next
+// one and fall further behind. Time beyond that is dropped. alpha is how far the time left over
+// reaches into the next step, to draw the bodies between the last two steps with
+// body_interpolate.
+typedef struct
+{
+    float step_time;
+    unsigned int max_steps;
+    double accumulator;
+    float alpha;
+
+    // steps run and seconds dropped so far
+    unsigned long n_steps;
+    double dropped_time;
+} FixedStep;
+
+void fixed_step_create(FixedStep *f, float rate, unsigned int max_steps)
+{
+    f->step_time = 1.0f / rate;
+    f->max_steps = max_steps;
+    f->accumulator = 0.0;
+    f->alpha = 0.0f;
+    f->n_steps = 0;
+    f->dropped_time = 0.0;
+}
+
+// advances w by frame_time seconds in whole steps, returns the number of steps
+unsigned int fixed_step_advance(FixedStep *f, World *w, float frame_time)
+{
+    f->accumulator += frame_time;
+
+    unsigned int steps = 0;
+    while (f->accumulator >= f->step_time && steps < f->max_steps)
+    {
+        world_update(w, f->step_time);
+        f->accumulator -= f->step_time;
+        steps++;
+    }
+
+    if (f->accumulator >= f->step_time)
+    {
+        double kept = fmod(f->accumulator, f->step_time);
+        f->dropped_time += f->accumulator - kept;
+        f->accumulator = kept;
+    }
+
+    f->alpha = (float)(f->accumulator / f->step_time);
+    f->n_steps += steps;
+    return steps;
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
 #include "vec2.h"
 #include "mem.h"
 
@@ -101,7 +102,7 @@ void gfx_draw_circle(int x, int y, int radius, float angle, uint8_t color[3])
 {
     unsigned int n_slices = 100;
 
-    mem_reset_scratch_pool();
+    ScratchMark mark = mem_scratch_push();
     SDL_Point *points = (SDL_Point *)mem_calloc(n_slices, sizeof(SDL_Point), MEM_SCRATCH_POOL);
     for (unsigned int i = 0; i < n_slices; i++)
     {
@@ -119,6 +120,8 @@ void gfx_draw_circle(int x, int y, int radius, float angle, uint8_t color[3])
 
     SDL_RenderDrawLine(gfx.renderer, x, y, (int)(x + radius * cosf(angle)), (int)(y + radius * sinf(angle)));
     gfx_draw_filled_square(x, y, 8, color);
+
+    mem_scratch_pop(mark);
 }
 
 void gfx_draw_line(int x0, int y0, int x1, int y1, uint8_t color[3])
@@ -129,7 +132,7 @@ void gfx_draw_line(int x0, int y0, int x1, int y1, uint8_t color[3])
 
 void gfx_draw_polygon(int x, int y, Vec2 *vertices, unsigned int n_vertices, uint8_t color[3])
 {
-    mem_reset_scratch_pool();
+    ScratchMark mark = mem_scratch_push();
     SDL_Point *points = (SDL_Point *)mem_calloc(n_vertices + 1, sizeof(SDL_Point), MEM_SCRATCH_POOL);
     for (unsigned int i = 0; i < n_vertices; i++)
     {
@@ -141,6 +144,21 @@ void gfx_draw_polygon(int x, int y, Vec2 *vertices, unsigned int n_vertices, uin
     SDL_RenderDrawLines(gfx.renderer, points, n_vertices + 1);
 
     gfx_draw_filled_square(x, y, 8, color);
+
+    mem_scratch_pop(mark);
+}
+
+// NULL if the image does not load
+SDL_Texture *gfx_load_texture(const char *file_name)
+{
+    SDL_Texture *texture = NULL;
+    SDL_Surface *surface = IMG_Load(file_name);
+    if (surface)
+    {
+        texture = SDL_CreateTextureFromSurface(gfx.renderer, surface);
+        SDL_FreeSurface(surface);
+    }
+    return texture;
 }
 
 void gfx_draw_texture(SDL_Texture *texture, int x, int y, float radian, int width, int height)
@@ -0,0 +1,284 @@
+#ifndef ISLAND_H
+#define ISLAND_H
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "body.h"
+#include "constraint.h"
+#include "linked_list.h"
+#include "mem.h"
+
+#define ISLAND_NONE 0xffffffffu
+
+typedef struct
+{
+    unsigned int island;
+    unsigned int n_constraints;
+} IslandOrder;
+
+// Groups the bodies of one step into islands, sets of dynamic bodies connected through
+// contacts and joints. Static bodies connect nothing and belong to no island.
+typedef struct
+{
+    // union find forest over body indices, then the island of each body
+    unsigned int *parent;
+    unsigned int parent_capacity;
+    unsigned int *island;
+    unsigned int island_capacity;
+    unsigned int n_bodies;
+
+    bool *awake;
+    unsigned int awake_capacity;
+    float *sleep_time;
+    unsigned int sleep_time_capacity;
+    unsigned int n_islands;
+
+    // constraints of the awake islands in world order, island k owns
+    // joints[joint_start[k]..joint_start[k + 1]) and contacts[contact_start[k]..contact_start[k + 1])
+    JointConstraint **joints;
+    unsigned int joints_capacity;
+    unsigned int *joint_start;
+    unsigned int joint_start_capacity;
+    PenetrationConstraint **contacts;
+    unsigned int contacts_capacity;
+    unsigned int *contact_start;
+    unsigned int contact_start_capacity;
+
+    // awake islands, largest first
+    IslandOrder *awake_islands;
+    unsigned int awake_islands_capacity;
+    unsigned int n_awake_islands;
+} Islands;
+
+void islands_create(Islands *is)
+{
+    memset(is, 0, sizeof(Islands));
+}
+
+void islands_destroy(Islands *is)
+{
+    mem_free(is->parent);
+    mem_free(is->island);
+    mem_free(is->awake);
+    mem_free(is->sleep_time);
+    mem_free(is->joints);
+    mem_free(is->joint_start);
+    mem_free(is->contacts);
+    mem_free(is->contact_start);
+    mem_free(is->awake_islands);
+    islands_create(is);
+}
+
+void islands_begin(Islands *is, unsigned int n_bodies)
+{
+    is->parent = (unsigned int *)mem_grow(is->parent, &is->parent_capacity, n_bodies, sizeof(unsigned int));
+    is->island = (unsigned int *)mem_grow(is->island, &is->island_capacity, n_bodies, sizeof(unsigned int));
+    is->n_bodies = n_bodies;
+    is->n_islands = 0;
+
+    for (unsigned int i = 0; i < n_bodies; i++)
+    {
+        is->parent[i] = i;
+    }
+}
+
+unsigned int islands_find(Islands *is, unsigned int i)
+{
+    // path halving
+    while (is->parent[i] != i)
+    {
+        is->parent[i] = is->parent[is->parent[i]];
+        i = is->parent[i];
+    }
+    return i;
+}
+
+void islands_union(Islands *is, unsigned int i, unsigned int j)
+{
+    i = islands_find(is, i);
+    j = islands_find(is, j);
+    if (i == j)
+        return;
+
+    // the smaller index becomes the root so islands are numbered in body order
+    if (i < j)
+        is->parent[j] = i;
+    else
+        is->parent[i] = j;
+}
+
+// Numbers the islands and works out which are awake, an island is awake if any of its bodies is
+void islands_end(Islands *is, Body *bodies)
+{
+    for (unsigned int i = 0; i < is->n_bodies; i++)
+    {
+        if (bodies[i].inv_mass == 0.0)
+        {
+            is->island[i] = ISLAND_NONE;
+            continue;
+        }
+
+        unsigned int root = islands_find(is, i);
+        if (root == i)
+        {
+            is->awake = (bool *)mem_grow(is->awake, &is->awake_capacity, is->n_islands + 1, sizeof(bool));
+            is->sleep_time = (float *)mem_grow(is->sleep_time, &is->sleep_time_capacity, is->n_islands + 1, sizeof(float));
+            is->awake[is->n_islands] = false;
+            is->island[i] = is->n_islands++;
+        }
+        else
+        {
+            // roots have the smallest index, so the root was numbered already
+            is->island[i] = is->island[root];
+        }
+
+        is->awake[is->island[i]] = is->awake[is->island[i]] || bodies[i].is_awake;
+    }
+}
+
+// Wakes every body of an awake island, so a sleeping pile wakes as a whole when touched
+void islands_wake(Islands *is, Body *bodies)
+{
+    for (unsigned int i = 0; i < is->n_bodies; i++)
+    {
+        if (is->island[i] != ISLAND_NONE && is->awake[is->island[i]] && !bodies[i].is_awake)
+            body_set_awake(&bodies[i], true);
+    }
+}
+
+// Advances the sleep timers of the awake bodies. An island sleeps once all of its bodies
+// stayed below the velocity tolerances for time_to_sleep.
+void islands_sleep(Islands *is, Body *bodies, float delta_time, float linear_tolerance, float angular_tolerance, float time_to_sleep)
+{
+    for (unsigned int k = 0; k < is->n_islands; k++)
+    {
+        is->sleep_time[k] = FLT_MAX;
+    }
+
+    for (unsigned int i = 0; i < is->n_bodies; i++)
+    {
+        Body *b = &bodies[i];
+        if (is->island[i] == ISLAND_NONE || !is->awake[is->island[i]])
+            continue;
+
+        if (vec2_norm_squared(b->velocity) > linear_tolerance * linear_tolerance || fabsf(b->omega) > angular_tolerance)
+            b->sleep_time = 0.0f;
+        else
+            b->sleep_time += delta_time;
+
+        if (b->sleep_time < is->sleep_time[is->island[i]])
+            is->sleep_time[is->island[i]] = b->sleep_time;
+    }
+
+    for (unsigned int i = 0; i < is->n_bodies; i++)
+    {
+        unsigned int island = is->island[i];
+        if (island != ISLAND_NONE && is->awake[island] && is->sleep_time[island] >= time_to_sleep)
+            body_set_awake(&bodies[i], false);
+    }
+
+    for (unsigned int k = 0; k < is->n_islands; k++)
+    {
+        if (is->sleep_time[k] >= time_to_sleep)
+            is->awake[k] = false;
+    }
+}
+
+unsigned int islands_n_constraints(Islands *is, unsigned int island)
+{
+    return is->joint_start[island + 1] - is->joint_start[island] + is->contact_start[island + 1] - is->contact_start[island];
+}
+
+int islands_order_compare(const void *p0, const void *p1)
+{
+    const IslandOrder *a = (const IslandOrder *)p0;
+    const IslandOrder *b = (const IslandOrder *)p1;
+    if (a->n_constraints != b->n_constraints)
+        return (a->n_constraints > b->n_constraints) ? -1 : 1;
+    return (a->island < b->island) ? -1 : (a->island > b->island);
+}
+
+// island of a constraint between a and b, static bodies take the island of the other body
+unsigned int islands_constraint_island(Islands *is, Body *a, Body *b)
+{
+    return is->island[(a->inv_mass != 0.0) ? a->world_index : b->world_index];
+}
+
+// Counting sort of the constraints of awake islands into their islands, keeping world order within an island
+void islands_sort_constraints(Islands *is, List *joints, PenetrationConstraint *contacts, unsigned int n_contacts)
+{
+    is->joint_start = (unsigned int *)mem_grow(is->joint_start, &is->joint_start_capacity, is->n_islands + 1, sizeof(unsigned int));
+    is->contact_start = (unsigned int *)mem_grow(is->contact_start, &is->contact_start_capacity, is->n_islands + 1, sizeof(unsigned int));
+    memset(is->joint_start, 0, (is->n_islands + 1) * sizeof(unsigned int));
+    memset(is->contact_start, 0, (is->n_islands + 1) * sizeof(unsigned int));
+
+    unsigned int n_joints = 0;
+    for (Node *n = joints->start; n; n = n->next)
+    {
+        JointConstraint *jc = (JointConstraint *)n->data;
+        unsigned int island = islands_constraint_island(is, jc->a, jc->b);
+        if (island != ISLAND_NONE && is->awake[island])
+        {
+            is->joint_start[island + 1]++;
+            n_joints++;
+        }
+    }
+
+    for (unsigned int i = 0; i < n_contacts; i++)
+    {
+        is->contact_start[islands_constraint_island(is, contacts[i].a, contacts[i].b) + 1]++;
+    }
+
+    for (unsigned int k = 0; k < is->n_islands; k++)
+    {
+        is->joint_start[k + 1] += is->joint_start[k];
+        is->contact_start[k + 1] += is->contact_start[k];
+    }
+
+    // joint_start[k] and contact_start[k] serve as insertion cursors, then get shifted back
+    is->joints = (JointConstraint **)mem_grow(is->joints, &is->joints_capacity, n_joints, sizeof(JointConstraint *));
+    for (Node *n = joints->start; n; n = n->next)
+    {
+        JointConstraint *jc = (JointConstraint *)n->data;
+        unsigned int island = islands_constraint_island(is, jc->a, jc->b);
+        if (island != ISLAND_NONE && is->awake[island])
+            is->joints[is->joint_start[island]++] = jc;
+    }
+
+    is->contacts = (PenetrationConstraint **)mem_grow(is->contacts, &is->contacts_capacity, n_contacts, sizeof(PenetrationConstraint *));
+    for (unsigned int i = 0; i < n_contacts; i++)
+    {
+        PenetrationConstraint *pc = &contacts[i];
+        is->contacts[is->contact_start[islands_constraint_island(is, pc->a, pc->b)]++] = pc;
+    }
+
+    for (unsigned int k = is->n_islands; k > 0; k--)
+    {
+        is->joint_start[k] = is->joint_start[k - 1];
+        is->contact_start[k] = is->contact_start[k - 1];
+    }
+    is->joint_start[0] = 0;
+    is->contact_start[0] = 0;
+
+    is->awake_islands = (IslandOrder *)mem_grow(is->awake_islands, &is->awake_islands_capacity, is->n_islands, sizeof(IslandOrder));
+    is->n_awake_islands = 0;
+    for (unsigned int k = 0; k < is->n_islands; k++)
+    {
+        if (is->awake[k])
+            is->awake_islands[is->n_awake_islands++] = (IslandOrder){k, islands_n_constraints(is, k)};
+    }
+
+    // big islands first, so the last island handed to a thread is a small one
+    qsort(is->awake_islands, is->n_awake_islands, sizeof(IslandOrder), islands_order_compare);
+}
+
+bool islands_body_awake(Islands *is, Body *b)
+{
+    return b->inv_mass != 0.0 && is->awake[is->island[b->world_index]];
+}
+
+#endif
@@ -0,0 +1,359 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+
+#include "mem.h"
+
+// called for every item of a job, thread is 0 for the thread that owns the job system and
+// 1..n_threads - 1 for the workers
+typedef void (*JobFunction)(void *data, unsigned int item, unsigned int thread);
+
+#define JOB_TASK_MAX_SUCCESSORS 8
+
+// Node of a task graph, runs function once after all the tasks it depends on are done
+typedef struct JobTask
+{
+    JobFunction function;
+    void *data;
+
+    struct JobTask *successors[JOB_TASK_MAX_SUCCESSORS];
+    unsigned int n_successors;
+    unsigned int n_dependencies;
+    unsigned int n_dependencies_left;
+} JobTask;
+
+typedef struct
+{
+    JobFunction function;
+    void *data;
+    unsigned int begin;
+    unsigned int end;
+    // decremented once the job ran
+    unsigned int *pending;
+    // graph task whose successors get released once the job ran, or NULL
+    JobTask *task;
+} Job;
+
+// Ring buffer of jobs, the owning thread pushes and pops at the bottom and other threads
+// steal from the top, so a thief takes the oldest and usually biggest piece of work
+typedef struct
+{
+    pthread_mutex_t mutex;
+    Job *jobs;
+    unsigned int capacity;
+    unsigned int top;
+    unsigned int bottom;
+} JobDeque;
+
+typedef struct JobSystem JobSystem;
+
+typedef struct
+{
+    JobSystem *system;
+    unsigned int thread;
+} JobWorker;
+
+// Work stealing scheduler with a deque per thread. The thread that creates it takes part
+// in the work while it waits for a parallel for or a task graph, with 0 workers
+// everything runs inline on that thread.
+struct JobSystem
+{
+    unsigned int n_threads;
+    pthread_t *threads;
+    JobWorker *workers;
+    JobDeque *deques;
+    struct ScratchPool *scratch_pools;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    unsigned int n_queued;
+    bool quit;
+};
+
+// index of the calling thread in the job system it works for
+__thread unsigned int job_thread = 0;
+
+void job_deque_create(JobDeque *d)
+{
+    pthread_mutex_init(&d->mutex, NULL);
+    d->jobs = NULL;
+    d->capacity = 0;
+    d->top = 0;
+    d->bottom = 0;
+}
+
+void job_deque_destroy(JobDeque *d)
+{
+    pthread_mutex_destroy(&d->mutex);
+    mem_free(d->jobs);
+}
+
+void job_deque_push(JobDeque *d, Job job)
+{
+    pthread_mutex_lock(&d->mutex);
+    if (d->bottom - d->top == d->capacity)
+    {
+        // unwrap the ring into a buffer twice the size
+        unsigned int capacity = (d->capacity > 0) ? 2 * d->capacity : 64;
+        Job *jobs = (Job *)mem_malloc(capacity * sizeof(Job));
+        for (unsigned int i = d->top; i != d->bottom; i++)
+        {
+            jobs[i - d->top] = d->jobs[i % d->capacity];
+        }
+        mem_free(d->jobs);
+        d->bottom -= d->top;
+        d->top = 0;
+        d->jobs = jobs;
+        d->capacity = capacity;
+    }
+    d->jobs[d->bottom % d->capacity] = job;
+    d->bottom++;
+    pthread_mutex_unlock(&d->mutex);
+}
+
+bool job_deque_pop(JobDeque *d, Job *job)
+{
+    bool found = false;
+    pthread_mutex_lock(&d->mutex);
+    if (d->bottom != d->top)
+    {
+        d->bottom--;
+        *job = d->jobs[d->bottom % d->capacity];
+        found = true;
+    }
+    pthread_mutex_unlock(&d->mutex);
+    return found;
+}
+
+bool job_deque_steal(JobDeque *d, Job *job)
+{
+    bool found = false;
+    pthread_mutex_lock(&d->mutex);
+    if (d->bottom != d->top)
+    {
+        *job = d->jobs[d->top % d->capacity];
+        d->top++;
+        found = true;
+    }
+    pthread_mutex_unlock(&d->mutex);
+    return found;
+}
+
+void job_push(JobSystem *js, Job job)
+{
+    job_deque_push(&js->deques[job_thread], job);
+    __atomic_add_fetch(&js->n_queued, 1, __ATOMIC_SEQ_CST);
+}
+
+void job_wake_workers(JobSystem *js)
+{
+    if (js->n_threads == 1)
+        return;
+
+    pthread_mutex_lock(&js->mutex);
+    pthread_cond_broadcast(&js->wake);
+    pthread_mutex_unlock(&js->mutex);
+}
+
+// own jobs newest first, then the oldest job of another thread
+bool job_find(JobSystem *js, unsigned int thread, Job *job)
+{
+    bool found = job_deque_pop(&js->deques[thread], job);
+    for (unsigned int i = 1; !found && i < js->n_threads; i++)
+    {
+        found = job_deque_steal(&js->deques[(thread + i) % js->n_threads], job);
+    }
+
+    if (found)
+        __atomic_sub_fetch(&js->n_queued, 1, __ATOMIC_SEQ_CST);
+    return found;
+}
+
+void job_execute(JobSystem *js, Job *job, unsigned int thread)
+{
+    for (unsigned int item = job->begin; item < job->end; item++)
+    {
+        job->function(job->data, item, thread);
+    }
+
+    if (job->task)
+    {
+        bool released = false;
+        for (unsigned int i = 0; i < job->task->n_successors; i++)
+        {
+            JobTask *next = job->task->successors[i];
+            if (__atomic_sub_fetch(&next->n_dependencies_left, 1, __ATOMIC_ACQ_REL) == 0)
+            {
+                job_push(js, (Job){next->function, next->data, 0, 1, job->pending, next});
+                released = true;
+            }
+        }
+        if (released)
+            job_wake_workers(js);
+    }
+
+    __atomic_sub_fetch(job->pending, 1, __ATOMIC_ACQ_REL);
+}
+
+// runs jobs until the counter drops to zero
+void job_wait(JobSystem *js, unsigned int *pending)
+{
+    while (__atomic_load_n(pending, __ATOMIC_ACQUIRE) > 0)
+    {
+        Job job;
+        if (job_find(js, job_thread, &job))
+            job_execute(js, &job, job_thread);
+        else
+            sched_yield();
+    }
+}
+
+void *job_worker_main(void *arg)
+{
+    JobWorker *worker = (JobWorker *)arg;
+    JobSystem *js = worker->system;
+    job_thread = worker->thread;
+    mem_scratch_pool = &js->scratch_pools[worker->thread];
+
+    while (true)
+    {
+        Job job;
+        if (job_find(js, worker->thread, &job))
+        {
+            job_execute(js, &job, worker->thread);
+            continue;
+        }
+
+        pthread_mutex_lock(&js->mutex);
+        while (!js->quit && __atomic_load_n(&js->n_queued, __ATOMIC_SEQ_CST) == 0)
+        {
+            pthread_cond_wait(&js->wake, &js->mutex);
+        }
+        bool quit = js->quit;
+        pthread_mutex_unlock(&js->mutex);
+        if (quit)
+            break;
+    }
+
+    return NULL;
+}
+
+void job_system_create(JobSystem *js, unsigned int n_workers)
+{
+    js->n_threads = n_workers + 1;
+    js->n_queued = 0;
+    js->quit = false;
+    job_thread = 0;
+
+    pthread_mutex_init(&js->mutex, NULL);
+    pthread_cond_init(&js->wake, NULL);
+
+    js->deques = (JobDeque *)mem_malloc(js->n_threads * sizeof(JobDeque));
+    for (unsigned int i = 0; i < js->n_threads; i++)
+    {
+        job_deque_create(&js->deques[i]);
+    }
+
+    js->threads = (pthread_t *)mem_malloc(js->n_threads * sizeof(pthread_t));
+    js->workers = (JobWorker *)mem_malloc(js->n_threads * sizeof(JobWorker));
+    js->scratch_pools = (struct ScratchPool *)mem_malloc(js->n_threads * sizeof(struct ScratchPool));
+    for (unsigned int i = 1; i < js->n_threads; i++)
+    {
+        js->workers[i] = (JobWorker){js, i};
+        js->scratch_pools[i] = (struct ScratchPool){NULL, NULL, 0, 0};
+        pthread_create(&js->threads[i], NULL, job_worker_main, &js->workers[i]);
+    }
+}
+
+void job_system_destroy(JobSystem *js)
+{
+    pthread_mutex_lock(&js->mutex);
+    js->quit = true;
+    pthread_cond_broadcast(&js->wake);
+    pthread_mutex_unlock(&js->mutex);
+
+    for (unsigned int i = 1; i < js->n_threads; i++)
+    {
+        pthread_join(js->threads[i], NULL);
+    }
+
+    for (unsigned int i = 0; i < js->n_threads; i++)
+    {
+        job_deque_destroy(&js->deques[i]);
+    }
+    pthread_mutex_destroy(&js->mutex);
+    pthread_cond_destroy(&js->wake);
+    mem_free(js->deques);
+    mem_free(js->threads);
+    mem_free(js->workers);
+    for (unsigned int i = 1; i < js->n_threads; i++)
+    {
+        mem_scratch_pool_destroy(&js->scratch_pools[i]);
+    }
+    mem_free(js->scratch_pools);
+}
+
+// Calls function for items 0..n_items - 1, split into jobs of grain items, and returns once
+// all are done. Can be called from inside a job, the caller works on the jobs while it waits.
+void job_parallel_for(JobSystem *js, JobFunction function, void *data, unsigned int n_items, unsigned int grain)
+{
+    if (js->n_threads == 1 || n_items <= grain)
+    {
+        for (unsigned int item = 0; item < n_items; item++)
+        {
+            function(data, item, job_thread);
+        }
+        return;
+    }
+
+    unsigned int pending = (n_items + grain - 1) / grain;
+    for (unsigned int begin = 0; begin < n_items; begin += grain)
+    {
+        unsigned int end = (begin + grain < n_items) ? begin + grain : n_items;
+        job_push(js, (Job){function, data, begin, end, &pending, NULL});
+    }
+    job_wake_workers(js);
+    job_wait(js, &pending);
+}
+
+void job_task_init(JobTask *task, JobFunction function, void *data)
+{
+    task->function = function;
+    task->data = data;
+    task->n_successors = 0;
+    task->n_dependencies = 0;
+}
+
+// task runs only after dependency is done
+void job_task_depends_on(JobTask *task, JobTask *dependency)
+{
+    assert(dependency->n_successors < JOB_TASK_MAX_SUCCESSORS);
+    dependency->successors[dependency->n_successors++] = task;
+    task->n_dependencies++;
+}
+
+// Runs a task graph and returns once every task is done. Tasks are called with item 0.
+void job_graph_run(JobSystem *js, JobTask *tasks, unsigned int n_tasks)
+{
+    unsigned int pending = n_tasks;
+    for (unsigned int i = 0; i < n_tasks; i++)
+    {
+        tasks[i].n_dependencies_left = tasks[i].n_dependencies;
+    }
+
+    // pushed in reverse so the owner pops the first root first
+    for (unsigned int i = n_tasks; i > 0; i--)
+    {
+        JobTask *task = &tasks[i - 1];
+        if (task->n_dependencies == 0)
+            job_push(js, (Job){task->function, task->data, 0, 1, &pending, task});
+    }
+    job_wake_workers(js);
+    job_wait(js, &pending);
+}
+
+#endif
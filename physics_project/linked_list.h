@@ -66,4 +66,26 @@ void List_push(List *list, void *data)
     }
 }
 
+// unlinks the node holding data and frees both
+void List_remove(List *list, void *data)
+{
+    Node *prev = NULL;
+    for (Node *n = list->start; n; prev = n, n = n->next)
+    {
+        if (n->data != data)
+            continue;
+
+        if (prev)
+            prev->next = n->next;
+        else
+            list->start = n->next;
+        if (list->end == n)
+            list->end = prev;
+
+        free(n->data);
+        free(n);
+        return;
+    }
+}
+
 #endif
\ No newline at end of file
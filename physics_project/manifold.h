@@ -0,0 +1,201 @@
+#ifndef MANIFOLD_H
+#define MANIFOLD_H
+
+#include <stdint.h>
+
+#include "body.h"
+#include "collision.h"
+#include "mem.h"
+#include "pair_map.h"
+
+#define MANIFOLD_MAX_POINTS 2
+
+typedef struct
+{
+    Collision_Info info;
+
+    // accumulated impulses, carried into the next step to warm start the solver
+    float normal_impulse;
+    float tangent_impulse;
+} ManifoldPoint;
+
+typedef struct
+{
+    Body *a;
+    Body *b;
+    ManifoldPoint points[MANIFOLD_MAX_POINTS];
+    unsigned int n_points;
+    unsigned long last_frame;
+} Manifold;
+
+// Contact manifolds of the touching body pairs, kept from one step to the next so the
+// accumulated impulses of a contact survive while the same features stay in contact
+typedef struct
+{
+    PairMap map;
+    Manifold *manifolds;
+    unsigned int manifolds_capacity;
+
+    // manifolds updated this step, in narrowphase order
+    unsigned int *touched;
+    unsigned int touched_capacity;
+    unsigned int n_touched;
+
+    unsigned long frame;
+    unsigned long n_matched_points;
+} ManifoldCache;
+
+void manifold_cache_create(ManifoldCache *cache)
+{
+    pair_map_create(&cache->map);
+    cache->manifolds = NULL;
+    cache->manifolds_capacity = 0;
+    cache->touched = NULL;
+    cache->touched_capacity = 0;
+    cache->n_touched = 0;
+    cache->frame = 0;
+    cache->n_matched_points = 0;
+}
+
+void manifold_cache_destroy(ManifoldCache *cache)
+{
+    pair_map_destroy(&cache->map);
+    mem_free(cache->manifolds);
+    mem_free(cache->touched);
+    manifold_cache_create(cache);
+}
+
+unsigned int manifold_cache_size(ManifoldCache *cache)
+{
+    return cache->map.n_keys;
+}
+
+uint64_t manifold_body_key(Body *b)
+{
+    return ((uint64_t)b->handle.generation << 32) | b->handle.slot;
+}
+
+// Manifolds are keyed by body handles, which survive the bodies moving in the world's array.
+// The body with the smaller key comes first, so a pair keeps its manifold if its order in the
+// broadphase flips.
+PairKey manifold_pair_key(Body **a, Body **b)
+{
+    if (manifold_body_key(*a) > manifold_body_key(*b))
+    {
+        Body *t = *a;
+        *a = *b;
+        *b = t;
+    }
+    return (PairKey){manifold_body_key(*a), manifold_body_key(*b)};
+}
+
+void manifold_cache_begin_frame(ManifoldCache *cache)
+{
+    cache->frame++;
+    cache->n_touched = 0;
+    cache->n_matched_points = 0;
+}
+
+// Replaces the points of the manifold of a and b with this step's contacts. A contact with
+// the same feature as one from the last step inherits its accumulated impulses.
+Manifold *manifold_cache_update(ManifoldCache *cache, Body *a, Body *b, Collision_Info info[], unsigned int n_collisions)
+{
+    unsigned int n_manifolds = cache->map.n_keys;
+    unsigned int index = pair_map_insert(&cache->map, manifold_pair_key(&a, &b));
+    cache->manifolds = (Manifold *)mem_grow(cache->manifolds, &cache->manifolds_capacity, cache->map.n_keys, sizeof(Manifold));
+
+    Manifold *m = &cache->manifolds[index];
+    if (cache->map.n_keys > n_manifolds)
+        m->n_points = 0;
+    m->a = a;
+    m->b = b;
+
+    ManifoldPoint points[MANIFOLD_MAX_POINTS];
+    if (n_collisions > MANIFOLD_MAX_POINTS)
+        n_collisions = MANIFOLD_MAX_POINTS;
+
+    for (unsigned int i = 0; i < n_collisions; i++)
+    {
+        points[i].info = info[i];
+        points[i].normal_impulse = 0.0f;
+        points[i].tangent_impulse = 0.0f;
+
+        for (unsigned int k = 0; k < m->n_points; k++)
+        {
+            if (m->points[k].info.feature == info[i].feature)
+            {
+                points[i].normal_impulse = m->points[k].normal_impulse;
+                points[i].tangent_impulse = m->points[k].tangent_impulse;
+                cache->n_matched_points++;
+                break;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < n_collisions; i++)
+    {
+        m->points[i] = points[i];
+    }
+    m->n_points = n_collisions;
+    m->last_frame = cache->frame;
+
+    cache->touched = (unsigned int *)mem_grow(cache->touched, &cache->touched_capacity, cache->n_touched + 1, sizeof(unsigned int));
+    cache->touched[cache->n_touched++] = index;
+
+    return m;
+}
+
+// Keeps the manifold of a and b from the last step as this step's, for pairs of bodies
+// that did not move. Returns NULL if they had none.
+Manifold *manifold_cache_keep(ManifoldCache *cache, Body *a, Body *b)
+{
+    int index = pair_map_find(&cache->map, manifold_pair_key(&a, &b));
+    if (index == PAIR_MAP_NULL)
+        return NULL;
+
+    // the bodies may have moved in the world's array since the points were found, the
+    // pointers they hold are only compared here, never followed
+    Manifold *m = &cache->manifolds[index];
+    for (unsigned int k = 0; k < m->n_points; k++)
+    {
+        Collision_Info *info = &m->points[k].info;
+        info->a = (info->a == m->a) ? a : b;
+        info->b = (info->b == m->a) ? a : b;
+    }
+    m->a = a;
+    m->b = b;
+    m->last_frame = cache->frame;
+
+    cache->touched = (unsigned int *)mem_grow(cache->touched, &cache->touched_capacity, cache->n_touched + 1, sizeof(unsigned int));
+    cache->touched[cache->n_touched++] = index;
+
+    return m;
+}
+
+Manifold *manifold_cache_touched(ManifoldCache *cache, unsigned int i)
+{
+    return &cache->manifolds[cache->touched[i]];
+}
+
+// Drops the manifolds of pairs that stopped touching this step. Invalidates the touched list.
+void manifold_cache_evict(ManifoldCache *cache)
+{
+    unsigned int i = 0;
+    while (i < cache->map.n_keys)
+    {
+        Manifold *m = &cache->manifolds[i];
+        if (m->last_frame == cache->frame)
+        {
+            i++;
+            continue;
+        }
+
+        // the last manifold moves into this index, so look at i again
+        unsigned int last = cache->map.n_keys - 1;
+        pair_map_remove(&cache->map, cache->map.keys[i]);
+        cache->manifolds[i] = cache->manifolds[last];
+    }
+    cache->n_touched = 0;
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef MATFIX_H
+#define MATFIX_H
+
+// Fixed-size matrices for the constraint solver. Unlike MatMN the sizes are compile time
+// constants, so they live inline in the constraints, need no allocator or size asserts,
+// and every loop below unrolls completely.
+
+// typedef struct { float data[M][N]; } TYPE; with TYPE_zero, TYPE_add, TYPE_sub, TYPE_scale
+#define MATFIX_DEFINE(TYPE, PREFIX, M, N)                 \
+    typedef struct                                        \
+    {                                                     \
+        float data[M][N];                                 \
+    } TYPE;                                               \
+                                                          \
+    TYPE PREFIX##_zero(void)                              \
+    {                                                     \
+        TYPE z = {{{0}}};                                 \
+        return z;                                         \
+    }                                                     \
+                                                          \
+    TYPE PREFIX##_add(TYPE a, TYPE b)                     \
+    {                                                     \
+        TYPE z;                                           \
+        for (int i = 0; i < (M); i++)                     \
+            for (int j = 0; j < (N); j++)                 \
+                z.data[i][j] = a.data[i][j] + b.data[i][j]; \
+        return z;                                         \
+    }                                                     \
+                                                          \
+    TYPE PREFIX##_sub(TYPE a, TYPE b)                     \
+    {                                                     \
+        TYPE z;                                           \
+        for (int i = 0; i < (M); i++)                     \
+            for (int j = 0; j < (N); j++)                 \
+                z.data[i][j] = a.data[i][j] - b.data[i][j]; \
+        return z;                                         \
+    }                                                     \
+                                                          \
+    TYPE PREFIX##_scale(TYPE a, float s)                  \
+    {                                                     \
+        TYPE z;                                           \
+        for (int i = 0; i < (M); i++)                     \
+            for (int j = 0; j < (N); j++)                 \
+                z.data[i][j] = a.data[i][j] * s;          \
+        return z;                                         \
+    }
+
+// Z NAME(A *a, B *b) = a @ b, for a M x K and b K x N
+#define MATFIX_DEFINE_MUL(NAME, Z, A, B, M, K, N)         \
+    Z NAME(const A *a, const B *b)                        \
+    {                                                     \
+        Z z;                                              \
+        for (int i = 0; i < (M); i++)                     \
+            for (int j = 0; j < (N); j++)                 \
+            {                                             \
+                float sum = a->data[i][0] * b->data[0][j]; \
+                for (int k = 1; k < (K); k++)             \
+                    sum += a->data[i][k] * b->data[k][j]; \
+                z.data[i][j] = sum;                       \
+            }                                             \
+        return z;                                         \
+    }
+
+// Z NAME(A *a, B *b) = a.T @ b, for a K x M and b K x N
+#define MATFIX_DEFINE_MUL_TRANSPOSED(NAME, Z, A, B, M, K, N) \
+    Z NAME(const A *a, const B *b)                        \
+    {                                                     \
+        Z z;                                              \
+        for (int i = 0; i < (M); i++)                     \
+            for (int j = 0; j < (N); j++)                 \
+            {                                             \
+                float sum = a->data[0][i] * b->data[0][j]; \
+                for (int k = 1; k < (K); k++)             \
+                    sum += a->data[k][i] * b->data[k][j]; \
+                z.data[i][j] = sum;                       \
+            }                                             \
+        return z;                                         \
+    }
+
+// Z NAME(A *a, D *d) = a @ diag(d) @ a.T, for a M x K and d a K long diagonal. The upper
+// triangle is mirrored so the result is exactly symmetric
+#define MATFIX_DEFINE_DIAG_CONGRUENCE(NAME, Z, A, D, M, K) \
+    Z NAME(const A *a, const D *d)                        \
+    {                                                     \
+        Z z;                                              \
+        for (int i = 0; i < (M); i++)                     \
+            for (int j = i; j < (M); j++)                 \
+            {                                             \
+                float sum = a->data[i][0] * d->data[0] * a->data[j][0]; \
+                for (int k = 1; k < (K); k++)             \
+                    sum += a->data[i][k] * d->data[k] * a->data[j][k]; \
+                z.data[i][j] = sum;                       \
+                z.data[j][i] = sum;                       \
+            }                                             \
+        return z;                                         \
+    }
+
+// velocities (va.x, va.y, omega_a, vb.x, vb.y, omega_b) of a constraint's two bodies
+MATFIX_DEFINE(Vec6, vec6, 6, 1)
+// one jacobian row, as for a joint
+MATFIX_DEFINE(Mat16, mat16, 1, 6)
+// two jacobian rows, normal and tangent of a contact
+MATFIX_DEFINE(Mat26, mat26, 2, 6)
+MATFIX_DEFINE(Mat11, mat11, 1, 1)
+MATFIX_DEFINE(Mat21, mat21, 2, 1)
+MATFIX_DEFINE(Mat22, mat22, 2, 2)
+
+// the block diagonal inverse mass of two bodies, only its diagonal is stored
+typedef struct
+{
+    float data[6];
+} InvMass6;
+
+MATFIX_DEFINE_MUL(mat16_mul_vec6, Mat11, Mat16, Vec6, 1, 6, 1)
+MATFIX_DEFINE_MUL(mat26_mul_vec6, Mat21, Mat26, Vec6, 2, 6, 1)
+MATFIX_DEFINE_MUL(mat22_mul_mat21, Mat21, Mat22, Mat21, 2, 2, 1)
+MATFIX_DEFINE_MUL_TRANSPOSED(mat16_transpose_mul_mat11, Vec6, Mat16, Mat11, 6, 1, 1)
+MATFIX_DEFINE_MUL_TRANSPOSED(mat26_transpose_mul_mat21, Vec6, Mat26, Mat21, 6, 2, 1)
+MATFIX_DEFINE_DIAG_CONGRUENCE(mat16_effective_mass, Mat11, Mat16, InvMass6, 1, 6)
+MATFIX_DEFINE_DIAG_CONGRUENCE(mat26_effective_mass, Mat22, Mat26, InvMass6, 2, 6)
+
+// inverse of a, zero when a is singular
+Mat22 mat22_inverse(const Mat22 *a)
+{
+    float det = a->data[0][0] * a->data[1][1] - a->data[0][1] * a->data[1][0];
+    if (det == 0)
+        return mat22_zero();
+
+    float inv_det = 1.0f / det;
+    Mat22 z;
+    z.data[0][0] = a->data[1][1] * inv_det;
+    z.data[0][1] = -a->data[0][1] * inv_det;
+    z.data[1][0] = -a->data[1][0] * inv_det;
+    z.data[1][1] = a->data[0][0] * inv_det;
+    return z;
+}
+
+#endif
@@ -2,10 +2,27 @@
 #define MATMN_H
 
 #include <assert.h>
+#include <math.h>
+#include <string.h>
 #include "mem.h"
 
+#if defined(__SSE2__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
 #define MATMN_AT(MAT, I, J) ((MAT).data[(((MAT).n) * (I)) + (J)])
 
+// data starts on a whole AVX register, rows are packed so only row 0 is sure to be aligned
+#define MATMN_ALIGN 32
+
+// matmn_mul works on blocks of MATMN_BLOCK_K rows of b by MATMN_BLOCK_J columns, 32 KB that
+// stay in L1 while every row of a goes past them
+#define MATMN_BLOCK_K 64
+#define MATMN_BLOCK_J 128
+
+// matmn_transpose copies tiles of MATMN_BLOCK_T x MATMN_BLOCK_T
+#define MATMN_BLOCK_T 32
+
 typedef struct
 {
     unsigned int m; // rows
@@ -18,14 +35,15 @@ MatMN matmn_create(unsigned int m, unsigned int n, MEMORY_TAG tag)
     MatMN a;
     a.m = m;
     a.n = n;
-    a.data = (float *)mem_calloc(m * n, sizeof(float), tag);
+    a.data = (float *)mem_calloc_aligned(m * n, sizeof(float), MATMN_ALIGN, tag);
 
     return a;
 }
 
+// only for MEM_HEAP matrices from matmn_create
 void matmn_destroy(MatMN *a)
 {
-    mem_free(a->data);
+    mem_free_aligned(a->data);
 }
 
 void matmn_copy(MatMN *a, MatMN *z)
@@ -33,10 +51,7 @@ void matmn_copy(MatMN *a, MatMN *z)
     assert(a->m == z->m);
     assert(a->n == z->n);
 
-    for (unsigned int i = 0; i < (a->m * a->n); i++)
-    {
-        z->data[i] = a->data[i];
-    }
+    memcpy(z->data, a->data, a->m * a->n * sizeof(float));
 }
 
 MatMN matmn_create_zero_like(MatMN *a, MEMORY_TAG tag)
@@ -62,17 +77,110 @@ MatMN matmn_create_zero_like(MatMN *a, MEMORY_TAG tag)
 //     return z;
 // }
 
+// z[i] = a[i] + s * b[i] for n floats
+void matmn_axpy(const float *a, float s, const float *b, float *z, unsigned int n)
+{
+    unsigned int i = 0;
+#if defined(__AVX__)
+    __m256 s8 = _mm256_set1_ps(s);
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(&z[i], _mm256_add_ps(_mm256_loadu_ps(&a[i]), _mm256_mul_ps(s8, _mm256_loadu_ps(&b[i]))));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128 s4 = _mm_set1_ps(s);
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(&z[i], _mm_add_ps(_mm_loadu_ps(&a[i]), _mm_mul_ps(s4, _mm_loadu_ps(&b[i]))));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        z[i] = a[i] + s * b[i];
+    }
+}
+
+// sum of a[i] * b[i] for n floats, in several partial sums
+float matmn_dot(const float *a, const float *b, unsigned int n)
+{
+    unsigned int i = 0;
+    float sum = 0;
+#if defined(__AVX__)
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16)
+    {
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i])));
+        sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(&a[i + 8]), _mm256_loadu_ps(&b[i + 8])));
+    }
+    sum0 = _mm256_add_ps(sum0, sum1);
+    __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum0), _mm256_extractf128_ps(sum0, 1));
+#elif defined(__SSE2__)
+    __m128 sum4 = _mm_setzero_ps();
+#endif
+#if defined(__SSE2__)
+    for (; i + 4 <= n; i += 4)
+    {
+        sum4 = _mm_add_ps(sum4, _mm_mul_ps(_mm_loadu_ps(&a[i]), _mm_loadu_ps(&b[i])));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, sum4);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < n; i++)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
 void matmn_transpose(MatMN *a, MatMN *z)
 {
     assert(a->m == z->n);
     assert(a->n == z->m);
     assert(a != z);
 
-    for (unsigned int i = 0; i < a->m; i++)
+    for (unsigned int ii = 0; ii < a->m; ii += MATMN_BLOCK_T)
     {
-        for (unsigned int j = 0; j < a->n; j++)
+        unsigned int i_end = (ii + MATMN_BLOCK_T < a->m) ? ii + MATMN_BLOCK_T : a->m;
+        for (unsigned int jj = 0; jj < a->n; jj += MATMN_BLOCK_T)
         {
-            MATMN_AT(*z, j, i) = MATMN_AT(*a, i, j);
+            unsigned int j_end = (jj + MATMN_BLOCK_T < a->n) ? jj + MATMN_BLOCK_T : a->n;
+            unsigned int i = ii;
+#if defined(__SSE2__)
+            // 4 x 4 at a time in registers, what is left of the tile after that one by one
+            for (; i + 4 <= i_end; i += 4)
+            {
+                unsigned int j = jj;
+                for (; j + 4 <= j_end; j += 4)
+                {
+                    __m128 r0 = _mm_loadu_ps(&MATMN_AT(*a, i, j));
+                    __m128 r1 = _mm_loadu_ps(&MATMN_AT(*a, i + 1, j));
+                    __m128 r2 = _mm_loadu_ps(&MATMN_AT(*a, i + 2, j));
+                    __m128 r3 = _mm_loadu_ps(&MATMN_AT(*a, i + 3, j));
+                    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                    _mm_storeu_ps(&MATMN_AT(*z, j, i), r0);
+                    _mm_storeu_ps(&MATMN_AT(*z, j + 1, i), r1);
+                    _mm_storeu_ps(&MATMN_AT(*z, j + 2, i), r2);
+                    _mm_storeu_ps(&MATMN_AT(*z, j + 3, i), r3);
+                }
+                for (; j < j_end; j++)
+                {
+                    for (unsigned int k = i; k < i + 4; k++)
+                    {
+                        MATMN_AT(*z, j, k) = MATMN_AT(*a, k, j);
+                    }
+                }
+            }
+#endif
+            for (; i < i_end; i++)
+            {
+                for (unsigned int j = jj; j < j_end; j++)
+                {
+                    MATMN_AT(*z, j, i) = MATMN_AT(*a, i, j);
+                }
+            }
         }
     }
 }
@@ -82,7 +190,23 @@ void matmn_scale(MatMN *a, float b, MatMN *z)
     assert(a->m == z->m);
     assert(a->n == z->n);
 
-    for (unsigned int i = 0; i < (a->m * a->n); i++)
+    unsigned int n = a->m * a->n;
+    unsigned int i = 0;
+#if defined(__AVX__)
+    __m256 b8 = _mm256_set1_ps(b);
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(&z->data[i], _mm256_mul_ps(_mm256_loadu_ps(&a->data[i]), b8));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128 b4 = _mm_set1_ps(b);
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(&z->data[i], _mm_mul_ps(_mm_loadu_ps(&a->data[i]), b4));
+    }
+#endif
+    for (; i < n; i++)
     {
         z->data[i] = a->data[i] * b;
     }
@@ -96,6 +220,7 @@ void matmn_set(float a, MatMN *z)
     }
 }
 
+// a + 1 * b and a + -1 * b round like a + b and a - b, so both go through matmn_axpy
 void matmn_add(MatMN *a, MatMN *b, MatMN *z)
 {
     assert(a->m == b->m);
@@ -104,10 +229,7 @@ void matmn_add(MatMN *a, MatMN *b, MatMN *z)
     assert(a->m == z->m);
     assert(a->n == z->n);
 
-    for (unsigned int i = 0; i < (a->m * a->n); i++)
-    {
-        z->data[i] = a->data[i] + b->data[i];
-    }
+    matmn_axpy(a->data, 1.0f, b->data, z->data, a->m * a->n);
 }
 
 void matmn_sub(MatMN *a, MatMN *b, MatMN *z)
@@ -118,25 +240,100 @@ void matmn_sub(MatMN *a, MatMN *b, MatMN *z)
     assert(a->m == z->m);
     assert(a->n == z->n);
 
-    for (unsigned int i = 0; i < (a->m * a->n); i++)
+    matmn_axpy(a->data, -1.0f, b->data, z->data, a->m * a->n);
+}
+
+// z[i0, i1) x [j0, j1) += a[i0, i1) x [k0, k1) @ b[k0, k1) x [j0, j1). Four rows by one
+// register of columns of z stay in registers over all of k, rows and columns left over go
+// through matmn_axpy. Each entry of z adds up its products in the order of k either way.
+void matmn_mul_block(MatMN *a, MatMN *b, MatMN *z, unsigned int i0, unsigned int i1, unsigned int k0, unsigned int k1, unsigned int j0, unsigned int j1)
+{
+    unsigned int i = i0;
+#if defined(__AVX__) || defined(__SSE2__)
+    for (; i + 4 <= i1; i += 4)
     {
-        z->data[i] = a->data[i] - b->data[i];
+        const float *a0 = &MATMN_AT(*a, i, 0);
+        const float *a1 = &MATMN_AT(*a, i + 1, 0);
+        const float *a2 = &MATMN_AT(*a, i + 2, 0);
+        const float *a3 = &MATMN_AT(*a, i + 3, 0);
+        unsigned int j = j0;
+#if defined(__AVX__)
+        for (; j + 8 <= j1; j += 8)
+        {
+            __m256 z0 = _mm256_loadu_ps(&MATMN_AT(*z, i, j));
+            __m256 z1 = _mm256_loadu_ps(&MATMN_AT(*z, i + 1, j));
+            __m256 z2 = _mm256_loadu_ps(&MATMN_AT(*z, i + 2, j));
+            __m256 z3 = _mm256_loadu_ps(&MATMN_AT(*z, i + 3, j));
+            for (unsigned int k = k0; k < k1; k++)
+            {
+                __m256 bk = _mm256_loadu_ps(&MATMN_AT(*b, k, j));
+                z0 = _mm256_add_ps(z0, _mm256_mul_ps(_mm256_set1_ps(a0[k]), bk));
+                z1 = _mm256_add_ps(z1, _mm256_mul_ps(_mm256_set1_ps(a1[k]), bk));
+                z2 = _mm256_add_ps(z2, _mm256_mul_ps(_mm256_set1_ps(a2[k]), bk));
+                z3 = _mm256_add_ps(z3, _mm256_mul_ps(_mm256_set1_ps(a3[k]), bk));
+            }
+            _mm256_storeu_ps(&MATMN_AT(*z, i, j), z0);
+            _mm256_storeu_ps(&MATMN_AT(*z, i + 1, j), z1);
+            _mm256_storeu_ps(&MATMN_AT(*z, i + 2, j), z2);
+            _mm256_storeu_ps(&MATMN_AT(*z, i + 3, j), z3);
+        }
+#endif
+        for (; j + 4 <= j1; j += 4)
+        {
+            __m128 z0 = _mm_loadu_ps(&MATMN_AT(*z, i, j));
+            __m128 z1 = _mm_loadu_ps(&MATMN_AT(*z, i + 1, j));
+            __m128 z2 = _mm_loadu_ps(&MATMN_AT(*z, i + 2, j));
+            __m128 z3 = _mm_loadu_ps(&MATMN_AT(*z, i + 3, j));
+            for (unsigned int k = k0; k < k1; k++)
+            {
+                __m128 bk = _mm_loadu_ps(&MATMN_AT(*b, k, j));
+                z0 = _mm_add_ps(z0, _mm_mul_ps(_mm_set1_ps(a0[k]), bk));
+                z1 = _mm_add_ps(z1, _mm_mul_ps(_mm_set1_ps(a1[k]), bk));
+                z2 = _mm_add_ps(z2, _mm_mul_ps(_mm_set1_ps(a2[k]), bk));
+                z3 = _mm_add_ps(z3, _mm_mul_ps(_mm_set1_ps(a3[k]), bk));
+            }
+            _mm_storeu_ps(&MATMN_AT(*z, i, j), z0);
+            _mm_storeu_ps(&MATMN_AT(*z, i + 1, j), z1);
+            _mm_storeu_ps(&MATMN_AT(*z, i + 2, j), z2);
+            _mm_storeu_ps(&MATMN_AT(*z, i + 3, j), z3);
+        }
+        for (unsigned int r = i; r < i + 4 && j < j1; r++)
+        {
+            for (unsigned int k = k0; k < k1; k++)
+            {
+                float *zr = &MATMN_AT(*z, r, j);
+                matmn_axpy(zr, MATMN_AT(*a, r, k), &MATMN_AT(*b, k, j), zr, j1 - j);
+            }
+        }
+    }
+#endif
+    for (; i < i1; i++)
+    {
+        for (unsigned int k = k0; k < k1; k++)
+        {
+            float *zi = &MATMN_AT(*z, i, j0);
+            matmn_axpy(zi, MATMN_AT(*a, i, k), &MATMN_AT(*b, k, j0), zi, j1 - j0);
+        }
     }
 }
 
+// Cache blocked, z may not be a or b. The products of each entry are added up in the order
+// of k like the plain triple loop does, so the result is the same.
 void matmn_mul(MatMN *a, MatMN *b, MatMN *z)
 {
     assert(a->n == b->m);
     assert(z->m == a->m);
     assert(z->n == b->n);
+    assert(z != a && z != b);
 
-    for (unsigned int i = 0; i < a->m; i++)
+    matmn_set(0.0f, z);
+    for (unsigned int kk = 0; kk < a->n; kk += MATMN_BLOCK_K)
     {
-        for (unsigned int j = 0; j < b->n; j++)
+        unsigned int k_end = (kk + MATMN_BLOCK_K < a->n) ? kk + MATMN_BLOCK_K : a->n;
+        for (unsigned int jj = 0; jj < b->n; jj += MATMN_BLOCK_J)
         {
-            MATMN_AT(*z, i, j) = 0;
-            for (unsigned int k = 0; k < a->n; k++)
-                MATMN_AT(*z, i, j) += MATMN_AT(*a, i, k) * MATMN_AT(*b, k, j);
+            unsigned int j_end = (jj + MATMN_BLOCK_J < b->n) ? jj + MATMN_BLOCK_J : b->n;
+            matmn_mul_block(a, b, z, 0, a->m, kk, k_end, jj, j_end);
         }
     }
 }
@@ -147,36 +344,276 @@ float matmn_dot_prod(MatMN *a, MatMN *b)
     assert(b->n == 1);
     assert(a->n == b->m);
 
-    float dot_prod = 0;
-    for (unsigned int i = 0; i < a->n; i++)
-    {
-        dot_prod += MATMN_AT(*a, 0, i) * MATMN_AT(*b, i, 0);
-    }
-    return dot_prod;
+    return matmn_dot(a->data, b->data, a->n);
 }
 
+// Gauss-Seidel from x = 0, rows with a zero diagonal are left at 0. The diagonal is inverted
+// once up front, each row then costs one dot product with x.
 void matmn_solve_gauss_seidel(MatMN *a, MatMN *b, MatMN *x, unsigned int iterations)
 {
     assert(b->n == 1);
     assert(x->n == 1);
     assert(x->m == b->m);
+    assert(a->m == b->m && a->n == x->m);
 
     matmn_set(0.0, x);
 
+    ScratchMark mark = mem_scratch_push();
+    float *inv_diagonal = (float *)mem_calloc(b->m, sizeof(float), MEM_SCRATCH_POOL);
+    for (unsigned int i = 0; i < b->m; i++)
+    {
+        inv_diagonal[i] = (MATMN_AT(*a, i, i) != 0.0f) ? 1.0f / MATMN_AT(*a, i, i) : 0.0f;
+    }
+
     for (unsigned int iter = 0; iter < iterations; iter++)
     {
         for (unsigned int i = 0; i < b->m; i++)
         {
-            float dot_prod = 0;
-            for(unsigned int j = 0; j < x->m; j++)
+            if (inv_diagonal[i] != 0.0f)
+                x->data[i] += (b->data[i] - matmn_dot(&MATMN_AT(*a, i, 0), x->data, x->m)) * inv_diagonal[i];
+        }
+    }
+
+    mem_scratch_pop(mark);
+}
+
+// Sparse matrix in compressed sparse row form, row i holds the values data[k] at columns
+// col[k] for k in [row_start[i], row_start[i + 1]). Columns within a row are in no particular
+// order. A matrix is filled a row at a time with matcsr_push and matcsr_end_row, and keeps
+// its buffers when cleared.
+typedef struct
+{
+    unsigned int m; // rows
+    unsigned int n; // cols
+    unsigned int *row_start;
+    unsigned int row_start_capacity;
+    unsigned int *col;
+    float *data;
+    unsigned int nnz;
+    unsigned int capacity;
+} MatCSR;
+
+// row i of a bounded solve has its bounds from row findex[i], or MATCSR_NO_FINDEX
+#define MATCSR_NO_FINDEX -1
+
+void matcsr_create(MatCSR *a)
+{
+    memset(a, 0, sizeof(MatCSR));
+}
+
+void matcsr_destroy(MatCSR *a)
+{
+    mem_free(a->row_start);
+    mem_free(a->col);
+    mem_free(a->data);
+    matcsr_create(a);
+}
+
+// empties a, leaving n columns and no rows
+void matcsr_clear(MatCSR *a, unsigned int n)
+{
+    a->row_start = (unsigned int *)mem_grow(a->row_start, &a->row_start_capacity, 1, sizeof(unsigned int));
+    a->row_start[0] = 0;
+    a->m = 0;
+    a->n = n;
+    a->nnz = 0;
+}
+
+// appends an entry to the row being filled
+void matcsr_push(MatCSR *a, unsigned int col, float value)
+{
+    assert(col < a->n);
+
+    if (a->nnz == a->capacity)
+    {
+        unsigned int capacity = a->capacity;
+        a->col = (unsigned int *)mem_grow(a->col, &capacity, a->nnz + 1, sizeof(unsigned int));
+        a->data = (float *)mem_grow(a->data, &a->capacity, a->nnz + 1, sizeof(float));
+    }
+    a->col[a->nnz] = col;
+    a->data[a->nnz] = value;
+    a->nnz++;
+}
+
+void matcsr_end_row(MatCSR *a)
+{
+    a->row_start = (unsigned int *)mem_grow(a->row_start, &a->row_start_capacity, a->m + 2, sizeof(unsigned int));
+    a->m++;
+    a->row_start[a->m] = a->nnz;
+}
+
+float matcsr_row_dot(MatCSR *a, unsigned int row, MatMN *x)
+{
+    float dot_prod = 0;
+    for (unsigned int k = a->row_start[row]; k < a->row_start[row + 1]; k++)
+    {
+        dot_prod += a->data[k] * x->data[a->col[k]];
+    }
+    return dot_prod;
+}
+
+// z = a @ x, for column vectors x and z
+void matcsr_mul(MatCSR *a, MatMN *x, MatMN *z)
+{
+    assert(x->m == a->n && x->n == 1);
+    assert(z->m == a->m && z->n == 1);
+    assert(x != z);
+
+    for (unsigned int i = 0; i < a->m; i++)
+    {
+        z->data[i] = matcsr_row_dot(a, i, x);
+    }
+}
+
+void matcsr_transpose(MatCSR *a, MatCSR *z)
+{
+    assert(a != z);
+
+    matcsr_clear(z, a->m);
+    z->row_start = (unsigned int *)mem_grow(z->row_start, &z->row_start_capacity, a->n + 1, sizeof(unsigned int));
+    unsigned int capacity = z->capacity;
+    z->col = (unsigned int *)mem_grow(z->col, &capacity, a->nnz, sizeof(unsigned int));
+    z->data = (float *)mem_grow(z->data, &z->capacity, a->nnz, sizeof(float));
+
+    // count the entries of each column, then place them, rows in increasing order
+    memset(z->row_start, 0, (a->n + 1) * sizeof(unsigned int));
+    for (unsigned int k = 0; k < a->nnz; k++)
+    {
+        z->row_start[a->col[k] + 1]++;
+    }
+    for (unsigned int j = 0; j < a->n; j++)
+    {
+        z->row_start[j + 1] += z->row_start[j];
+    }
+    for (unsigned int i = 0; i < a->m; i++)
+    {
+        for (unsigned int k = a->row_start[i]; k < a->row_start[i + 1]; k++)
+        {
+            unsigned int p = z->row_start[a->col[k]]++;
+            z->col[p] = i;
+            z->data[p] = a->data[k];
+        }
+    }
+    for (unsigned int j = a->n; j > 0; j--)
+    {
+        z->row_start[j] = z->row_start[j - 1];
+    }
+    z->row_start[0] = 0;
+    z->m = a->n;
+    z->nnz = a->nnz;
+}
+
+// z = a @ diag(d) @ a.T, at is a.T. Row i of z has an entry for every row of a that shares a
+// column with row i.
+void matcsr_mul_diag_transpose(MatCSR *a, MatMN *d, MatCSR *at, MatCSR *z)
+{
+    assert(d->m == a->n && d->n == 1);
+    assert(at->m == a->n && at->n == a->m);
+
+    ScratchMark mark = mem_scratch_push();
+    // position in z of the entry of the current row at each column, or UINT_MAX
+    unsigned int *position = (unsigned int *)mem_calloc(a->m, sizeof(unsigned int), MEM_SCRATCH_POOL);
+    memset(position, 0xff, a->m * sizeof(unsigned int));
+
+    matcsr_clear(z, a->m);
+    for (unsigned int i = 0; i < a->m; i++)
+    {
+        unsigned int row_begin = z->nnz;
+        for (unsigned int k = a->row_start[i]; k < a->row_start[i + 1]; k++)
+        {
+            float w = a->data[k] * d->data[a->col[k]];
+            if (w == 0)
+                continue;
+
+            unsigned int c = a->col[k];
+            for (unsigned int p = at->row_start[c]; p < at->row_start[c + 1]; p++)
             {
-                dot_prod += MATMN_AT(*x, j, 0) * MATMN_AT(*a, i, j);
+                unsigned int j = at->col[p];
+                if (position[j] == 0xffffffffu)
+                {
+                    position[j] = z->nnz;
+                    matcsr_push(z, j, 0);
+                }
+                z->data[position[j]] += w * at->data[p];
             }
+        }
+        for (unsigned int p = row_begin; p < z->nnz; p++)
+        {
+            position[z->col[p]] = 0xffffffffu;
+        }
+        matcsr_end_row(z);
+    }
+
+    mem_scratch_pop(mark);
+}
+
+// 1 / a[i][i] of every row into inv_diagonal, 0 where the diagonal is 0
+void matcsr_inv_diagonal(MatCSR *a, float *inv_diagonal)
+{
+    for (unsigned int i = 0; i < a->m; i++)
+    {
+        inv_diagonal[i] = 0;
+        for (unsigned int k = a->row_start[i]; k < a->row_start[i + 1]; k++)
+        {
+            if (a->col[k] == i && a->data[k] != 0)
+                inv_diagonal[i] = 1.0f / a->data[k];
+        }
+    }
+}
+
+// One sweep of projected Gauss-Seidel for the mixed LCP a @ x = b with lo <= x <= hi, see
+// matcsr_solve_pgs. Returns the largest change of an x and adds the squares of the changes
+// to sum_squares.
+float matcsr_sweep_pgs(MatCSR *a, MatMN *b, MatMN *x, MatMN *lo, MatMN *hi, int *findex, const float *inv_diagonal, float *sum_squares)
+{
+    float max_delta = 0;
+    for (unsigned int i = 0; i < a->m; i++)
+    {
+        if (inv_diagonal[i] == 0)
+            continue;
 
-            if (MATMN_AT(*a, i, i) != 0.0)
-                MATMN_AT(*x, i, 0) = MATMN_AT(*x, i, 0) + MATMN_AT(*b, i, 0) / MATMN_AT(*a, i, i) - dot_prod / MATMN_AT(*a, i, i);
+        float xi = x->data[i] + (b->data[i] - matcsr_row_dot(a, i, x)) * inv_diagonal[i];
+        float lower = lo->data[i];
+        float upper = hi->data[i];
+        if (findex[i] != MATCSR_NO_FINDEX)
+        {
+            upper = hi->data[i] * fabsf(x->data[findex[i]]);
+            lower = -upper;
         }
+
+        if (xi < lower)
+            xi = lower;
+        else if (xi > upper)
+            xi = upper;
+
+        float delta = fabsf(xi - x->data[i]);
+        max_delta = (delta > max_delta) ? delta : max_delta;
+        *sum_squares += delta * delta;
+        x->data[i] = xi;
+    }
+    return max_delta;
+}
+
+// Projected Gauss-Seidel for the mixed LCP a @ x = b with lo <= x <= hi. Rows with a
+// findex[i] other than MATCSR_NO_FINDEX are bounded by hi[i] * |x[findex[i]]| either way,
+// as friction is by the normal impulse. x comes in as the warm start and leaves as the
+// solution. Rows with a zero diagonal are left as they are.
+void matcsr_solve_pgs(MatCSR *a, MatMN *b, MatMN *x, MatMN *lo, MatMN *hi, int *findex, unsigned int iterations)
+{
+    assert(a->m == a->n);
+    assert(b->m == a->m && x->m == a->m && lo->m == a->m && hi->m == a->m);
+
+    ScratchMark mark = mem_scratch_push();
+    float *inv_diagonal = (float *)mem_calloc(a->m, sizeof(float), MEM_SCRATCH_POOL);
+    matcsr_inv_diagonal(a, inv_diagonal);
+
+    float sum_squares = 0;
+    for (unsigned int iter = 0; iter < iterations; iter++)
+    {
+        matcsr_sweep_pgs(a, b, x, lo, hi, findex, inv_diagonal, &sum_squares);
     }
+
+    mem_scratch_pop(mark);
 }
 
 #endif
\ No newline at end of file
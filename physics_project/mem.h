@@ -1,7 +1,10 @@
 #ifndef MEM_H
 #define MEM_H
 
+#include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define DEBUG_MEM
 
@@ -13,25 +16,177 @@ struct MemoryLog
     unsigned long heap_memory_calls;
 };
 
+// updated atomically, the job system allocates from several threads at once
 struct MemoryLog mem_log = {.heap_memory_allocated = 0, .heap_memory_calls = 0};
 
+#define MEM_ALIGN 16
+#define MEM_SCRATCH_BLOCK 65536
+
+// block of a scratch pool, allocations bump used
+struct MemBlock
+{
+    struct MemBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+// Temporaries of one thread that live inside a scope: take a mark with mem_scratch_push,
+// allocate, and give everything since the mark back with mem_scratch_pop. When a block is full
+// allocation moves on to a later block that fits, blocks are kept for the next time.
 struct ScratchPool
 {
-    char data[100000];
-    unsigned int index;
+    // blocks in the order they are used
+    struct MemBlock *first;
+    struct MemBlock *current;
+    size_t used;
+    // most bytes in use at once since mem_scratch_take_high_water
+    size_t high_water;
 };
 
-struct ScratchPool scratch_pool = {.index = 0};
+typedef struct
+{
+    struct MemBlock *block;
+    size_t block_used;
+    size_t used;
+} ScratchMark;
+
+struct ScratchPool scratch_pool = {NULL, NULL, 0, 0};
+
+// pool that MEM_SCRATCH_POOL allocations of this thread come from, worker threads point it at their own
+__thread struct ScratchPool *mem_scratch_pool = &scratch_pool;
 
+// where mem_calloc takes memory from, MEM_SCRATCH_POOL memory is not zeroed
 typedef enum
 {
     MEM_HEAP,
     MEM_SCRATCH_POOL
 } MEMORY_TAG;
 
+struct MemBlock *mem_block_create(size_t size)
+{
+#ifdef DEBUG_MEM
+    __atomic_add_fetch(&mem_log.heap_memory_allocated, sizeof(struct MemBlock) + size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mem_log.heap_memory_calls, 1, __ATOMIC_RELAXED);
+#endif
+    struct MemBlock *block = (struct MemBlock *)malloc(sizeof(struct MemBlock) + size);
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void mem_block_destroy_chain(struct MemBlock *block)
+{
+    for (struct MemBlock *next; block; block = next)
+    {
+        next = block->next;
+        free(block);
+    }
+}
+
+// bytes to skip from the used part of block so the next allocation is aligned to align, a
+// power of two
+size_t mem_block_padding(struct MemBlock *block, size_t align)
+{
+    uintptr_t next = (uintptr_t)&block->data[block->used];
+    return (0 - next) & (align - 1);
+}
+
+// size of the block to follow one of size bytes, big enough for needed bytes aligned to align
+size_t mem_block_grow(size_t size, size_t needed, size_t align)
+{
+    size_t block_size = 2 * size;
+    while (block_size < needed + align)
+    {
+        block_size *= 2;
+    }
+    return block_size;
+}
+
+// makes the current block one with room for size bytes aligned to align, moving on to the
+// first later block that fits or adding a bigger one at the end
+struct MemBlock *mem_scratch_next_block(struct ScratchPool *pool, size_t size, size_t align)
+{
+    struct MemBlock *last = pool->current;
+    struct MemBlock *next = last ? last->next : pool->first;
+    while (next && next->size < size + align)
+    {
+        last = next;
+        next = next->next;
+    }
+    if (!next)
+    {
+        while (last && last->next)
+        {
+            last = last->next;
+        }
+        next = mem_block_create(mem_block_grow(last ? last->size : MEM_SCRATCH_BLOCK / 2, size, align));
+        if (last)
+            last->next = next;
+        else
+            pool->first = next;
+    }
+    next->used = 0;
+    pool->current = next;
+    return next;
+}
+
+// size bytes aligned to align, a power of two, from the scratch pool of this thread
+void *mem_scratch_alloc(size_t size, size_t align)
+{
+    struct ScratchPool *pool = mem_scratch_pool;
+    struct MemBlock *block = pool->current;
+    size_t padding = block ? mem_block_padding(block, align) : 0;
+    if (!block || block->used + padding + size > block->size)
+    {
+        block = mem_scratch_next_block(pool, size, align);
+        padding = mem_block_padding(block, align);
+    }
+
+    void *data = &block->data[block->used + padding];
+    block->used += padding + size;
+    pool->used += padding + size;
+    if (pool->used > pool->high_water)
+        pool->high_water = pool->used;
+    return data;
+}
+
+ScratchMark mem_scratch_push()
+{
+    struct ScratchPool *pool = mem_scratch_pool;
+    return (ScratchMark){pool->current, pool->current ? pool->current->used : 0, pool->used};
+}
+
+// frees every scratch allocation made since mark was pushed, marks are popped in reverse order
+void mem_scratch_pop(ScratchMark mark)
+{
+    struct ScratchPool *pool = mem_scratch_pool;
+    assert(mark.used <= pool->used);
+    pool->current = mark.block ? mark.block : pool->first;
+    if (pool->current)
+        pool->current->used = mark.block ? mark.block_used : 0;
+    pool->used = mark.used;
+}
+
+// frees every scratch allocation of this thread
 void mem_reset_scratch_pool()
 {
-    scratch_pool.index = 0;
+    mem_scratch_pop((ScratchMark){NULL, 0, 0});
+}
+
+// most bytes the pool had in use at once since the last call
+size_t mem_scratch_take_high_water(struct ScratchPool *pool)
+{
+    size_t high_water = pool->high_water;
+    pool->high_water = pool->used;
+    return high_water;
+}
+
+void mem_scratch_pool_destroy(struct ScratchPool *pool)
+{
+    mem_block_destroy_chain(pool->first);
+    *pool = (struct ScratchPool){NULL, NULL, 0, 0};
 }
 
 void *mem_calloc(size_t n, size_t size, MEMORY_TAG tag)
@@ -41,30 +196,82 @@ void *mem_calloc(size_t n, size_t size, MEMORY_TAG tag)
     {
 #ifdef DEBUG_MEM
         // printf("[MEM] Allocating %zu objects of size %zu\n", n, size);
-        mem_log.heap_memory_allocated += n * size;
-        mem_log.heap_memory_calls++;
+        __atomic_add_fetch(&mem_log.heap_memory_allocated, n * size, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&mem_log.heap_memory_calls, 1, __ATOMIC_RELAXED);
 #endif
         return calloc(n, size);
     }
     else if (tag == MEM_SCRATCH_POOL)
     {
-        void *data_ptr = (void *)&scratch_pool.data[scratch_pool.index];
-        scratch_pool.index += n * size;
-        return data_ptr;
+        return mem_scratch_alloc(n * size, MEM_ALIGN);
+    }
+    return NULL;
+}
+
+// Like mem_calloc with the memory aligned to align, a power of two. Heap memory keeps the
+// pointer calloc returned just before the aligned one, it is given back with mem_free_aligned.
+void *mem_calloc_aligned(size_t n, size_t size, size_t align, MEMORY_TAG tag)
+{
+    if (tag == MEM_HEAP)
+    {
+        if (align < sizeof(void *))
+            align = sizeof(void *);
+#ifdef DEBUG_MEM
+        __atomic_add_fetch(&mem_log.heap_memory_allocated, n * size + align, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&mem_log.heap_memory_calls, 1, __ATOMIC_RELAXED);
+#endif
+        char *base = (char *)calloc(n * size + align, 1);
+        if (!base)
+            return NULL;
+        uintptr_t next = (uintptr_t)base + sizeof(void *);
+        void **data = (void **)(next + ((0 - next) & (align - 1)));
+        data[-1] = base;
+        return data;
+    }
+    else if (tag == MEM_SCRATCH_POOL)
+    {
+        return mem_scratch_alloc(n * size, align);
     }
+    return NULL;
 }
 
 void *mem_malloc(size_t size)
 {
 #ifdef DEBUG_MEM
     // printf("[MEM] Allocating %zu objects of size %zu\n", n, size);
-    mem_log.heap_memory_allocated += size;
-    mem_log.heap_memory_calls++;
+    __atomic_add_fetch(&mem_log.heap_memory_allocated, size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mem_log.heap_memory_calls, 1, __ATOMIC_RELAXED);
 #endif
 
     return malloc(size);
 }
 
+void *mem_realloc(void *a, size_t size)
+{
+#ifdef DEBUG_MEM
+    __atomic_add_fetch(&mem_log.heap_memory_allocated, size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mem_log.heap_memory_calls, 1, __ATOMIC_RELAXED);
+#endif
+
+    return realloc(a, size);
+}
+
+// grows a heap array so it holds at least needed elements, doubling the capacity
+void *mem_grow(void *a, unsigned int *capacity, unsigned int needed, size_t size)
+{
+    if (needed <= *capacity)
+        return a;
+
+    unsigned int new_capacity = (*capacity > 0) ? *capacity : 16;
+    while (new_capacity < needed)
+    {
+        new_capacity *= 2;
+    }
+    *capacity = new_capacity;
+
+    return mem_realloc(a, new_capacity * size);
+}
+
 void mem_free(void *a)
 {
 #ifdef DEBUG_MEM
@@ -73,4 +280,11 @@ void mem_free(void *a)
     free(a);
 }
 
+// frees heap memory from mem_calloc_aligned
+void mem_free_aligned(void *a)
+{
+    if (a)
+        mem_free(((void **)a)[-1]);
+}
+
 #endif
\ No newline at end of file
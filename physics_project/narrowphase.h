@@ -0,0 +1,126 @@
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "collision.h"
+#include "manifold.h"
+#include "mem.h"
+
+// what the narrowphase found for one broadphase pair
+typedef struct
+{
+    unsigned int pair;
+    // neither body moved, the pair keeps its manifold from the last step
+    bool keep;
+    unsigned int n_points;
+    Collision_Info points[MANIFOLD_MAX_POINTS];
+} NarrowphaseResult;
+
+typedef struct
+{
+    NarrowphaseResult *results;
+    unsigned int capacity;
+    unsigned int n_results;
+} NarrowphaseBuffer;
+
+// Results of the pairs, written by every thread into its own buffer and then merged in
+// pair order, so the manifolds and the solver see the same order for any number of threads
+typedef struct
+{
+    NarrowphaseBuffer *buffers;
+    unsigned int n_buffers;
+
+    NarrowphaseResult *results;
+    unsigned int results_capacity;
+    unsigned int n_results;
+} Narrowphase;
+
+void narrowphase_create(Narrowphase *np)
+{
+    np->buffers = NULL;
+    np->n_buffers = 0;
+    np->results = NULL;
+    np->results_capacity = 0;
+    np->n_results = 0;
+}
+
+void narrowphase_destroy(Narrowphase *np)
+{
+    for (unsigned int t = 0; t < np->n_buffers; t++)
+    {
+        mem_free(np->buffers[t].results);
+    }
+    mem_free(np->buffers);
+    mem_free(np->results);
+    narrowphase_create(np);
+}
+
+// empties the buffers, with one buffer for each of n_threads threads
+void narrowphase_begin(Narrowphase *np, unsigned int n_threads)
+{
+    if (n_threads > np->n_buffers)
+    {
+        np->buffers = (NarrowphaseBuffer *)mem_realloc(np->buffers, n_threads * sizeof(NarrowphaseBuffer));
+        for (unsigned int t = np->n_buffers; t < n_threads; t++)
+        {
+            np->buffers[t] = (NarrowphaseBuffer){NULL, 0, 0};
+        }
+        np->n_buffers = n_threads;
+    }
+
+    for (unsigned int t = 0; t < np->n_buffers; t++)
+    {
+        np->buffers[t].n_results = 0;
+    }
+    np->n_results = 0;
+}
+
+// appends a result to the buffer of thread
+NarrowphaseResult *narrowphase_push(Narrowphase *np, unsigned int thread, unsigned int pair)
+{
+    NarrowphaseBuffer *buffer = &np->buffers[thread];
+    buffer->results = (NarrowphaseResult *)mem_grow(buffer->results, &buffer->capacity, buffer->n_results + 1, sizeof(NarrowphaseResult));
+
+    NarrowphaseResult *result = &buffer->results[buffer->n_results++];
+    result->pair = pair;
+    result->keep = false;
+    result->n_points = 0;
+    return result;
+}
+
+int narrowphase_result_compare(const void *p0, const void *p1)
+{
+    const NarrowphaseResult *a = (const NarrowphaseResult *)p0;
+    const NarrowphaseResult *b = (const NarrowphaseResult *)p1;
+    return (a->pair > b->pair) - (a->pair < b->pair);
+}
+
+// Gathers the buffers into results, sorted by pair. A pair has at most one result.
+void narrowphase_merge(Narrowphase *np)
+{
+    unsigned int n = 0;
+    for (unsigned int t = 0; t < np->n_buffers; t++)
+    {
+        n += np->buffers[t].n_results;
+    }
+    np->n_results = 0;
+    if (n == 0)
+        return;
+    np->results = (NarrowphaseResult *)mem_grow(np->results, &np->results_capacity, n, sizeof(NarrowphaseResult));
+
+    for (unsigned int t = 0; t < np->n_buffers; t++)
+    {
+        NarrowphaseBuffer *buffer = &np->buffers[t];
+        if (buffer->n_results == 0)
+            continue;
+        memcpy(&np->results[np->n_results], buffer->results, buffer->n_results * sizeof(NarrowphaseResult));
+        np->n_results += buffer->n_results;
+    }
+
+    qsort(np->results, np->n_results, sizeof(NarrowphaseResult), narrowphase_result_compare);
+}
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef PAIR_MAP_H
+#define PAIR_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mem.h"
+
+#define PAIR_MAP_NULL -1
+
+typedef struct
+{
+    uint64_t a;
+    uint64_t b;
+} PairKey;
+
+// Set of key pairs stored densely in keys[0..n_keys), with an open addressing hash table
+// of indices into it. Callers keep their values in a parallel array, and must mirror the
+// swap remove done by pair_map_remove.
+typedef struct
+{
+    PairKey *keys;
+    unsigned int keys_capacity;
+    unsigned int n_keys;
+
+    int *slots;
+    unsigned int n_slots;
+} PairMap;
+
+void pair_map_create(PairMap *map)
+{
+    memset(map, 0, sizeof(PairMap));
+}
+
+void pair_map_destroy(PairMap *map)
+{
+    mem_free(map->keys);
+    mem_free(map->slots);
+    pair_map_create(map);
+}
+
+void pair_map_clear(PairMap *map)
+{
+    map->n_keys = 0;
+    if (map->n_slots > 0)
+        memset(map->slots, 0xff, map->n_slots * sizeof(int));
+}
+
+unsigned int pair_map_home(PairMap *map, PairKey key)
+{
+    uint64_t h = key.a * 0x9E3779B97F4A7C15ull ^ key.b * 0xC2B2AE3D27D4EB4Full;
+    return (unsigned int)(h ^ (h >> 32)) & (map->n_slots - 1);
+}
+
+int pair_map_find_slot(PairMap *map, PairKey key)
+{
+    if (map->n_slots == 0)
+        return PAIR_MAP_NULL;
+
+    unsigned int mask = map->n_slots - 1;
+    for (unsigned int slot = pair_map_home(map, key); map->slots[slot] != PAIR_MAP_NULL; slot = (slot + 1) & mask)
+    {
+        PairKey *k = &map->keys[map->slots[slot]];
+        if (k->a == key.a && k->b == key.b)
+            return slot;
+    }
+    return PAIR_MAP_NULL;
+}
+
+// index of the key in keys, or PAIR_MAP_NULL
+int pair_map_find(PairMap *map, PairKey key)
+{
+    int slot = pair_map_find_slot(map, key);
+    return (slot == PAIR_MAP_NULL) ? PAIR_MAP_NULL : map->slots[slot];
+}
+
+void pair_map_insert_slot(PairMap *map, unsigned int index)
+{
+    unsigned int mask = map->n_slots - 1;
+    unsigned int slot = pair_map_home(map, map->keys[index]);
+    while (map->slots[slot] != PAIR_MAP_NULL)
+    {
+        slot = (slot + 1) & mask;
+    }
+    map->slots[slot] = index;
+}
+
+// Returns the index of the key, new keys are appended at n_keys - 1
+unsigned int pair_map_insert(PairMap *map, PairKey key)
+{
+    int index = pair_map_find(map, key);
+    if (index != PAIR_MAP_NULL)
+        return index;
+
+    // keep the table at most half full
+    if (2 * (map->n_keys + 1) > map->n_slots)
+    {
+        map->n_slots = (map->n_slots > 0) ? 2 * map->n_slots : 64;
+        mem_free(map->slots);
+        map->slots = (int *)mem_malloc(map->n_slots * sizeof(int));
+        memset(map->slots, 0xff, map->n_slots * sizeof(int));
+        for (unsigned int i = 0; i < map->n_keys; i++)
+        {
+            pair_map_insert_slot(map, i);
+        }
+    }
+
+    map->keys = (PairKey *)mem_grow(map->keys, &map->keys_capacity, map->n_keys + 1, sizeof(PairKey));
+    map->keys[map->n_keys] = key;
+    pair_map_insert_slot(map, map->n_keys);
+    return map->n_keys++;
+}
+
+// Removes the key and moves the last key into its index. Returns the index the key had,
+// or PAIR_MAP_NULL if it was not in the map.
+int pair_map_remove(PairMap *map, PairKey key)
+{
+    int slot = pair_map_find_slot(map, key);
+    if (slot == PAIR_MAP_NULL)
+        return PAIR_MAP_NULL;
+
+    unsigned int index = map->slots[slot];
+
+    // backward shift deletion, pulls later entries of the probe chain into the hole
+    unsigned int mask = map->n_slots - 1;
+    unsigned int hole = slot;
+    for (unsigned int next = (hole + 1) & mask; map->slots[next] != PAIR_MAP_NULL; next = (next + 1) & mask)
+    {
+        unsigned int home = pair_map_home(map, map->keys[map->slots[next]]);
+        bool movable = (hole <= next) ? (home <= hole || home > next) : (home <= hole && home > next);
+        if (movable)
+        {
+            map->slots[hole] = map->slots[next];
+            hole = next;
+        }
+    }
+    map->slots[hole] = PAIR_MAP_NULL;
+
+    unsigned int last = map->n_keys - 1;
+    if (index != last)
+    {
+        map->slots[pair_map_find_slot(map, map->keys[last])] = index;
+        map->keys[index] = map->keys[last];
+    }
+    map->n_keys--;
+
+    return index;
+}
+
+#endif
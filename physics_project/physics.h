@@ -0,0 +1,20 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+// The physics without the application: bodies, shapes, collision, constraints, forces, the
+// matrices and memory, stepped by a world. Needs no SDL and no window, only -lm and -pthread.
+// What it would like drawn is recorded in World.debug_draw when enabled.
+
+#include "body.h"
+#include "collision.h"
+#include "constraint.h"
+#include "debug_draw.h"
+#include "fixed_step.h"
+#include "force.h"
+#include "matmn.h"
+#include "mem.h"
+#include "shape.h"
+#include "trace.h"
+#include "world.h"
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef SAP_H
+#define SAP_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aabb.h"
+#include "mem.h"
+#include "pair_map.h"
+
+#define SAP_NULL -1
+
+// more new proxies than this in one update rebuild the axes instead of insertion sorting them in
+#define SAP_REBUILD_THRESHOLD 64
+
+typedef struct
+{
+    float value;
+    // proxy << 1 | is_max
+    unsigned int data;
+} SAPEndpoint;
+
+typedef struct
+{
+    AABB aabb;
+    int body;
+} SAPProxy;
+
+typedef struct
+{
+    // 1 tracks pairs overlapping on x only, 2 tracks pairs overlapping on both axes
+    unsigned int n_axes;
+
+    SAPProxy *proxies;
+    unsigned int proxies_capacity;
+    unsigned int n_proxies;
+    unsigned int n_new_proxies;
+
+    // endpoints sorted by value on each axis, kept sorted from one update to the next
+    SAPEndpoint *endpoints[2];
+    unsigned int endpoints_capacity[2];
+    unsigned int n_endpoints;
+
+    // overlapping proxy pairs, a < b
+    PairMap pairs;
+
+    unsigned int *active;
+    unsigned int active_capacity;
+    unsigned int *active_index;
+    unsigned int active_index_capacity;
+
+    unsigned long n_pairs_added;
+    unsigned long n_pairs_removed;
+    unsigned long n_overlap_tests;
+} SweepAndPrune;
+
+void sap_create(SweepAndPrune *sap, unsigned int n_axes)
+{
+    memset(sap, 0, sizeof(SweepAndPrune));
+    sap->n_axes = n_axes;
+}
+
+void sap_destroy(SweepAndPrune *sap)
+{
+    mem_free(sap->proxies);
+    mem_free(sap->endpoints[0]);
+    mem_free(sap->endpoints[1]);
+    pair_map_destroy(&sap->pairs);
+    mem_free(sap->active);
+    mem_free(sap->active_index);
+    sap_create(sap, sap->n_axes);
+}
+
+unsigned int sap_endpoint_proxy(SAPEndpoint e)
+{
+    return e.data >> 1;
+}
+
+bool sap_endpoint_is_max(SAPEndpoint e)
+{
+    return (e.data & 1) != 0;
+}
+
+// at equal values the min comes first, so touching boxes overlap like in aabb_overlap
+bool sap_endpoint_less(SAPEndpoint a, SAPEndpoint b)
+{
+    if (a.value != b.value)
+        return a.value < b.value;
+    return sap_endpoint_is_max(b) && !sap_endpoint_is_max(a);
+}
+
+int sap_endpoint_compare(const void *p0, const void *p1)
+{
+    SAPEndpoint a = *(const SAPEndpoint *)p0;
+    SAPEndpoint b = *(const SAPEndpoint *)p1;
+    if (sap_endpoint_less(a, b))
+        return -1;
+    if (sap_endpoint_less(b, a))
+        return 1;
+    return 0;
+}
+
+PairKey sap_pair_key(unsigned int a, unsigned int b)
+{
+    if (a < b)
+        return (PairKey){a, b};
+    return (PairKey){b, a};
+}
+
+void sap_add_pair(SweepAndPrune *sap, unsigned int a, unsigned int b)
+{
+    unsigned int n_pairs = sap->pairs.n_keys;
+    pair_map_insert(&sap->pairs, sap_pair_key(a, b));
+    if (sap->pairs.n_keys > n_pairs)
+        sap->n_pairs_added++;
+}
+
+void sap_remove_pair(SweepAndPrune *sap, unsigned int a, unsigned int b)
+{
+    if (pair_map_remove(&sap->pairs, sap_pair_key(a, b)) != PAIR_MAP_NULL)
+        sap->n_pairs_removed++;
+}
+
+bool sap_overlap(SweepAndPrune *sap, unsigned int a, unsigned int b)
+{
+    sap->n_overlap_tests++;
+    if (sap->n_axes == 1)
+        return true;
+    return aabb_overlap(sap->proxies[a].aabb, sap->proxies[b].aabb);
+}
+
+int sap_create_proxy(SweepAndPrune *sap, AABB aabb, int body)
+{
+    unsigned int proxy = sap->n_proxies++;
+    sap->proxies = (SAPProxy *)mem_grow(sap->proxies, &sap->proxies_capacity, sap->n_proxies, sizeof(SAPProxy));
+    sap->proxies[proxy] = (SAPProxy){.aabb = aabb, .body = body};
+
+    // appended at the end, the next update sorts them into place
+    for (unsigned int axis = 0; axis < 2; axis++)
+    {
+        sap->endpoints[axis] = (SAPEndpoint *)mem_grow(sap->endpoints[axis], &sap->endpoints_capacity[axis], sap->n_endpoints + 2, sizeof(SAPEndpoint));
+        sap->endpoints[axis][sap->n_endpoints] = (SAPEndpoint){aabb.min.r[axis], proxy << 1};
+        sap->endpoints[axis][sap->n_endpoints + 1] = (SAPEndpoint){aabb.max.r[axis], (proxy << 1) | 1};
+    }
+    sap->n_endpoints += 2;
+    sap->n_new_proxies++;
+
+    return proxy;
+}
+
+void sap_set_proxy(SweepAndPrune *sap, int proxy, AABB aabb, int body)
+{
+    sap->proxies[proxy].aabb = aabb;
+    sap->proxies[proxy].body = body;
+}
+
+// Insertion sort of one axis. An endpoint only ever passes the endpoints whose order
+// against it changed since the last update, which is where overlaps begin and end.
+void sap_sort_axis(SweepAndPrune *sap, unsigned int axis)
+{
+    SAPEndpoint *e = sap->endpoints[axis];
+    for (unsigned int i = 1; i < sap->n_endpoints; i++)
+    {
+        SAPEndpoint key = e[i];
+        unsigned int j = i;
+        while (j > 0 && sap_endpoint_less(key, e[j - 1]))
+        {
+            SAPEndpoint left = e[j - 1];
+            bool key_is_max = sap_endpoint_is_max(key);
+            bool left_is_max = sap_endpoint_is_max(left);
+
+            if (!key_is_max && left_is_max)
+            {
+                if (sap_overlap(sap, sap_endpoint_proxy(key), sap_endpoint_proxy(left)))
+                    sap_add_pair(sap, sap_endpoint_proxy(key), sap_endpoint_proxy(left));
+            }
+            else if (key_is_max && !left_is_max)
+            {
+                sap_remove_pair(sap, sap_endpoint_proxy(key), sap_endpoint_proxy(left));
+            }
+
+            e[j] = left;
+            j--;
+        }
+        e[j] = key;
+    }
+}
+
+// Sorts from scratch and finds every pair with one sweep over x, used when too many
+// proxies arrived at once for the insertion sort to be cheap
+void sap_rebuild(SweepAndPrune *sap)
+{
+    for (unsigned int axis = 0; axis < sap->n_axes; axis++)
+    {
+        qsort(sap->endpoints[axis], sap->n_endpoints, sizeof(SAPEndpoint), sap_endpoint_compare);
+    }
+
+    pair_map_clear(&sap->pairs);
+
+    sap->active = (unsigned int *)mem_grow(sap->active, &sap->active_capacity, sap->n_proxies, sizeof(unsigned int));
+    sap->active_index = (unsigned int *)mem_grow(sap->active_index, &sap->active_index_capacity, sap->n_proxies, sizeof(unsigned int));
+    unsigned int n_active = 0;
+
+    for (unsigned int i = 0; i < sap->n_endpoints; i++)
+    {
+        SAPEndpoint e = sap->endpoints[0][i];
+        unsigned int proxy = sap_endpoint_proxy(e);
+
+        if (sap_endpoint_is_max(e))
+        {
+            unsigned int index = sap->active_index[proxy];
+            sap->active[index] = sap->active[--n_active];
+            sap->active_index[sap->active[index]] = index;
+        }
+        else
+        {
+            for (unsigned int k = 0; k < n_active; k++)
+            {
+                if (sap_overlap(sap, proxy, sap->active[k]))
+                    sap_add_pair(sap, proxy, sap->active[k]);
+            }
+            sap->active_index[proxy] = n_active;
+            sap->active[n_active++] = proxy;
+        }
+    }
+}
+
+// Call after every proxy has its new AABB
+void sap_update(SweepAndPrune *sap)
+{
+    sap->n_pairs_added = 0;
+    sap->n_pairs_removed = 0;
+    sap->n_overlap_tests = 0;
+
+    // with one axis the y endpoints are never sorted
+    for (unsigned int axis = 0; axis < sap->n_axes; axis++)
+    {
+        SAPEndpoint *e = sap->endpoints[axis];
+        for (unsigned int i = 0; i < sap->n_endpoints; i++)
+        {
+            AABB *aabb = &sap->proxies[sap_endpoint_proxy(e[i])].aabb;
+            e[i].value = sap_endpoint_is_max(e[i]) ? aabb->max.r[axis] : aabb->min.r[axis];
+        }
+    }
+
+    if (sap->n_new_proxies > SAP_REBUILD_THRESHOLD)
+    {
+        sap_rebuild(sap);
+    }
+    else
+    {
+        for (unsigned int axis = 0; axis < sap->n_axes; axis++)
+        {
+            sap_sort_axis(sap, axis);
+        }
+    }
+    sap->n_new_proxies = 0;
+}
+
+#endif
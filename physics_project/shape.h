@@ -1,7 +1,11 @@
 #ifndef SHAPE_H
 #define SHAPE_H
 
+#include <string.h>
+
 #include "vec2.h"
+#include "aabb.h"
+#include "mem.h"
 
 #define MAX_VERTICES 20
 
@@ -19,75 +23,157 @@ typedef struct
 
 typedef struct
 {
-    Vec2 local_vertices[MAX_VERTICES];
-    Vec2 global_vertices[MAX_VERTICES];
+    Vec2 half_extents;
+} Box;
+
+// vertices [first_vertex, first_vertex + n_vertices) of shape_vertex_pool, in body space
+typedef struct
+{
+    unsigned int first_vertex;
     unsigned int n_vertices;
 } Polygon;
 
-Circle circle_create(float radius)
+// Shape stored inline in its body. World space vertices are not kept, collision and the
+// bounding boxes work them out from the body's position and angle when they need them.
+typedef struct
 {
-    Circle c;
-    c.radius = radius;
-    return c;
-}
+    ShapeType type;
+    union
+    {
+        Circle circle;
+        Box box;
+        Polygon polygon;
+    };
+} Shape;
 
-Polygon box_create(float width, float height)
+// Body space vertices of all polygons, each polygon takes exactly as many as it has. The
+// ranges of released polygons are kept in free and reused by new polygons of the same size.
+typedef struct
 {
-    Polygon b;
+    Vec2 *vertices;
+    unsigned int capacity;
+    unsigned int n_vertices;
+    Polygon *free;
+    unsigned int free_capacity;
+    unsigned int n_free;
+    unsigned int n_free_vertices;
+} ShapeVertexPool;
 
-    b.n_vertices = 4;
-    b.local_vertices[0] = (Vec2){-width / 2.0, -height / 2.0};
-    b.local_vertices[1] = (Vec2){width / 2.0, -height / 2.0};
-    b.local_vertices[2] = (Vec2){width / 2.0, height / 2.0};
-    b.local_vertices[3] = (Vec2){-width / 2.0, height / 2.0};
-    b.global_vertices[0] = (Vec2){-width / 2.0, -height / 2.0};
-    b.global_vertices[1] = (Vec2){width / 2.0, -height / 2.0};
-    b.global_vertices[2] = (Vec2){width / 2.0, height / 2.0};
-    b.global_vertices[3] = (Vec2){-width / 2.0, height / 2.0};
+// A polygon belongs to the one body it is given to, and the world gives its vertices back
+// when the body is removed or the world destroyed. Polygons have to be created while no
+// world_update is running, growing the pool moves it.
+ShapeVertexPool shape_vertex_pool = {NULL, 0, 0, NULL, 0, 0, 0};
 
-    return b;
+// world space vertices of a box or polygon
+typedef struct
+{
+    Vec2 vertices[MAX_VERTICES];
+    unsigned int n_vertices;
+} PolygonVertices;
+
+Shape circle_create(float radius)
+{
+    Shape s;
+    s.type = CIRCLE;
+    s.circle.radius = radius;
+    return s;
+}
+
+Shape box_create(float width, float height)
+{
+    Shape s;
+    s.type = BOX;
+    s.box.half_extents = (Vec2){.x = width / 2.0, .y = height / 2.0};
+    return s;
 }
 
-Polygon polygon_create(Vec2 *vertices, unsigned int n_vertices)
+Shape polygon_create(Vec2 *vertices, unsigned int n_vertices)
 {
-    Polygon p;
-    p.n_vertices = n_vertices;
-    for (unsigned int i = 0; i < n_vertices; i++)
+    ShapeVertexPool *pool = &shape_vertex_pool;
+    Shape s;
+    s.type = POLYGON;
+    s.polygon.n_vertices = n_vertices;
+
+    // a released range of the same size, or new room at the end
+    unsigned int i = 0;
+    while (i < pool->n_free && pool->free[i].n_vertices != n_vertices)
+        i++;
+    if (i < pool->n_free)
     {
-        p.local_vertices[i] = vertices[i];
-        p.global_vertices[i] = vertices[i];
+        s.polygon.first_vertex = pool->free[i].first_vertex;
+        pool->free[i] = pool->free[--pool->n_free];
+        pool->n_free_vertices -= n_vertices;
     }
-    return p;
+    else
+    {
+        pool->vertices = (Vec2 *)mem_grow(pool->vertices, &pool->capacity, pool->n_vertices + n_vertices, sizeof(Vec2));
+        s.polygon.first_vertex = pool->n_vertices;
+        pool->n_vertices += n_vertices;
+    }
+    memcpy(&pool->vertices[s.polygon.first_vertex], vertices, n_vertices * sizeof(Vec2));
+    return s;
 }
 
-void shape_update_vertices(float theta, Vec2 position, ShapeType shape_type, void *shape)
+// Gives the vertices of a polygon back to the pool, other shapes own nothing. The pool is
+// freed once no polygon is left.
+void shape_release(Shape *shape)
 {
-    if (shape_type == CIRCLE)
+    if (shape->type != POLYGON)
         return;
-    else if (shape_type == BOX || shape_type == POLYGON)
+
+    ShapeVertexPool *pool = &shape_vertex_pool;
+    pool->free = (Polygon *)mem_grow(pool->free, &pool->free_capacity, pool->n_free + 1, sizeof(Polygon));
+    pool->free[pool->n_free++] = shape->polygon;
+    pool->n_free_vertices += shape->polygon.n_vertices;
+    if (pool->n_free_vertices == pool->n_vertices)
     {
-        Polygon *p = (Polygon*)shape;
-        for (unsigned int i = 0; i < p->n_vertices; i++)
-        {
-            p->global_vertices[i] = vec2_rotate_rad(p->local_vertices[i], theta);
-            p->global_vertices[i] = vec2_add(p->global_vertices[i], position);
-        }
+        mem_free(pool->vertices);
+        mem_free(pool->free);
+        *pool = (ShapeVertexPool){NULL, 0, 0, NULL, 0, 0, 0};
     }
 }
 
-float shape_moment_of_inertia(ShapeType shape_type, void *shape)
+// body space vertices of a box or polygon, returns how many
+unsigned int shape_local_vertices(Shape *shape, Vec2 vertices[MAX_VERTICES])
+{
+    if (shape->type == BOX)
+    {
+        Vec2 h = shape->box.half_extents;
+        vertices[0] = (Vec2){.x = -h.x, .y = -h.y};
+        vertices[1] = (Vec2){.x = h.x, .y = -h.y};
+        vertices[2] = (Vec2){.x = h.x, .y = h.y};
+        vertices[3] = (Vec2){.x = -h.x, .y = h.y};
+        return 4;
+    }
+    else if (shape->type == POLYGON)
+    {
+        memcpy(vertices, &shape_vertex_pool.vertices[shape->polygon.first_vertex], shape->polygon.n_vertices * sizeof(Vec2));
+        return shape->polygon.n_vertices;
+    }
+    return 0;
+}
+
+// world space vertices of a box or polygon at position, rotated by theta
+void shape_global_vertices(Shape *shape, Vec2 position, float theta, PolygonVertices *out)
+{
+    out->n_vertices = shape_local_vertices(shape, out->vertices);
+    for (unsigned int i = 0; i < out->n_vertices; i++)
+    {
+        out->vertices[i] = vec2_add(vec2_rotate_rad(out->vertices[i], theta), position);
+    }
+}
+
+float shape_moment_of_inertia(Shape *shape)
 {
     float inertia = 0;
-    switch (shape_type)
+    switch (shape->type)
     {
-    case CIRCLE:;
-        Circle *c = (Circle *)shape;
-        inertia = 0.5 * c->radius * c->radius;
+    case CIRCLE:
+        inertia = 0.5 * shape->circle.radius * shape->circle.radius;
         break;
     case BOX:;
-        Polygon *b = (Polygon *)shape;
-        float width = b->local_vertices[1].x - b->local_vertices[0].x;
-        float height = b->local_vertices[2].y - b->local_vertices[1].y;
+        float width = 2 * shape->box.half_extents.x;
+        float height = 2 * shape->box.half_extents.y;
         inertia = (1.0 / 12.0) * (width * width + height * height);
         break;
     case POLYGON:
@@ -98,10 +184,36 @@ float shape_moment_of_inertia(ShapeType shape_type, void *shape)
     return inertia;
 }
 
-Vec2 polygon_edge_at(Polygon *p, unsigned int index)
+AABB shape_aabb(Shape *shape, Vec2 position, float theta)
+{
+    if (shape->type == CIRCLE)
+    {
+        float r = shape->circle.radius;
+        return aabb_create((Vec2){.x = position.x - r, .y = position.y - r}, (Vec2){.x = position.x + r, .y = position.y + r});
+    }
+
+    PolygonVertices p;
+    shape_global_vertices(shape, position, theta, &p);
+    AABB box = aabb_create(p.vertices[0], p.vertices[0]);
+    for (unsigned int i = 1; i < p.n_vertices; i++)
+    {
+        Vec2 v = p.vertices[i];
+        if (v.x < box.min.x)
+            box.min.x = v.x;
+        if (v.y < box.min.y)
+            box.min.y = v.y;
+        if (v.x > box.max.x)
+            box.max.x = v.x;
+        if (v.y > box.max.y)
+            box.max.y = v.y;
+    }
+    return box;
+}
+
+Vec2 polygon_edge_at(PolygonVertices *p, unsigned int index)
 {
     unsigned int next_index = (index + 1) % (p->n_vertices);
-    return vec2_sub(p->global_vertices[next_index], p->global_vertices[index]);
+    return vec2_sub(p->vertices[next_index], p->vertices[index]);
 }
 
-#endif
\ No newline at end of file
+#endif
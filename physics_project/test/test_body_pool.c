@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include "test_util.h"
+
+// removal keeps the bodies packed and the handles of the others pointing at the same bodies
+int test_pool()
+{
+    int failed = 0;
+    BodyPool pool;
+    body_pool_create(&pool);
+    Shape circle = circle_create(10.0);
+
+    BodyHandle handles[5];
+    for (int i = 0; i < 5; i++)
+    {
+        handles[i] = body_pool_add(&pool, body_create(circle, i, 0, 1.0));
+    }
+
+    body_pool_remove(&pool, handles[1]);
+    printf("removed 1 of 5: %u bodies, body 4 now at index %u\n", pool.n_bodies, body_pool_get(&pool, handles[4])->world_index);
+    failed |= check(pool.n_bodies == 4, "expected 4 bodies");
+    failed |= check(body_pool_get(&pool, handles[1]) == NULL, "removed handle still resolves");
+    failed |= check(body_pool_get(&pool, handles[4]) == &pool.bodies[1], "last body should fill the hole");
+    for (int i = 0; i < 5; i++)
+    {
+        Body *b = body_pool_get(&pool, handles[i]);
+        failed |= check(i == 1 || (b && b->position.x == i), "handle lost its body");
+    }
+
+    // the freed slot is reused with a new generation, the old handle stays dead
+    BodyHandle reused = body_pool_add(&pool, body_create(circle, 10, 0, 1.0));
+    failed |= check(reused.slot == handles[1].slot && reused.generation != handles[1].generation, "expected the slot reused");
+    failed |= check(body_pool_get(&pool, handles[1]) == NULL, "old handle resolves to the new body");
+    failed |= check(body_pool_get(&pool, reused)->position.x == 10, "new handle lost its body");
+
+    body_pool_destroy(&pool);
+    return failed;
+}
+
+// Drops piles and removes bodies while they rest on each other, with joints and manifolds
+// attached to the removed bodies
+int test_world(BroadphaseType type, const char *name)
+{
+    int failed = 0;
+    World w;
+    world_create(&w, -9.8f);
+    world_set_broadphase(&w, type);
+    add_box(&w, 500, 1000, 1000, 50, 0.0);
+
+    BodyHandle boxes[30];
+    for (int i = 0; i < 30; i++)
+    {
+        boxes[i] = add_box(&w, 100 + (i / 5) * 100, 955 - (i % 5) * 40.5f, 40, 40, 1.0);
+    }
+    world_add_joint(&w, boxes[0], boxes[5], world_get_body(&w, boxes[0])->position);
+
+    for (int frame = 0; frame < 60; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+    }
+
+    unsigned int n_manifolds = manifold_cache_size(&w.manifolds);
+    world_remove_body(&w, boxes[5]);
+    for (int i = 10; i < 30; i += 4)
+    {
+        world_remove_body(&w, boxes[i]);
+    }
+    failed |= check(w.joint_constraints.start == NULL, "joint of a removed body kept");
+    failed |= check(world_get_body(&w, boxes[5]) == NULL, "removed body still resolves");
+
+    for (int frame = 0; frame < 60; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+    }
+
+    bool moved = false;
+    for (int i = 0; i < 30; i++)
+    {
+        Body *b = world_get_body(&w, boxes[i]);
+        moved = moved || (b && fabsf(b->position.x - (100 + (i / 5) * 100)) > 10.0f);
+    }
+    printf("%s: %u bodies, manifolds %u -> %u\n", name, w.body_pool.n_bodies, n_manifolds, manifold_cache_size(&w.manifolds));
+    failed |= check(w.body_pool.n_bodies == 25, "expected 25 bodies left");
+    failed |= check(manifold_cache_size(&w.manifolds) < n_manifolds, "manifolds of removed bodies kept");
+    failed |= check(!moved, "a pile slid sideways after the removal");
+
+    world_destroy(&w);
+    return failed;
+}
+
+// Adding and removing bodies moves them in the array without a step in between, as when
+// the application adds one on a frame that runs no step. The joints follow at once.
+int test_joint_bodies()
+{
+    int failed = 0;
+    World w;
+    world_create(&w, -9.8f);
+    BodyHandle a = add_box(&w, 100, 100, 20, 20, 0.0);
+    BodyHandle b = add_box(&w, 130, 100, 20, 20, 1.0);
+    JointConstraint *jc = world_add_joint(&w, a, b, (Vec2){.x = 115, .y = 100});
+
+    Body *before = w.body_pool.bodies;
+    BodyHandle boxes[100];
+    for (int i = 0; i < 100; i++)
+    {
+        boxes[i] = add_box(&w, 300 + i * 30, 100, 20, 20, 1.0);
+    }
+    printf("joint: bodies %s, joint on the bodies of its handles %s\n", w.body_pool.bodies != before ? "moved" : "stayed",
+           jc->a == world_get_body(&w, a) && jc->b == world_get_body(&w, b) ? "yes" : "no");
+    failed |= check(jc->a == world_get_body(&w, a) && jc->b == world_get_body(&w, b), "joint points at bodies the pool moved");
+
+    // the last body fills the hole of a removed one
+    JointConstraint *last = world_add_joint(&w, b, boxes[99], (Vec2){.x = 500, .y = 100});
+    world_remove_body(&w, boxes[10]);
+    failed |= check(last->b == world_get_body(&w, boxes[99]), "joint lost its body on a removal");
+
+    world_destroy(&w);
+    return failed;
+}
+
+// Polygon bodies added and removed over and over reuse the vertices of the removed ones, and
+// the pool is gone with the last world
+int test_polygon_churn()
+{
+    int failed = 0;
+    World w;
+    world_create(&w, -9.8f);
+    Vec2 triangle[3] = {{.x = 0, .y = -10}, {.x = 10, .y = 10}, {.x = -10, .y = 10}};
+    Vec2 square[4] = {{.x = -10, .y = -10}, {.x = 10, .y = -10}, {.x = 10, .y = 10}, {.x = -10, .y = 10}};
+    BodyHandle kept = world_add_body(&w, body_create(polygon_create(square, 4), 0, 0, 1.0));
+
+    BodyHandle churn[50];
+    unsigned int most = 0;
+    for (int round = 0; round < 20; round++)
+    {
+        for (int i = 0; i < 50; i++)
+        {
+            Shape shape = (i % 2) ? polygon_create(triangle, 3) : polygon_create(square, 4);
+            churn[i] = world_add_body(&w, body_create(shape, 100 + i * 30, 0, 1.0));
+        }
+        most = MAX(most, shape_vertex_pool.n_vertices);
+        for (int i = 0; i < 50; i++)
+        {
+            world_remove_body(&w, churn[i]);
+        }
+    }
+
+    Vec2 vertices[MAX_VERTICES];
+    unsigned int n = shape_local_vertices(&world_get_body(&w, kept)->shape, vertices);
+    printf("polygon churn: at most %u vertices in the pool over 20 rounds of 50 polygons\n", most);
+    failed |= check(most == 4 + 25 * 3 + 25 * 4, "removed polygons were not reused");
+    failed |= check(n == 4 && vertices[2].x == 10 && vertices[2].y == 10, "kept polygon lost its vertices");
+
+    world_destroy(&w);
+    failed |= check(shape_vertex_pool.vertices == NULL, "pool kept after the last world");
+    return failed;
+}
+
+int main()
+{
+    int failed = test_pool();
+    failed |= test_joint_bodies();
+    failed |= test_polygon_churn();
+    failed |= test_world(BROADPHASE_SPATIAL_HASH, "spatial hash");
+    failed |= test_world(BROADPHASE_AABB_TREE, "aabb tree");
+    failed |= test_world(BROADPHASE_SWEEP_AND_PRUNE, "sweep and prune");
+
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
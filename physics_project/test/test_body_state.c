@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include "../world.h"
+
+#define N_BODIES 37
+
+float random_range(float min, float max)
+{
+    return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+bool close_to(float a, float b)
+{
+    return fabsf(a - b) <= 1e-4f * (1.0f + fabsf(a));
+}
+
+// The SIMD integrators against body_integrate_forces and body_integrate_velocities on the
+// same bodies, a mix of moving, static and sleeping ones. 37 bodies leave a tail past the
+// last full 4 or 8 lanes.
+int main()
+{
+    Body scalar[N_BODIES];
+    Body simd[N_BODIES];
+
+    srand(7);
+    for (int i = 0; i < N_BODIES; i++)
+    {
+        float mass = (i % 5 == 0) ? 0.0f : random_range(0.5f, 4.0f);
+        float x = random_range(0, 1000);
+        float y = random_range(0, 1000);
+        Shape box = box_create(random_range(10, 50), random_range(10, 50));
+
+        scalar[i] = body_create(box, x, y, mass);
+        scalar[i].velocity = (Vec2){.x = random_range(-200, 200), .y = random_range(-200, 200)};
+        scalar[i].omega = random_range(-20, 20);
+        scalar[i].theta = random_range(0, 2.0f * M_PI);
+        scalar[i].force = (Vec2){.x = random_range(-500, 500), .y = random_range(-500, 500)};
+        scalar[i].torque = random_range(-5000, 5000);
+        scalar[i].is_awake = (i % 7 != 3);
+
+        simd[i] = scalar[i];
+    }
+
+    float delta_time = 1.0f / 60.0f;
+    for (int i = 0; i < N_BODIES; i++)
+    {
+        if (scalar[i].is_awake)
+        {
+            body_integrate_forces(&scalar[i], delta_time);
+            body_integrate_velocities(&scalar[i], delta_time);
+        }
+    }
+
+    BodyState state;
+    body_state_create(&state);
+    body_state_resize(&state, N_BODIES);
+    body_state_load_forces(&state, simd, 0, N_BODIES);
+    body_state_integrate_forces(&state, 0, N_BODIES, delta_time);
+    body_state_store_velocities(&state, simd, 0, N_BODIES);
+    body_state_load_velocities(&state, simd, 0, N_BODIES);
+    body_state_integrate_velocities(&state, 0, N_BODIES, delta_time);
+    body_state_store_positions(&state, simd, 0, N_BODIES);
+    body_state_destroy(&state);
+
+    int failed = 0;
+    float max_error = 0;
+    for (int i = 0; i < N_BODIES; i++)
+    {
+        Body *a = &scalar[i];
+        Body *b = &simd[i];
+        bool ok = close_to(a->position.x, b->position.x) && close_to(a->position.y, b->position.y) &&
+                  close_to(a->velocity.x, b->velocity.x) && close_to(a->velocity.y, b->velocity.y) &&
+                  close_to(a->omega, b->omega) && a->force.x == b->force.x && a->torque == b->torque;
+        // theta wraps around, compare on the circle
+        float dtheta = fabsf(a->theta - b->theta);
+        dtheta = fminf(dtheta, fabs(dtheta - 2.0f * M_PI));
+        ok = ok && dtheta < 1e-4f;
+
+        PolygonVertices pa, pb;
+        shape_global_vertices(&a->shape, a->position, a->theta, &pa);
+        shape_global_vertices(&b->shape, b->position, b->theta, &pb);
+        for (unsigned int v = 0; v < pa.n_vertices; v++)
+        {
+            ok = ok && close_to(pa.vertices[v].x, pb.vertices[v].x) && close_to(pa.vertices[v].y, pb.vertices[v].y);
+            max_error = fmaxf(max_error, vec2_norm(vec2_sub(pa.vertices[v], pb.vertices[v])));
+        }
+
+        if (!ok)
+        {
+            printf("FAIL: body %d (mass %.2f, awake %d) differs\n", i, a->mass, a->is_awake);
+            failed = 1;
+        }
+    }
+
+    printf("%d bodies, largest vertex difference %g\n", N_BODIES, max_error);
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
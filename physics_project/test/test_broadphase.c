@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include "../body_pool.h"
+#include "../broadphase.h"
+
+unsigned int rng_state = 12345;
+
+float random_range(float lo, float hi)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return lo + (hi - lo) * (float)(rng_state >> 8) / (float)(1u << 24);
+}
+
+void add_random_body(BodyPool *bodies, float world_size)
+{
+    Body b;
+    float x = random_range(0, world_size);
+    float y = random_range(0, world_size);
+
+    if (random_range(0, 1) < 0.5)
+    {
+        b = body_create(circle_create(random_range(5, 30)), x, y, 1.0);
+    }
+    else
+    {
+        b = body_create(box_create(random_range(10, 60), random_range(10, 60)), x, y, 1.0);
+        b.theta = random_range(0, 2.0 * M_PI);
+    }
+    body_pool_add(bodies, b);
+}
+
+int compare_pairs(Broadphase *expected, Broadphase *bp, const char *name)
+{
+    printf("%s: %u pairs, %lu tested\n", name, bp->n_pairs, bp->n_pairs_tested);
+
+    if (expected->n_pairs != bp->n_pairs)
+    {
+        printf("%s: expected %u pairs\n", name, expected->n_pairs);
+        return 1;
+    }
+    for (unsigned int i = 0; i < expected->n_pairs; i++)
+    {
+        if (expected->pairs[i].a != bp->pairs[i].a || expected->pairs[i].b != bp->pairs[i].b)
+        {
+            printf("%s: pair %u differs: (%u, %u) != (%u, %u)\n", name, i, expected->pairs[i].a, expected->pairs[i].b, bp->pairs[i].a, bp->pairs[i].b);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Runs a few frames of moving bodies through one broadphase, checking every frame against
+// brute force. Bodies remember their proxy, so each broadphase gets its own copy of the scene.
+int run(BroadphaseType type, unsigned int sap_axes, const char *name)
+{
+    rng_state = 12345;
+    BodyPool bodies;
+    body_pool_create(&bodies);
+    float world_size = 2000;
+
+    for (unsigned int i = 0; i < 2000; i++)
+    {
+        add_random_body(&bodies, world_size);
+    }
+
+    // huge static floor spanning every level of the hash
+    body_pool_add(&bodies, body_create(box_create(world_size, 50), world_size / 2, world_size / 2, 0.0));
+
+    Broadphase brute, bp;
+    broadphase_create(&brute, BROADPHASE_BRUTE_FORCE);
+    broadphase_create(&bp, type);
+    bp.sap.n_axes = sap_axes;
+
+    int failed = 0;
+    for (unsigned int frame = 0; frame < 5 && !failed; frame++)
+    {
+        broadphase_update(&brute, bodies.bodies, bodies.n_bodies);
+        broadphase_update(&bp, bodies.bodies, bodies.n_bodies);
+        failed |= compare_pairs(&brute, &bp, name);
+
+        // removed bodies leave their proxies behind and the last bodies move into their place
+        for (unsigned int i = 0; i < 10; i++)
+        {
+            Body *b = &bodies.bodies[(unsigned int)random_range(0, bodies.n_bodies - 1)];
+            broadphase_remove_body(&bp, b, bodies.bodies, bodies.n_bodies);
+            body_pool_remove(&bodies, b->handle);
+        }
+
+        // a few new bodies take the incremental insertion path of the sweep and prune
+        for (unsigned int i = 0; i < 10; i++)
+        {
+            add_random_body(&bodies, world_size);
+        }
+
+        // jitter everything, with a few large jumps so the tree has to reinsert
+        for (unsigned int i = 0; i < bodies.n_bodies; i++)
+        {
+            Body *b = &bodies.bodies[i];
+            if (b->inv_mass == 0)
+                continue;
+            float jump = (random_range(0, 1) < 0.1) ? 200 : 3;
+            b->velocity = (Vec2){.x = random_range(-jump, jump), .y = random_range(-jump, jump)};
+            b->position = vec2_add(b->position, b->velocity);
+        }
+    }
+
+    broadphase_destroy(&brute);
+    broadphase_destroy(&bp);
+    body_pool_destroy(&bodies);
+
+    return failed;
+}
+
+int main(void)
+{
+    int failed = 0;
+    failed |= run(BROADPHASE_SPATIAL_HASH, 2, "spatial hash");
+    failed |= run(BROADPHASE_AABB_TREE, 2, "aabb tree");
+    failed |= run(BROADPHASE_SWEEP_AND_PRUNE, 2, "sweep and prune");
+    failed |= run(BROADPHASE_SWEEP_AND_PRUNE, 1, "sweep and prune x");
+    printf("%s\n", failed ? "FAILED" : "OK");
+
+    return failed;
+}
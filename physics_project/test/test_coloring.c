@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include "test_util.h"
+
+// pyramid of boxes on a floor, returns the top box
+BodyHandle add_pyramid(World *w, unsigned int base)
+{
+    float size = 20;
+    float floor_y = 1000;
+    add_box(w, base * size, floor_y + 25, base * size * 4, 50, 0.0);
+
+    BodyHandle top = BODY_HANDLE_NULL;
+    for (unsigned int row = 0; row < base; row++)
+    {
+        for (unsigned int i = 0; i < base - row; i++)
+        {
+            float x = base * size / 2 + (row * 0.5f + i) * (size + 1.0f);
+            top = add_box(w, x, floor_y - size / 2 - row * (size + 0.5f), size, size, 1.0);
+        }
+    }
+    return top;
+}
+
+// Colors the contacts of the pyramid as they are now and checks that no two constraints of
+// a color touch the same dynamic body. The world frees its contacts at the end of a step,
+// so they are rebuilt here from the broadphase pairs.
+bool coloring_valid(World *w)
+{
+    Broadphase *bp = &w->broadphase;
+    List joints = list_create_empty();
+    PenetrationConstraint *contacts = (PenetrationConstraint *)malloc(2 * bp->n_pairs * sizeof(PenetrationConstraint));
+    unsigned int n_contacts = 0;
+    Islands is;
+    islands_create(&is);
+    islands_begin(&is, bp->n_bodies);
+
+    for (unsigned int p = 0; p < bp->n_pairs; p++)
+    {
+        Collision_Info info[10];
+        unsigned int n_collisions = 0;
+        Body *a = &bp->bodies[bp->pairs[p].a];
+        Body *b = &bp->bodies[bp->pairs[p].b];
+        if (!collision(a, b, info, &n_collisions))
+            continue;
+
+        for (unsigned int k = 0; k < n_collisions; k++)
+        {
+            penetration_constraint_create(&contacts[n_contacts++], info[k].a, info[k].b, info[k].start, info[k].end, info[k].normal);
+        }
+        if (a->inv_mass != 0.0 && b->inv_mass != 0.0)
+            islands_union(&is, a->world_index, b->world_index);
+    }
+    islands_end(&is, bp->bodies);
+    islands_sort_constraints(&is, &joints, contacts, n_contacts);
+
+    ConstraintColoring c;
+    coloring_create(&c);
+    coloring_build(&c, &is, is.n_awake_islands);
+
+    unsigned int *last_color = (unsigned int *)calloc(bp->n_bodies, sizeof(unsigned int));
+    bool valid = c.n_colors > 1;
+    for (unsigned int color = 0; color < c.n_colors; color++)
+    {
+        for (unsigned int i = c.contact_start[color]; i < c.contact_start[color + 1]; i++)
+        {
+            Body *bodies[2] = {c.contacts[i]->a, c.contacts[i]->b};
+            for (int k = 0; k < 2; k++)
+            {
+                if (bodies[k]->inv_mass == 0.0)
+                    continue;
+                valid = valid && last_color[bodies[k]->world_index] != color + 1;
+                last_color[bodies[k]->world_index] = color + 1;
+            }
+        }
+    }
+
+    free(last_color);
+    coloring_destroy(&c);
+    islands_destroy(&is);
+    free(contacts);
+    return valid;
+}
+
+int run(unsigned int n_threads, float *top_y)
+{
+    int failed = 0;
+
+    World w;
+    world_create(&w, -9.8f);
+    world_set_workers(&w, n_threads - 1);
+    w.allow_sleeping = false;
+    Body *top = world_get_body(&w, add_pyramid(&w, 20));
+    float start_y = top->position.y;
+
+    bool valid = true;
+    unsigned long max_colors = 0;
+    for (int frame = 0; frame < 300; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        if (frame % 50 == 0)
+            valid = valid && coloring_valid(&w);
+        if (w.stats.n_colors > max_colors)
+            max_colors = w.stats.n_colors;
+    }
+
+    printf("%u threads: %lu colored constraints in up to %lu colors, %lu overflow, top moved %.2f\n", n_threads, w.stats.n_colored_constraints, max_colors, w.stats.n_overflow_constraints, top->position.y - start_y);
+    if (w.stats.n_colored_constraints == 0)
+    {
+        printf("FAIL: expected the pyramid to be colored\n");
+        failed = 1;
+    }
+    if (!valid)
+    {
+        printf("FAIL: two constraints of a color share a body\n");
+        failed = 1;
+    }
+    if (fabsf(top->position.y - start_y) > 30.0f)
+    {
+        printf("FAIL: pyramid collapsed\n");
+        failed = 1;
+    }
+
+    *top_y = top->position.y;
+    world_destroy(&w);
+    return failed;
+}
+
+int main()
+{
+    int failed = 0;
+
+    float serial_y, parallel_y;
+    failed |= run(1, &serial_y);
+    failed |= run(4, &parallel_y);
+
+    // constraints of a color are independent, so splitting them over threads changes nothing
+    if (serial_y != parallel_y)
+    {
+        printf("FAIL: 1 and 4 threads differ\n");
+        failed = 1;
+    }
+
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
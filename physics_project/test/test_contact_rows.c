@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include "test_util.h"
+
+#define N_ROWS 37
+
+float random_range(float min, float max)
+{
+    return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+// The batches of contact_rows_solve against contact_rows_solve_lane on the same rows, each
+// row between its own two bodies, some of them static. 37 rows leave a tail past the last
+// full 4 or 8 lanes. Both compute the same operations, so they agree exactly, down to how far
+// the impulses moved.
+int test_batches()
+{
+    Body scalar[2 * N_ROWS];
+    Body simd[2 * N_ROWS];
+    PenetrationConstraint contacts[N_ROWS];
+
+    srand(11);
+    for (int i = 0; i < 2 * N_ROWS; i++)
+    {
+        float mass = (i % 5 == 0) ? 0.0f : random_range(0.5f, 4.0f);
+        scalar[i] = body_create(box_create(random_range(10, 50), random_range(10, 50)), random_range(0, 1000), random_range(0, 1000), mass);
+        scalar[i].velocity = (Vec2){.x = random_range(-200, 200), .y = random_range(-200, 200)};
+        scalar[i].omega = random_range(-5, 5);
+        scalar[i].friction = (i % 3 == 0) ? 0.0f : random_range(0.1f, 1.0f);
+        scalar[i].restitution = random_range(0, 0.5f);
+        scalar[i].world_index = i;
+    }
+
+    ContactRows rows;
+    contact_rows_create(&rows);
+    contact_rows_resize(&rows, N_ROWS);
+    for (int i = 0; i < N_ROWS; i++)
+    {
+        Body *a = &scalar[2 * i];
+        Body *b = &scalar[2 * i + 1];
+        Vec2 normal = vec2_unitvector((Vec2){.x = random_range(-1, 1), .y = random_range(-1, 1)});
+        Vec2 pa = vec2_add(a->position, (Vec2){.x = random_range(-10, 10), .y = random_range(-10, 10)});
+        Vec2 pb = vec2_add(pa, vec2_scale(normal, random_range(-3, 0)));
+        penetration_constraint_create(&contacts[i], a, b, pa, pb, normal);
+        contacts[i].cached_lambda.data[0][0] = random_range(0, 50);
+        penetration_constraint_pre_solve(&contacts[i], 1.0f / 60.0f, 0.2f);
+        contact_rows_set(&rows, i, &contacts[i]);
+    }
+    for (int i = 0; i < 2 * N_ROWS; i++)
+    {
+        simd[i] = scalar[i];
+    }
+
+    ContactRows reference;
+    contact_rows_create(&reference);
+    contact_rows_resize(&reference, N_ROWS);
+    for (int i = 0; i < N_ROWS; i++)
+    {
+        contact_rows_set(&reference, i, &contacts[i]);
+    }
+
+    SolverResidual residual, reference_residual;
+    for (int iter = 0; iter < 5; iter++)
+    {
+        residual = (SolverResidual){0};
+        reference_residual = (SolverResidual){0};
+        contact_rows_solve(&rows, simd, 0, N_ROWS, &residual);
+        for (int i = 0; i < N_ROWS; i++)
+        {
+            solver_residual_add(&reference_residual, contact_rows_solve_lane(&reference, scalar, i));
+        }
+    }
+
+    int failed = 0;
+    if (residual.n != N_ROWS || residual.max != reference_residual.max || residual.sum_squares != reference_residual.sum_squares)
+    {
+        printf("FAIL: batches report a different residual\n");
+        failed = 1;
+    }
+    for (int i = 0; i < N_ROWS; i++)
+    {
+        if (rows.lambda_n[i] != reference.lambda_n[i] || rows.lambda_t[i] != reference.lambda_t[i])
+        {
+            printf("FAIL: row %d accumulated different impulses\n", i);
+            failed = 1;
+        }
+    }
+    for (int i = 0; i < 2 * N_ROWS; i++)
+    {
+        Body *a = &scalar[i];
+        Body *b = &simd[i];
+        if (a->velocity.x != b->velocity.x || a->velocity.y != b->velocity.y || a->omega != b->omega)
+        {
+            printf("FAIL: body %d (mass %.2f) differs\n", i, a->mass);
+            failed = 1;
+        }
+    }
+    printf("%d rows: batches %s the scalar lanes\n", N_ROWS, failed ? "differ from" : "match");
+
+    contact_rows_destroy(&rows);
+    contact_rows_destroy(&reference);
+    return failed;
+}
+
+// positions of a pyramid big enough to be colored after a second, solved with solver
+void run_pyramid(ContactSolver solver, unsigned int n_threads, float *x, float *y, unsigned long *n_colored)
+{
+    World w;
+    world_create(&w, -9.8f);
+    world_set_workers(&w, n_threads - 1);
+    w.allow_sleeping = false;
+    w.contact_solver = solver;
+
+    unsigned int base = 20;
+    float size = 20;
+    add_box(&w, base * size, 1025, base * size * 4, 50, 0.0);
+    for (unsigned int row = 0; row < base; row++)
+    {
+        for (unsigned int i = 0; i < base - row; i++)
+        {
+            add_box(&w, base * size / 2 + (row * 0.5f + i) * (size + 1.0f), 1000 - size / 2 - row * (size + 0.5f), size, size, 1.0);
+        }
+    }
+
+    for (int frame = 0; frame < 60; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+    }
+    for (unsigned int i = 0; i < w.body_pool.n_bodies; i++)
+    {
+        x[i] = w.body_pool.bodies[i].position.x;
+        y[i] = w.body_pool.bodies[i].position.y;
+    }
+    *n_colored = w.stats.n_colored_constraints;
+    world_destroy(&w);
+}
+
+// the SIMD solver against the scalar reference on a whole pile, they only differ in rounding
+int test_world()
+{
+    static float x[3][256], y[3][256];
+    unsigned long n_colored[3];
+    run_pyramid(CONTACT_SOLVER_SCALAR, 1, x[0], y[0], &n_colored[0]);
+    run_pyramid(CONTACT_SOLVER_SIMD, 1, x[1], y[1], &n_colored[1]);
+    run_pyramid(CONTACT_SOLVER_SIMD, 4, x[2], y[2], &n_colored[2]);
+
+    float max_difference = 0;
+    bool same_threads = true;
+    for (unsigned int i = 0; i < 211; i++)
+    {
+        max_difference = fmaxf(max_difference, fmaxf(fabsf(x[0][i] - x[1][i]), fabsf(y[0][i] - y[1][i])));
+        same_threads = same_threads && x[1][i] == x[2][i] && y[1][i] == y[2][i];
+    }
+    printf("pyramid: %lu colored constraints, largest difference to the scalar solver %.4f\n", n_colored[1], max_difference);
+
+    int failed = 0;
+    if (n_colored[1] == 0)
+    {
+        printf("FAIL: expected the pyramid to be colored\n");
+        failed = 1;
+    }
+    if (max_difference > 0.5f)
+    {
+        printf("FAIL: SIMD solver strays from the scalar one\n");
+        failed = 1;
+    }
+    if (!same_threads)
+    {
+        printf("FAIL: SIMD solver depends on the number of threads\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+int main()
+{
+    int failed = test_batches();
+    failed |= test_world();
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include "../fixed_step.h"
+#include "test_util.h"
+
+BodyHandle add_scene(World *w)
+{
+    world_create(w, -9.8f);
+    Body floor = body_create(box_create(1000, 50), 500, 1025, 0.0);
+    floor.friction = 0.5;
+    world_add_body(w, floor);
+    BodyHandle top = BODY_HANDLE_NULL;
+    for (int i = 0; i < 6; i++)
+    {
+        Body b = body_create(box_create(40, 40), 500 + i * 3, 900 - i * 45, 1.0);
+        b.friction = 0.5;
+        b.restitution = 0.2;
+        b.omega = 0.3f * i;
+        top = world_add_body(w, b);
+    }
+    return top;
+}
+
+// runs the scene for two seconds of frames of the given lengths in turn
+Body run(float rate, const float *frame_times, unsigned int n_frame_times, FixedStep *f)
+{
+    World w;
+    BodyHandle top = add_scene(&w);
+    fixed_step_create(f, rate, 4);
+    double time = 0;
+    for (unsigned int frame = 0; time < 2.0; frame++)
+    {
+        float frame_time = frame_times[frame % n_frame_times];
+        fixed_step_advance(f, &w, frame_time);
+        time += frame_time;
+    }
+    Body b = *world_get_body(&w, top);
+    world_destroy(&w);
+    return b;
+}
+
+// the same steps are taken whatever the frames were, so the bodies end up the same
+int test_frame_rate()
+{
+    float steady[] = {1.0f / 60.0f};
+    float uneven[] = {0.004f, 0.03f, 0.011f, 0.021f, 0.0f, 0.017f};
+    float fast[] = {1.0f / 240.0f};
+    FixedStep f_steady, f_uneven, f_fast;
+    Body steady_body = run(60, steady, 1, &f_steady);
+    Body uneven_body = run(60, uneven, 6, &f_uneven);
+    Body fast_body = run(60, fast, 1, &f_fast);
+
+    printf("60 Hz: %lu, %lu and %lu steps, top at y %.3f, %.3f and %.3f\n", f_steady.n_steps, f_uneven.n_steps, f_fast.n_steps, steady_body.position.y,
+           uneven_body.position.y, fast_body.position.y);
+
+    int failed = check(f_steady.n_steps == 120 && f_fast.n_steps == 120, "steps do not add up to the frame time");
+    failed |= check(steady_body.position.y == fast_body.position.y && steady_body.theta == fast_body.theta, "frame rate changed the result");
+    failed |= check(f_uneven.alpha >= 0.0f && f_uneven.alpha < 1.0f, "alpha left [0, 1)");
+    return failed;
+}
+
+// a frame far too long runs max_steps and drops the rest instead of piling it up
+int test_catch_up()
+{
+    World w;
+    add_scene(&w);
+    FixedStep f;
+    fixed_step_create(&f, 120, 4);
+    unsigned int long_frame = fixed_step_advance(&f, &w, 1.0f);
+    unsigned int next_frame = fixed_step_advance(&f, &w, 1.0f / 120.0f);
+    printf("catch up: %u steps for a second long frame, %.3f s dropped, %u the frame after\n", long_frame, f.dropped_time, next_frame);
+    world_destroy(&w);
+
+    int failed = check(long_frame == 4, "long frame ran more than max_steps");
+    failed |= check(next_frame == 1, "dropped time was carried to the next frame");
+    failed |= check(fabs(f.dropped_time + f.accumulator + 5 * f.step_time - (1.0 + 1.0 / 120.0)) < 1e-4, "frame time went missing");
+    return failed;
+}
+
+// drawn between the steps, a body turns the short way across the wrap
+int test_interpolate()
+{
+    Body b = body_create(circle_create(10), 10, 20, 1.0);
+    b.previous_position = (Vec2){.x = 0, .y = 0};
+    b.previous_theta = 2.0f * M_PI - 0.1f;
+    b.theta = 0.1f;
+
+    Vec2 position;
+    float theta;
+    body_interpolate(&b, 0.25f, &position, &theta);
+    printf("interpolate: at 0.25 (%.2f, %.2f), angle %.3f\n", position.x, position.y, theta);
+
+    int failed = check(fabsf(position.x - 2.5f) < 1e-5f && fabsf(position.y - 5.0f) < 1e-5f, "position is not a quarter of the way");
+    failed |= check(fabs(theta - (2.0f * M_PI - 0.05f)) < 1e-5f, "angle took the long way round");
+    return failed;
+}
+
+int main()
+{
+    int failed = test_frame_rate();
+    failed |= test_catch_up();
+    failed |= test_interpolate();
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include "test_util.h"
+
+void step(World *w, int frames)
+{
+    for (int frame = 0; frame < frames; frame++)
+    {
+        world_update(w, 1.0f / 60.0f);
+    }
+}
+
+// piles of boxes and circles, stepped with the given number of solver threads
+void run_piles(unsigned int n_threads, Vec2 *positions, float *angles)
+{
+    World w;
+    world_create(&w, -9.8f);
+    world_set_workers(&w, n_threads - 1);
+    w.allow_sleeping = false;
+    add_box(&w, 1000, 1000, 2000, 50, 0.0);
+
+    BodyHandle bodies[160];
+    for (int i = 0; i < 160; i++)
+    {
+        float x = 60 + (i / 8) * 95 + (i % 2) * 3;
+        float y = 955 - (i % 8) * 41;
+        bodies[i] = add_box(&w, x, y, 40, 40, 1.0);
+    }
+
+    step(&w, 120);
+    for (int i = 0; i < 160; i++)
+    {
+        positions[i] = world_get_body(&w, bodies[i])->position;
+        angles[i] = world_get_body(&w, bodies[i])->theta;
+    }
+
+    world_destroy(&w);
+}
+
+int main()
+{
+    int failed = 0;
+
+    // islands are solved in parallel, the result has to match the serial solve exactly
+    Vec2 serial_positions[160], parallel_positions[160];
+    float serial_angles[160], parallel_angles[160];
+    run_piles(1, serial_positions, serial_angles);
+    run_piles(4, parallel_positions, parallel_angles);
+    bool same = memcmp(serial_positions, parallel_positions, sizeof(serial_positions)) == 0 && memcmp(serial_angles, parallel_angles, sizeof(serial_angles)) == 0;
+    printf("1 and 4 solver threads: %s\n", same ? "identical" : "different");
+    failed |= check(same, "parallel island solve differs from the serial one");
+
+    World w;
+    world_create(&w, -9.8f);
+    add_box(&w, 500, 1000, 1000, 50, 0.0);
+
+    // two piles far apart are two islands
+    BodyHandle left_top = BODY_HANDLE_NULL;
+    BodyHandle right_top = BODY_HANDLE_NULL;
+    for (int i = 0; i < 4; i++)
+    {
+        left_top = add_box(&w, 200, 955 - i * 40.5f, 40, 40, 1.0);
+        right_top = add_box(&w, 800, 955 - i * 40.5f, 40, 40, 1.0);
+    }
+
+    step(&w, 10);
+    printf("settling: %lu islands, %lu awake, %lu sleeping\n", w.stats.n_islands, w.stats.n_awake_bodies, w.stats.n_sleeping_bodies);
+    failed |= check(w.stats.n_islands == 2, "expected an island per pile");
+    failed |= check(w.stats.n_awake_bodies == 8, "expected every body awake while settling");
+
+    step(&w, 300);
+    printf("settled: %lu awake, %lu sleeping\n", w.stats.n_awake_bodies, w.stats.n_sleeping_bodies);
+    failed |= check(w.stats.n_sleeping_bodies == 8, "expected both piles asleep");
+    float left_y = world_get_body(&w, left_top)->position.y;
+
+    // sleeping bodies stay where they are
+    step(&w, 60);
+    failed |= check(world_get_body(&w, left_top)->position.y == left_y, "sleeping body moved");
+
+    // a force on the right pile wakes that island only
+    body_add_force(world_get_body(&w, right_top), (Vec2){.x = 100.0f, .y = 0.0f});
+    step(&w, 1);
+    printf("pushed right pile: %lu awake, %lu sleeping\n", w.stats.n_awake_bodies, w.stats.n_sleeping_bodies);
+    failed |= check(w.stats.n_awake_bodies == 4 && w.stats.n_sleeping_bodies == 4, "expected the right pile awake and the left asleep");
+
+    // a box dropped onto the left pile wakes it when it lands
+    add_box(&w, 200, 600, 40, 40, 1.0);
+    bool left_woken = false;
+    for (int frame = 0; frame < 120 && !left_woken; frame++)
+    {
+        step(&w, 1);
+        left_woken = world_get_body(&w, left_top)->is_awake;
+    }
+    printf("dropped a box on the left pile: %lu awake, %lu sleeping\n", w.stats.n_awake_bodies, w.stats.n_sleeping_bodies);
+    failed |= check(left_woken, "expected the left pile woken by the falling box");
+
+    step(&w, 600);
+    printf("settled again: %lu islands, %lu awake, %lu sleeping\n", w.stats.n_islands, w.stats.n_awake_bodies, w.stats.n_sleeping_bodies);
+    failed |= check(w.stats.n_sleeping_bodies == 9, "expected everything asleep again");
+    failed |= check(fabsf(world_get_body(&w, left_top)->position.y - (955 - 3 * 40)) < 5.0f, "left pile did not stay up");
+
+    world_destroy(&w);
+
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
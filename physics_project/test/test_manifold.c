@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include "test_util.h"
+
+int main()
+{
+    int failed = 0;
+
+    World w;
+    world_create(&w, -9.8f);
+    w.allow_sleeping = false;
+    add_box(&w, 500, 1000, 1000, 50, 0.0);
+    BodyHandle top_handle = BODY_HANDLE_NULL;
+    for (int i = 0; i < 5; i++)
+    {
+        top_handle = add_box(&w, 500, 955 - i * 40.5f, 40, 40, 1.0);
+    }
+
+    for (int frame = 0; frame < 300; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+    }
+    Body *top = world_get_body(&w, top_handle);
+
+    // a resting stack keeps the same features in contact, so every contact is warm started
+    printf("resting stack: %lu manifolds, %lu/%lu contacts warm started, top at y %.2f\n", w.stats.n_manifolds, w.stats.n_warm_started_contacts, w.stats.n_contacts, top->position.y);
+    if (w.stats.n_manifolds != 5 || w.stats.n_contacts != 10 || w.stats.n_warm_started_contacts != w.stats.n_contacts)
+    {
+        printf("FAIL: expected 5 manifolds with 10 warm started contacts\n");
+        failed = 1;
+    }
+    if (fabsf(top->position.y - (955 - 4 * 40)) > 5.0f)
+    {
+        printf("FAIL: stack did not stay up\n");
+        failed = 1;
+    }
+
+    // moving the top box away ends its contact, its manifold is evicted
+    top->position.y -= 200;
+    world_update(&w, 1.0f / 60.0f);
+    printf("top removed: %u manifolds cached\n", manifold_cache_size(&w.manifolds));
+    if (manifold_cache_size(&w.manifolds) != 4)
+    {
+        printf("FAIL: expected 4 manifolds after the top box left\n");
+        failed = 1;
+    }
+
+    world_destroy(&w);
+
+    // without friction the tangent row of a contact is empty, the normal is solved alone
+    world_create(&w, -9.8f);
+    w.allow_sleeping = false;
+    BodyHandle floor_handle = add_box(&w, 500, 1000, 1000, 50, 0.0);
+    BodyHandle slider_handle = add_box(&w, 500, 955, 40, 40, 1.0);
+    world_get_body(&w, slider_handle)->friction = 0.0;
+    world_get_body(&w, floor_handle)->friction = 0.0;
+    for (int frame = 0; frame < 120; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+    }
+    Body *slider = world_get_body(&w, slider_handle);
+    printf("frictionless box at y %.2f\n", slider->position.y);
+    if (!isfinite(slider->position.y) || fabsf(slider->position.y - 955) > 5.0f)
+    {
+        printf("FAIL: frictionless box did not rest on the floor\n");
+        failed = 1;
+    }
+    world_destroy(&w);
+
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
@@ -1,109 +1,176 @@
+// gcc -std=c99 -O2 -march=native -pthread test_matmn.c -lm -o test_matmn
+// ./test_matmn [largest size]
+// checks the MatMN kernels against plain loops, then reports GFLOP/s of each across sizes
+
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "../matmn.h"
+#include "../timer.h"
+#include "test_util.h"
+
+void fill_random(MatMN *a)
+{
+    for (unsigned int i = 0; i < a->m * a->n; i++)
+    {
+        a->data[i] = (float)(rand() % 2000 - 1000) / 100.0f;
+    }
+}
 
-void matmn_print(MatMN *a)
+// the triple loop matmn_mul used to be
+void mul_reference(MatMN *a, MatMN *b, MatMN *z)
 {
     for (unsigned int i = 0; i < a->m; i++)
     {
-        for (unsigned int j = 0; j < a->n; j++)
+        for (unsigned int j = 0; j < b->n; j++)
         {
-            printf("%.3f ", MATMN_AT(*a, i, j));
+            MATMN_AT(*z, i, j) = 0;
+            for (unsigned int k = 0; k < a->n; k++)
+                MATMN_AT(*z, i, j) += MATMN_AT(*a, i, k) * MATMN_AT(*b, k, j);
         }
-        printf("\n");
     }
 }
 
-int main(void)
+// sizes that leave rows, columns and k past the last register and block
+int test_kernels()
 {
-    // MatMN a = matmn_create(3, 4);
-    // for (unsigned int i = 0; i < a.m; i++)
-    // {
-    //     for (unsigned int j = 0; j < a.n; j++)
-    //     {
-    //         MATMN_AT(a, i, j) = i + 0.1 * j;
-    //     }
-    // }
-    // matmn_print(&a);
-    // printf("\n");
-
-    // MatMN a_row = matmn_row(&a, 1);
-    // matmn_print(&a_row);
-    // printf("\n");
-
-    // MatMN a_col = matmn_col(&a, 1);
-    // matmn_print(&a_col);
-    // printf("\n");
-
-    // MatMN a_T = matmn_create(a.n, a.m);
-    // matmn_transpose(&a, &a_T);
-    // matmn_print(&a_T);
-    // printf("\n");
-    // matmn_destroy(&a_T);
-
-    // MatMN a_scale = matmn_create_zero_like(&a);
-    // matmn_scale(&a, 2.0, &a_scale);
-    // matmn_print(&a_scale);
-    // printf("\n");
-    // matmn_destroy(&a_scale);
-
-    // MatMN b = matmn_create(4, 3);
-    // for (unsigned int i = 0; i < b.m; i++)
-    // {
-    //     for (unsigned int j = 0; j < b.n; j++)
-    //     {
-    //         MATMN_AT(b, i, j) = i + 0.1 * j;
-    //     }
-    // }
-    // MatMN a_mul_b = matmn_create(a.m, b.n);
-    // matmn_mul(&a, &b, &a_mul_b);
-    // matmn_print(&a_mul_b);
-    // printf("\n");
-    // matmn_destroy(&b);
-    // matmn_destroy(&a_mul_b);
-
-    // matmn_destroy(&a);
-
-    MatMN lhs = matmn_create(4, 4);
-    MATMN_AT(lhs, 0, 0) = 10.0;
-    MATMN_AT(lhs, 0, 1) = -1.0;
-    MATMN_AT(lhs, 0, 2) = 2.0;
-    MATMN_AT(lhs, 0, 3) = 0.0;
-    MATMN_AT(lhs, 1, 0) = -1.0;
-    MATMN_AT(lhs, 1, 1) = 11.0;
-    MATMN_AT(lhs, 1, 2) = -1.0;
-    MATMN_AT(lhs, 1, 3) = 3.0;
-    MATMN_AT(lhs, 2, 0) = 2.0;
-    MATMN_AT(lhs, 2, 1) = -1.0;
-    MATMN_AT(lhs, 2, 2) = 10.0;
-    MATMN_AT(lhs, 2, 3) = -1.0;
-    MATMN_AT(lhs, 3, 0) = 0.0;
-    MATMN_AT(lhs, 3, 1) = 3.0;
-    MATMN_AT(lhs, 3, 2) = -1.0;
-    MATMN_AT(lhs, 3, 3) = 8.0;
-    printf("lhs\n");
-    matmn_print(&lhs);
-    printf("\n");
-
-    MatMN rhs = matmn_create(4, 1);
-    MATMN_AT(rhs, 0, 0) = 6.0;
-    MATMN_AT(rhs, 1, 0) = 25.0;
-    MATMN_AT(rhs, 2, 0) = -11.0;
-    MATMN_AT(rhs, 3, 0) = 15.0;
-    printf("rhs\n");
-    matmn_print(&rhs);
-    printf("\n");
-
-    MatMN sol = matmn_create_zero_like(&rhs);
-    matmn_solve_gauss_seidel(&lhs, &rhs, &sol);
-    printf("sol \n");
-    matmn_print(&sol);
-    printf("\n");
-
-    // MatMN a_mul_sol = matmn_create(a.m, sol.n);
-    // matmn_mul(&a, &sol, &a_mul_sol);
-    // printf("a * sol\n");
-    // matmn_print(&a_mul_sol);
-    // printf("\n");
-
-    return 0;
-}
\ No newline at end of file
+    unsigned int sizes[][3] = {{1, 1, 1}, {3, 5, 2}, {4, 8, 4}, {7, 13, 9}, {17, 70, 33}, {67, 130, 129}, {130, 3, 200}};
+    int failed = 0;
+
+    srand(5);
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        unsigned int m = sizes[s][0], k = sizes[s][1], n = sizes[s][2];
+        MatMN a = matmn_create(m, k, MEM_HEAP);
+        MatMN b = matmn_create(k, n, MEM_HEAP);
+        MatMN z = matmn_create(m, n, MEM_HEAP);
+        MatMN expected = matmn_create(m, n, MEM_HEAP);
+        MatMN a_t = matmn_create(k, m, MEM_HEAP);
+        MatMN a_sum = matmn_create(m, k, MEM_HEAP);
+        fill_random(&a);
+        fill_random(&b);
+        failed |= check((uintptr_t)a.data % MATMN_ALIGN == 0, "matmn_create is not aligned");
+
+        mul_reference(&a, &b, &expected);
+        matmn_mul(&a, &b, &z);
+        bool same = true;
+        for (unsigned int i = 0; i < m * n; i++)
+        {
+            same = same && fabsf(z.data[i] - expected.data[i]) <= 1e-4f * (1.0f + fabsf(expected.data[i]));
+        }
+        failed |= check(same, "matmn_mul differs from the triple loop");
+
+        matmn_transpose(&a, &a_t);
+        same = true;
+        for (unsigned int i = 0; i < m; i++)
+        {
+            for (unsigned int j = 0; j < k; j++)
+            {
+                same = same && MATMN_AT(a_t, j, i) == MATMN_AT(a, i, j);
+            }
+        }
+        failed |= check(same, "matmn_transpose misplaced an entry");
+
+        matmn_add(&a, &a, &a_sum);
+        matmn_sub(&a_sum, &a, &a_sum);
+        matmn_scale(&a_sum, 0.5f, &a_sum);
+        same = true;
+        for (unsigned int i = 0; i < m * k; i++)
+        {
+            same = same && a_sum.data[i] == 0.5f * a.data[i];
+        }
+        failed |= check(same, "matmn_add, matmn_sub or matmn_scale is off");
+
+        matmn_destroy(&a);
+        matmn_destroy(&b);
+        matmn_destroy(&z);
+        matmn_destroy(&expected);
+        matmn_destroy(&a_t);
+        matmn_destroy(&a_sum);
+    }
+    printf("kernels: %s\n", failed ? "differ from the plain loops" : "match the plain loops");
+    return failed;
+}
+
+// a diagonally dominant system with the solution (1, 2, -1, 1)
+int test_gauss_seidel()
+{
+    float lhs_data[16] = {10, -1, 2, 0, -1, 11, -1, 3, 2, -1, 10, -1, 0, 3, -1, 8};
+    float rhs_data[4] = {6, 25, -11, 15};
+    MatMN lhs = {4, 4, lhs_data};
+    MatMN rhs = {4, 1, rhs_data};
+    MatMN sol = matmn_create_zero_like(&rhs, MEM_HEAP);
+    matmn_solve_gauss_seidel(&lhs, &rhs, &sol, 20);
+    printf("gauss-seidel: x = (%.4f, %.4f, %.4f, %.4f)\n", sol.data[0], sol.data[1], sol.data[2], sol.data[3]);
+
+    float expected[4] = {1, 2, -1, 1};
+    bool same = true;
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        same = same && fabsf(sol.data[i] - expected[i]) < 1e-4f;
+    }
+    matmn_destroy(&sol);
+    return check(same, "gauss-seidel did not converge");
+}
+
+// runs CODE over and over for 0.1 s, SECONDS is the time of one run
+#define BENCH_TIME(SECONDS, CODE)                       \
+    do                                                  \
+    {                                                   \
+        unsigned int runs = 0;                          \
+        double start = timer_now();                     \
+        do                                              \
+        {                                               \
+            CODE;                                       \
+            runs++;                                     \
+        } while (timer_now() - start < 0.1);            \
+        SECONDS = (timer_now() - start) / runs;         \
+    } while (0)
+
+void bench(unsigned int largest)
+{
+    printf("%8s %14s %12s %16s %22s\n", "size", "naive GFLOP/s", "mul GFLOP/s", "transpose GB/s", "gauss-seidel GFLOP/s");
+    for (unsigned int n = 16; n <= largest; n *= 2)
+    {
+        MatMN a = matmn_create(n, n, MEM_HEAP);
+        MatMN b = matmn_create(n, n, MEM_HEAP);
+        MatMN z = matmn_create(n, n, MEM_HEAP);
+        MatMN rhs = matmn_create(n, 1, MEM_HEAP);
+        MatMN x = matmn_create(n, 1, MEM_HEAP);
+        fill_random(&a);
+        fill_random(&b);
+        fill_random(&rhs);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            MATMN_AT(a, i, i) = 2.0f * n * 10.0f;
+        }
+
+        double naive, mul, transpose, gauss_seidel;
+        BENCH_TIME(naive, mul_reference(&a, &b, &z));
+        BENCH_TIME(mul, matmn_mul(&a, &b, &z));
+        BENCH_TIME(transpose, matmn_transpose(&a, &z));
+        BENCH_TIME(gauss_seidel, matmn_solve_gauss_seidel(&a, &rhs, &x, 10));
+
+        double flops = 2.0 * n * n * n;
+        printf("%8u %14.2f %12.2f %16.2f %22.2f\n", n, 1e-9 * flops / naive, 1e-9 * flops / mul, 1e-9 * 2.0 * n * n * sizeof(float) / transpose,
+               1e-9 * 10 * 2.0 * n * n / gauss_seidel);
+
+        matmn_destroy(&a);
+        matmn_destroy(&b);
+        matmn_destroy(&z);
+        matmn_destroy(&rhs);
+        matmn_destroy(&x);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int largest = (argc > 1) ? (unsigned int)atoi(argv[1]) : 512;
+
+    int failed = test_kernels();
+    failed |= test_gauss_seidel();
+    if (!failed)
+        bench(largest);
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
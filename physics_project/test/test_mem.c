@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include "test_util.h"
+
+// nested scopes keep their allocations, popping a mark frees only what came after it, and
+// allocations past the first block chain on without moving earlier ones
+int test_scratch()
+{
+    int failed = 0;
+    mem_scratch_pool_destroy(mem_scratch_pool);
+
+    ScratchMark outer = mem_scratch_push();
+    float *kept = (float *)mem_calloc(4, sizeof(float), MEM_SCRATCH_POOL);
+    kept[3] = 7.0f;
+
+    ScratchMark inner = mem_scratch_push();
+    bool aligned = true;
+    for (unsigned int i = 0; i < 1000; i++)
+    {
+        char *p = (char *)mem_scratch_alloc(1 + i % 300, 64);
+        aligned = aligned && (uintptr_t)p % 64 == 0;
+        p[0] = 1;
+    }
+    char *big = (char *)mem_calloc(1 << 20, 1, MEM_SCRATCH_POOL);
+    big[(1 << 20) - 1] = 1;
+    size_t high_water = mem_scratch_pool->used;
+    mem_scratch_pop(inner);
+
+    failed |= check(aligned, "scratch allocation not aligned");
+    failed |= check(kept[3] == 7.0f, "inner scope clobbered the outer one");
+    failed |= check(mem_scratch_pool->first->next != NULL, "expected the pool to chain blocks");
+
+    // the same scope again reuses the blocks
+    unsigned long calls = mem_log.heap_memory_calls;
+    inner = mem_scratch_push();
+    mem_calloc(1 << 20, 1, MEM_SCRATCH_POOL);
+    mem_scratch_pop(inner);
+    failed |= check(mem_log.heap_memory_calls == calls, "reused scope went to the heap");
+
+    float *after = (float *)mem_calloc(4, sizeof(float), MEM_SCRATCH_POOL);
+    failed |= check(after == kept + 4, "pop did not return to the mark");
+    mem_scratch_pop(outer);
+    failed |= check(mem_scratch_pool->used == 0, "pool not empty after the outer pop");
+    failed |= check(mem_scratch_take_high_water(mem_scratch_pool) == high_water, "high water mark lost");
+    failed |= check(mem_scratch_take_high_water(mem_scratch_pool) == 0, "high water mark not reset");
+    printf("scratch: %zu bytes high water\n", high_water);
+
+    mem_scratch_pool_destroy(mem_scratch_pool);
+    return failed;
+}
+
+// every job fills a scratch array of its own thread's pool and checks nothing else wrote it
+void scratch_job(void *data, unsigned int item, unsigned int thread)
+{
+    int *failed = (int *)data;
+    (void)thread;
+    ScratchMark mark = mem_scratch_push();
+    unsigned int n = 1000 + item * 10;
+    unsigned int *values = (unsigned int *)mem_calloc(n, sizeof(unsigned int), MEM_SCRATCH_POOL);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        values[i] = item;
+    }
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (values[i] != item)
+            __atomic_store_n(&failed[item], 1, __ATOMIC_RELAXED);
+    }
+    mem_scratch_pop(mark);
+}
+
+int test_scratch_threads()
+{
+    JobSystem js;
+    job_system_create(&js, 3);
+    int failed[256] = {0};
+    job_parallel_for(&js, scratch_job, failed, 256, 1);
+    job_system_destroy(&js);
+
+    int any = 0;
+    for (unsigned int i = 0; i < 256; i++)
+    {
+        any |= failed[i];
+    }
+    return check(!any, "scratch memory shared between threads");
+}
+
+// once the buffers of the world have grown to fit the scene, a step allocates nothing
+int test_world(unsigned int n_workers)
+{
+    World w;
+    world_create(&w, -9.8f);
+    world_set_workers(&w, n_workers);
+    w.allow_sleeping = false;
+    for (unsigned int r = 0; r < 4; r++)
+    {
+        float floor_y = 300 + r * 300;
+        add_box(&w, 1000, floor_y + 25, 2000, 50, 0.0);
+        for (unsigned int p = 0; p < 30; p++)
+        {
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                add_box(&w, 40 + p * 60 + (i % 2) * 2, floor_y - 20 - i * 40.5f, 40, 40, 1.0);
+            }
+        }
+    }
+
+    for (unsigned int frame = 0; frame < 60; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+    }
+    mem_log.heap_memory_calls = 0;
+    for (unsigned int frame = 0; frame < 60; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+    }
+    printf("%u workers: %lu contacts, %lu heap calls in 60 steps, %zu bytes of scratch\n", n_workers, w.stats.n_contacts, mem_log.heap_memory_calls, w.stats.scratch_high_water);
+    int failed = check(w.stats.n_contacts > 0, "expected contacts");
+    failed |= check(mem_log.heap_memory_calls == 0, "steady state steps allocated");
+    failed |= check(w.stats.scratch_high_water == 0, "constraint solving used scratch");
+
+    world_destroy(&w);
+    return failed;
+}
+
+int main()
+{
+    int failed = test_scratch();
+    failed |= test_scratch_threads();
+    failed |= test_world(0);
+    failed |= test_world(3);
+
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
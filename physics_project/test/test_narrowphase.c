@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include "test_util.h"
+
+// buffers filled out of order by several threads merge into pair order
+bool merge_sorted()
+{
+    Narrowphase np;
+    narrowphase_create(&np);
+    narrowphase_begin(&np, 3);
+
+    unsigned int n = 1000;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        unsigned int pair = (i * 617) % n;
+        narrowphase_push(&np, pair % 3, pair)->n_points = pair % 3;
+    }
+    narrowphase_merge(&np);
+
+    bool sorted = np.n_results == n;
+    for (unsigned int r = 0; sorted && r < np.n_results; r++)
+    {
+        sorted = np.results[r].pair == r && np.results[r].n_points == r % 3;
+    }
+
+    narrowphase_destroy(&np);
+    return sorted;
+}
+
+// Steps rows of piles and returns a checksum of the contacts and the bodies
+float run(unsigned int n_workers, unsigned int *n_contacts, bool *sorted)
+{
+    World w;
+    world_create(&w, -9.8f);
+    world_set_workers(&w, n_workers);
+    w.allow_sleeping = false;
+
+    for (unsigned int r = 0; r < 4; r++)
+    {
+        float floor_y = 300 + r * 300;
+        add_box(&w, 1000, floor_y + 25, 2000, 50, 0.0);
+        for (unsigned int p = 0; p < 30; p++)
+        {
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                add_box(&w, 40 + p * 60 + (i % 2) * 2, floor_y - 20 - i * 40.5f, 40, 40, 1.0);
+            }
+        }
+    }
+
+    for (unsigned int frame = 0; frame < 60; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+    }
+
+    *sorted = true;
+    for (unsigned int r = 1; r < w.narrowphase.n_results; r++)
+    {
+        *sorted = *sorted && w.narrowphase.results[r - 1].pair < w.narrowphase.results[r].pair;
+    }
+    *n_contacts = w.stats.n_contacts;
+
+    float checksum = 0;
+    for (unsigned int m = 0; m < w.manifolds.map.n_keys; m++)
+    {
+        for (unsigned int k = 0; k < w.manifolds.manifolds[m].n_points; k++)
+        {
+            checksum += w.manifolds.manifolds[m].points[k].normal_impulse;
+        }
+    }
+    for (unsigned int i = 0; i < w.body_pool.n_bodies; i++)
+    {
+        Body *b = &w.body_pool.bodies[i];
+        checksum += b->position.x + b->position.y + b->theta;
+    }
+
+    world_destroy(&w);
+    return checksum;
+}
+
+// a circle sunk inside a polygon is pushed out through the nearest edge
+bool circle_inside_polygon()
+{
+    Body box = body_create(box_create(100, 100), 0, 0, 1.0);
+    Body ball = body_create(circle_create(10), 5, 40, 1.0);
+    Collision_Info info[2];
+    unsigned int n_collisions = 0;
+    bool hit = collision(&box, &ball, info, &n_collisions);
+
+    printf("circle inside a box: normal (%.3f, %.3f), depth %.3f\n", info[0].normal.x, info[0].normal.y, info[0].depth);
+    return hit && n_collisions == 1 && fabsf(info[0].normal.x) < 1e-5f && fabsf(info[0].normal.y - 1.0f) < 1e-5f && fabsf(info[0].depth - 20.0f) < 1e-4f;
+}
+
+int main()
+{
+    bool ok = merge_sorted();
+    printf("merge of 3 buffers sorted by pair: %s\n", ok ? "yes" : "no");
+    ok = circle_inside_polygon() && ok;
+
+    unsigned int n_contacts[2];
+    bool sorted[2];
+    float checksum[2] = {run(0, &n_contacts[0], &sorted[0]), run(3, &n_contacts[1], &sorted[1])};
+    for (int i = 0; i < 2; i++)
+    {
+        printf("%d workers: %u contacts, checksum %.4f\n", 3 * i, n_contacts[i], checksum[i]);
+        ok = ok && sorted[i] && n_contacts[i] > 0;
+    }
+    ok = ok && n_contacts[0] == n_contacts[1] && checksum[0] == checksum[1];
+
+    printf("%s\n", ok ? "OK" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include "test_util.h"
+
+// a stack on its own island, returns how far the top box slid sideways at most and how fast it
+// moved on average over the last second
+float run_stack(SolverMode mode, unsigned int height, float *speed)
+{
+    World w;
+    world_create(&w, -9.8f);
+    w.allow_sleeping = false;
+    w.solver_mode = mode;
+    w.constraint_iterations = 4 * w.substeps;
+    add_box(&w, 500, 1025, 1000, 50, 0.0);
+    BodyHandle top = BODY_HANDLE_NULL;
+    for (unsigned int i = 0; i < height; i++)
+    {
+        top = add_box(&w, 500, 980 - i * 40.5f, 40, 40, 1.0);
+    }
+
+    float slide = 0;
+    *speed = 0;
+    for (int frame = 0; frame < 300; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        Body *b = world_get_body(&w, top);
+        slide = MAX(slide, fabsf(b->position.x - 500));
+        if (frame >= 240)
+            *speed += vec2_norm(b->velocity) / 60;
+    }
+    world_destroy(&w);
+    return slide;
+}
+
+// a colored pyramid, returns where its top ends up
+float run_pyramid(unsigned int n_threads, WorldStats *stats)
+{
+    World w;
+    world_create(&w, -9.8f);
+    world_set_workers(&w, n_threads - 1);
+    w.allow_sleeping = false;
+    w.solver_mode = SOLVER_MODE_SOFT_STEP;
+    unsigned int base = 20;
+    float size = 20;
+    BodyHandle top = BODY_HANDLE_NULL;
+    add_box(&w, base * size, 1025, base * size * 4, 50, 0.0);
+    for (unsigned int row = 0; row < base; row++)
+    {
+        for (unsigned int i = 0; i < base - row; i++)
+        {
+            top = add_box(&w, base * size / 2 + (row * 0.5f + i) * (size + 1.0f), 1000 - size / 2 - row * (size + 0.5f), size, size, 1.0);
+        }
+    }
+
+    for (int frame = 0; frame < 120; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+    }
+    float y = world_get_body(&w, top)->position.y;
+    *stats = w.stats;
+    world_destroy(&w);
+    return y;
+}
+
+// A soft substep costs about as much as four Baumgarte iterations (bench_soft_step), so the
+// soft step is held against Baumgarte with that many. It is not stiller everywhere: at 12
+// boxes its top slides 0.97 px against 0.73, at 16 it moves 4.06 px/s against 3.86.
+// STACK_TOLERANCE (px and px/s) lets it lose by that little, a stack that topples is off by
+// tens of pixels.
+#define STACK_TOLERANCE 0.5f
+
+int test_stacks()
+{
+    int failed = 0;
+    for (unsigned int height = 8; height <= 16; height += 4)
+    {
+        float baumgarte_speed, soft_speed;
+        float baumgarte = run_stack(SOLVER_MODE_BAUMGARTE, height, &baumgarte_speed);
+        float soft = run_stack(SOLVER_MODE_SOFT_STEP, height, &soft_speed);
+        printf("stack of %u: top slid %.2f px (speed %.2f) with baumgarte, %.2f px (speed %.2f) soft stepped\n", height, baumgarte, baumgarte_speed, soft, soft_speed);
+
+        failed |= check(soft <= baumgarte + STACK_TOLERANCE, "soft stepped stack slides more than with baumgarte");
+        failed |= check(soft_speed <= baumgarte_speed + STACK_TOLERANCE, "soft stepped stack moves more than with baumgarte");
+    }
+    return failed;
+}
+
+int test_threads()
+{
+    WorldStats one, four;
+    float one_y = run_pyramid(1, &one);
+    float four_y = run_pyramid(4, &four);
+    printf("pyramid: %lu colored constraints, top at y %.2f on 1 thread, %.2f on 4, %lu substeps\n", one.n_colored_constraints, one_y, four_y, one.max_solver_iterations);
+
+    int failed = check(one.n_colored_constraints > 0, "pyramid was not colored");
+    failed |= check(one_y == four_y, "soft step depends on the number of threads");
+    return failed;
+}
+
+// how far the links of a chain of boxes hanging from a static one open on average while it swings
+float run_chain(SolverMode mode)
+{
+    World w;
+    world_create(&w, -9.8f);
+    w.allow_sleeping = false;
+    w.solver_mode = mode;
+    BodyHandle prev = add_box(&w, 500, 100, 20, 20, 0.0);
+    for (int i = 1; i <= 8; i++)
+    {
+        BodyHandle link = add_box(&w, 500 + i * 30, 100, 20, 20, 1.0);
+        world_add_joint(&w, prev, link, (Vec2){.x = 500 + i * 30 - 15, .y = 100});
+        prev = link;
+    }
+
+    float sum = 0;
+    for (int frame = 0; frame < 240; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        for (Node *n = w.joint_constraints.start; n != NULL; n = n->next)
+        {
+            JointConstraint *jc = (JointConstraint *)n->data;
+            Vec2 pa = body_local_to_global_space(jc->a, jc->a_local_anchor);
+            Vec2 pb = body_local_to_global_space(jc->b, jc->b_local_anchor);
+            sum += vec2_norm(vec2_sub(pb, pa));
+        }
+    }
+    world_destroy(&w);
+    return sum / (240 * 8);
+}
+
+int test_chain()
+{
+    float baumgarte = run_chain(SOLVER_MODE_BAUMGARTE);
+    float soft = run_chain(SOLVER_MODE_SOFT_STEP);
+    printf("chain: links open %.2f px with baumgarte, %.2f px soft stepped\n", baumgarte, soft);
+    return check(soft < 1.1f * baumgarte, "soft stepped joints are looser");
+}
+
+// a bouncy box dropped on the floor comes back up, the soft contact alone would not bounce
+int test_restitution()
+{
+    World w;
+    world_create(&w, -9.8f);
+    w.solver_mode = SOLVER_MODE_SOFT_STEP;
+    BodyHandle floor = add_box(&w, 500, 1025, 1000, 50, 0.0);
+    world_get_body(&w, floor)->restitution = 1.0;
+    Body b = body_create(box_create(40, 40), 500, 800, 1.0);
+    b.restitution = 0.8;
+    BodyHandle box = world_add_body(&w, b);
+
+    float fastest_down = 0, fastest_up = 0;
+    for (int frame = 0; frame < 60; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        float vy = world_get_body(&w, box)->velocity.y;
+        fastest_down = MAX(fastest_down, vy);
+        fastest_up = MAX(fastest_up, -vy);
+    }
+    printf("bounce: hit at %.2f px/s, back up at %.2f px/s\n", fastest_down, fastest_up);
+    world_destroy(&w);
+    return check(fastest_up > 0.5f * fastest_down, "restitution did not bounce");
+}
+
+int main()
+{
+    int failed = test_stacks();
+    failed |= test_threads();
+    failed |= test_chain();
+    failed |= test_restitution();
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include "test_util.h"
+
+// a pyramid big enough to be colored, returns the top box
+BodyHandle add_pyramid(World *w)
+{
+    unsigned int base = 20;
+    float size = 20;
+    BodyHandle top = BODY_HANDLE_NULL;
+    add_box(w, base * size, 1025, base * size * 4, 50, 0.0);
+    for (unsigned int row = 0; row < base; row++)
+    {
+        for (unsigned int i = 0; i < base - row; i++)
+        {
+            top = add_box(w, base * size / 2 + (row * 0.5f + i) * (size + 1.0f), 1000 - size / 2 - row * (size + 0.5f), size, size, 1.0);
+        }
+    }
+    return top;
+}
+
+// where the top of the pyramid ends up, and the iterations of the last step
+float run_pyramid(float tolerance, unsigned int max_iterations, unsigned int n_threads, bool global_solver, WorldStats *stats)
+{
+    World w;
+    world_create(&w, -9.8f);
+    world_set_workers(&w, n_threads - 1);
+    w.allow_sleeping = false;
+    w.global_solver = global_solver;
+    w.solver_tolerance = tolerance;
+    w.constraint_iterations = max_iterations;
+    w.gauss_seidel_iterations = max_iterations;
+    BodyHandle top = add_pyramid(&w);
+
+    for (int frame = 0; frame < 120; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+    }
+    float y = world_get_body(&w, top)->position.y;
+    *stats = w.stats;
+    world_destroy(&w);
+    return y;
+}
+
+// settled piles stop iterating early and stay where the fixed iterations put them
+int test_settled()
+{
+    WorldStats fixed, adaptive, adaptive_threads, global;
+    float fixed_y = run_pyramid(0.0f, 5, 1, false, &fixed);
+    float adaptive_y = run_pyramid(0.05f, 20, 1, false, &adaptive);
+    float adaptive_threads_y = run_pyramid(0.05f, 20, 4, false, &adaptive_threads);
+    float global_y = run_pyramid(0.05f, 20, 1, true, &global);
+
+    printf("fixed: %lu iterations, residual %.4f (rms %.4f), top at y %.2f\n", fixed.n_solver_iterations, fixed.solver_residual_max, fixed.solver_residual_rms, fixed_y);
+    printf("adaptive: %lu iterations, residual %.4f (rms %.4f), top at y %.2f\n", adaptive.n_solver_iterations, adaptive.solver_residual_max, adaptive.solver_residual_rms, adaptive_y);
+    printf("global: %lu sweeps, residual %.4f, top at y %.2f\n", global.n_solver_iterations, global.solver_residual_max, global_y);
+
+    int failed = check(fixed.max_solver_iterations == 5, "a tolerance of 0 stopped early");
+    failed |= check(adaptive.max_solver_iterations < 5, "settled pile kept iterating");
+    failed |= check(adaptive.solver_residual_max <= 0.05f, "stopped above the tolerance");
+    failed |= check(fabsf(adaptive_y - fixed_y) < 1.0f, "stopping early moved the pile");
+    failed |= check(adaptive_threads_y == adaptive_y && adaptive_threads.n_solver_iterations == adaptive.n_solver_iterations, "iterations depend on the number of threads");
+    failed |= check(global.n_solver_iterations < 20 && fabsf(global_y - fixed_y) < 2.0f, "global solver did not settle");
+    return failed;
+}
+
+// a box dropped on a stack needs more iterations than the stack next to it left alone
+int test_per_island()
+{
+    World w;
+    world_create(&w, -9.8f);
+    w.allow_sleeping = false;
+    w.solver_tolerance = 0.05f;
+    w.constraint_iterations = 50;
+    add_box(&w, 500, 1025, 1000, 50, 0.0);
+    for (int s = 0; s < 2; s++)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            add_box(&w, 300 + s * 400, 980 - i * 40.5f, 40, 40, 1.0);
+        }
+    }
+    for (int frame = 0; frame < 120; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+    }
+
+    // falls onto the left stack a little after this
+    BodyHandle dropped = add_box(&w, 300, 700, 40, 40, 5.0);
+    world_get_body(&w, dropped)->velocity.y = 600;
+    unsigned long most = 0;
+    for (int frame = 0; frame < 30; frame++)
+    {
+        world_update(&w, 1.0f / 60.0f);
+        most = MAX(most, w.stats.max_solver_iterations);
+    }
+    printf("dropped box: up to %lu iterations on one island, %lu over both in the last step\n", most, w.stats.n_solver_iterations);
+    world_destroy(&w);
+
+    return check(most > 5, "the hit stack did not get more iterations");
+}
+
+int main()
+{
+    int failed = test_settled();
+    failed |= test_per_island();
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include "test_util.h"
+
+bool close_to(float a, float b)
+{
+    return fabsf(a - b) <= 1e-4f * (1.0f + fabsf(a));
+}
+
+// the sparse products against the dense MatMN ones on a random matrix
+int test_products()
+{
+    unsigned int m = 9, n = 14;
+    MatMN dense = matmn_create(m, n, MEM_HEAP);
+    MatCSR a, at, z;
+    matcsr_create(&a);
+    matcsr_create(&at);
+    matcsr_create(&z);
+
+    srand(3);
+    matcsr_clear(&a, n);
+    for (unsigned int i = 0; i < m; i++)
+    {
+        for (unsigned int j = 0; j < n; j++)
+        {
+            if (rand() % 3 == 0)
+            {
+                MATMN_AT(dense, i, j) = (float)(rand() % 200 - 100) / 10.0f;
+                matcsr_push(&a, j, MATMN_AT(dense, i, j));
+            }
+        }
+        matcsr_end_row(&a);
+    }
+
+    MatMN d = matmn_create(n, 1, MEM_HEAP);
+    MatMN x = matmn_create(n, 1, MEM_HEAP);
+    for (unsigned int j = 0; j < n; j++)
+    {
+        d.data[j] = (j % 4 == 0) ? 0.0f : (float)(rand() % 100) / 25.0f;
+        x.data[j] = (float)(rand() % 100) / 10.0f;
+    }
+
+    // z = a @ diag(d) @ a.T, densely
+    MatMN scaled = matmn_create(m, n, MEM_HEAP);
+    MatMN dense_t = matmn_create(n, m, MEM_HEAP);
+    MatMN expected = matmn_create(m, m, MEM_HEAP);
+    for (unsigned int i = 0; i < m; i++)
+    {
+        for (unsigned int j = 0; j < n; j++)
+        {
+            MATMN_AT(scaled, i, j) = MATMN_AT(dense, i, j) * d.data[j];
+        }
+    }
+    matmn_transpose(&dense, &dense_t);
+    matmn_mul(&scaled, &dense_t, &expected);
+
+    matcsr_transpose(&a, &at);
+    matcsr_mul_diag_transpose(&a, &d, &at, &z);
+
+    int failed = 0;
+    for (unsigned int j = 0; j < n; j++)
+    {
+        for (unsigned int k = at.row_start[j]; k < at.row_start[j + 1]; k++)
+        {
+            failed |= check(at.data[k] == MATMN_AT(dense, at.col[k], j), "transpose misplaced an entry");
+        }
+    }
+    failed |= check(at.nnz == a.nnz, "transpose lost entries");
+
+    MatMN zx = matmn_create(m, 1, MEM_HEAP);
+    MatMN expected_zx = matmn_create(m, 1, MEM_HEAP);
+    matcsr_mul(&a, &x, &zx);
+    matmn_mul(&dense, &x, &expected_zx);
+    for (unsigned int i = 0; i < m; i++)
+    {
+        failed |= check(close_to(zx.data[i], expected_zx.data[i]), "a @ x differs from the dense product");
+
+        float row[9] = {0};
+        for (unsigned int k = z.row_start[i]; k < z.row_start[i + 1]; k++)
+        {
+            row[z.col[k]] += z.data[k];
+        }
+        for (unsigned int j = 0; j < m; j++)
+        {
+            failed |= check(close_to(row[j], MATMN_AT(expected, i, j)), "a @ diag(d) @ a.T differs from the dense product");
+        }
+    }
+    printf("products: %u x %u with %u entries, a @ diag(d) @ a.T has %u\n", m, n, a.nnz, z.nnz);
+
+    matmn_destroy(&dense);
+    matmn_destroy(&d);
+    matmn_destroy(&x);
+    matmn_destroy(&scaled);
+    matmn_destroy(&dense_t);
+    matmn_destroy(&expected);
+    matmn_destroy(&zx);
+    matmn_destroy(&expected_zx);
+    matcsr_destroy(&a);
+    matcsr_destroy(&at);
+    matcsr_destroy(&z);
+    return failed;
+}
+
+// a small LCP with one bound active and a friction row bounded by another row
+int test_pgs()
+{
+    // [ 2 1 0 ]       [  1 ]
+    // [ 1 2 0 ] x  =  [ -4 ],  x0 >= 0, x1 >= 0, |x2| <= 0.5 * x0
+    // [ 0 0 1 ]       [  3 ]
+    float dense[3][3] = {{2, 1, 0}, {1, 2, 0}, {0, 0, 1}};
+    MatCSR a;
+    matcsr_create(&a);
+    matcsr_clear(&a, 3);
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            if (dense[i][j] != 0)
+                matcsr_push(&a, j, dense[i][j]);
+        }
+        matcsr_end_row(&a);
+    }
+
+    float b_data[3] = {1, -4, 3};
+    float x_data[3] = {0, 0, 0};
+    float lo_data[3] = {0, 0, 0};
+    float hi_data[3] = {INFINITY, INFINITY, 0.5f};
+    int findex[3] = {MATCSR_NO_FINDEX, MATCSR_NO_FINDEX, 0};
+    MatMN b = {3, 1, b_data}, x = {3, 1, x_data}, lo = {3, 1, lo_data}, hi = {3, 1, hi_data};
+    matcsr_solve_pgs(&a, &b, &x, &lo, &hi, findex, 50);
+
+    // x1 would be negative, clamped to 0 leaves x0 = 1 / 2 and x2 at 0.5 * x0
+    printf("pgs: x = (%.4f, %.4f, %.4f)\n", x_data[0], x_data[1], x_data[2]);
+    int failed = check(close_to(x_data[0], 0.5f) && x_data[1] == 0 && close_to(x_data[2], 0.25f), "bounded solve");
+
+    // warm started at the solution, a sweep leaves it there
+    matcsr_solve_pgs(&a, &b, &x, &lo, &hi, findex, 1);
+    failed |= check(close_to(x_data[0], 0.5f) && x_data[1] == 0 && close_to(x_data[2], 0.25f), "warm start moved off the solution");
+
+    matcsr_destroy(&a);
+    return failed;
+}
+
+// stacks solved as one system stay up like with the per-constraint solver
+int test_world_stacks()
+{
+    int failed = 0;
+    float top_y[2];
+    for (int global = 0; global < 2; global++)
+    {
+        World w;
+        world_create(&w, -9.8f);
+        w.allow_sleeping = false;
+        w.global_solver = global;
+        add_box(&w, 500, 1025, 1000, 50, 0.0);
+        BodyHandle top = BODY_HANDLE_NULL;
+        for (int s = 0; s < 5; s++)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                top = add_box(&w, 100 + s * 150, 980 - i * 40.5f, 40, 40, 1.0);
+            }
+        }
+
+        for (int frame = 0; frame < 180; frame++)
+        {
+            world_update(&w, 1.0f / 60.0f);
+        }
+        top_y[global] = world_get_body(&w, top)->position.y;
+        world_destroy(&w);
+    }
+
+    printf("stacks: top box at y %.2f per constraint, %.2f as one system\n", top_y[0], top_y[1]);
+    failed |= check(fabsf(top_y[1] - (980 - 7 * 40)) < 5.0f, "stack solved as one system fell");
+    failed |= check(fabsf(top_y[1] - top_y[0]) < 2.0f, "global solver strays from the per-constraint one");
+    return failed;
+}
+
+int main()
+{
+    int failed = test_products();
+    failed |= test_pgs();
+    failed |= test_world_stacks();
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
@@ -0,0 +1,25 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "../world.h"
+
+// prints message when ok is false, returns 1 then so failures can be or-ed together
+int check(bool ok, const char *message)
+{
+    if (!ok)
+        printf("FAIL: %s\n", message);
+    return ok ? 0 : 1;
+}
+
+// box of the friction and restitution the tests build their scenes from
+BodyHandle add_box(World *w, float x, float y, float width, float height, float mass)
+{
+    Body b = body_create(box_create(width, height), x, y, mass);
+    b.friction = 0.5;
+    b.restitution = 0.0;
+    return world_add_body(w, b);
+}
+
+#endif
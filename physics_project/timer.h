@@ -0,0 +1,15 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stddef.h>
+#include <sys/time.h>
+
+// wall clock time in seconds, for benchmarks and stage timings
+double timer_now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "mem.h"
+#include "timer.h"
+
+// Timing of named scopes for chrome://tracing or Perfetto. Built with -DDEBUG_TRACE,
+// TRACE_BEGIN and TRACE_END record when a scope started and ended on the calling thread,
+// otherwise they compile to nothing. Scopes on a thread nest, every TRACE_BEGIN needs its
+// TRACE_END on the same thread. Names are not copied and have to outlive the trace.
+#ifdef DEBUG_TRACE
+#define TRACE_BEGIN(name) trace_begin(name)
+#define TRACE_END() trace_end()
+#else
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END() ((void)0)
+#endif
+
+// events a thread keeps, older ones are overwritten
+#define TRACE_RING_SIZE 16384
+#define TRACE_MAX_THREADS 64
+#define TRACE_MAX_DEPTH 32
+
+typedef struct
+{
+    const char *name;
+    double start;
+    double end;
+} TraceEvent;
+
+// Events of one thread. Only that thread writes them, head is published after the event so
+// trace_write_chrome_json can read up to it without a lock.
+typedef struct
+{
+    TraceEvent events[TRACE_RING_SIZE];
+    unsigned long head;
+
+    // scopes begun and not ended yet
+    const char *open_names[TRACE_MAX_DEPTH];
+    double open_starts[TRACE_MAX_DEPTH];
+    unsigned int depth;
+} TraceRing;
+
+// rings in the order the threads first traced, a thread past TRACE_MAX_THREADS is not traced
+struct Trace
+{
+    TraceRing *rings[TRACE_MAX_THREADS];
+    unsigned int n_rings;
+};
+
+struct Trace trace = {{NULL}, 0};
+
+// ring of the calling thread, NULL until it traces or when it could not get one
+__thread TraceRing *trace_ring = NULL;
+__thread bool trace_thread_full = false;
+
+TraceRing *trace_thread_ring()
+{
+    if (trace_ring || trace_thread_full)
+        return trace_ring;
+
+    unsigned int slot = __atomic_fetch_add(&trace.n_rings, 1, __ATOMIC_ACQ_REL);
+    if (slot >= TRACE_MAX_THREADS)
+    {
+        trace_thread_full = true;
+        return NULL;
+    }
+    trace_ring = (TraceRing *)mem_calloc(1, sizeof(TraceRing), MEM_HEAP);
+    __atomic_store_n(&trace.rings[slot], trace_ring, __ATOMIC_RELEASE);
+    return trace_ring;
+}
+
+void trace_begin(const char *name)
+{
+    TraceRing *ring = trace_thread_ring();
+    if (!ring)
+        return;
+
+    if (ring->depth < TRACE_MAX_DEPTH)
+    {
+        ring->open_names[ring->depth] = name;
+        ring->open_starts[ring->depth] = timer_now();
+    }
+    ring->depth++;
+}
+
+void trace_end()
+{
+    TraceRing *ring = trace_ring;
+    if (!ring || ring->depth == 0)
+        return;
+
+    ring->depth--;
+    if (ring->depth >= TRACE_MAX_DEPTH)
+        return;
+
+    unsigned long head = ring->head;
+    ring->events[head % TRACE_RING_SIZE] = (TraceEvent){ring->open_names[ring->depth], ring->open_starts[ring->depth], timer_now()};
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Writes the events every thread still has as Chrome trace event JSON, one complete event
+// per scope in microseconds from the earliest one. Threads that trace while it writes may
+// overwrite events it is reading, call it between steps. Returns false if the file could not
+// be written.
+bool trace_write_chrome_json(const char *file_name)
+{
+    FILE *file = fopen(file_name, "w");
+    if (!file)
+        return false;
+
+    unsigned int n_rings = __atomic_load_n(&trace.n_rings, __ATOMIC_ACQUIRE);
+    if (n_rings > TRACE_MAX_THREADS)
+        n_rings = TRACE_MAX_THREADS;
+
+    double epoch = 0;
+    bool have_epoch = false;
+    for (unsigned int t = 0; t < n_rings; t++)
+    {
+        TraceRing *ring = __atomic_load_n(&trace.rings[t], __ATOMIC_ACQUIRE);
+        unsigned long head = ring ? __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) : 0;
+        unsigned long first = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+        for (unsigned long e = first; e < head; e++)
+        {
+            double start = ring->events[e % TRACE_RING_SIZE].start;
+            if (!have_epoch || start < epoch)
+                epoch = start;
+            have_epoch = true;
+        }
+    }
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    bool first_event = true;
+    for (unsigned int t = 0; t < n_rings; t++)
+    {
+        TraceRing *ring = __atomic_load_n(&trace.rings[t], __ATOMIC_ACQUIRE);
+        if (!ring)
+            continue;
+
+        fprintf(file, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"thread %u\"}}", first_event ? "" : ",", t, t);
+        first_event = false;
+
+        unsigned long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        unsigned long first = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+        for (unsigned long e = first; e < head; e++)
+        {
+            TraceEvent *event = &ring->events[e % TRACE_RING_SIZE];
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u}", event->name, 1e6 * (event->start - epoch),
+                    1e6 * (event->end - event->start), t);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0;
+}
+
+// Forgets the events recorded so far, while no thread traces
+void trace_clear()
+{
+    for (unsigned int t = 0; t < trace.n_rings && t < TRACE_MAX_THREADS; t++)
+    {
+        if (trace.rings[t])
+            trace.rings[t]->head = 0;
+    }
+}
+
+#endif
@@ -2,19 +2,135 @@
 #define WORLD_H
 
 #include "body.h"
+#include "body_pool.h"
+#include "body_state.h"
+#include "broadphase.h"
 #include "collision.h"
+#include "coloring.h"
 #include "constraint.h"
+#include "constraint_system.h"
+#include "contact_rows.h"
+#include "debug_draw.h"
+#include "island.h"
+#include "job.h"
 #include "linked_list.h"
+#include "manifold.h"
 #include "mem.h"
+#include "narrowphase.h"
+#include "timer.h"
+#include "trace.h"
 
 #define MAX_CONSTRAINTS 100
 
 #define PIXELS_PER_METER 50
 
+// world_update runs as a graph of these stages, with the per-body and per-island work of a
+// stage split over the job system
+typedef enum
+{
+    WORLD_STAGE_APPLY_FORCES,
+    WORLD_STAGE_INTEGRATE_FORCES,
+    WORLD_STAGE_BROADPHASE,
+    WORLD_STAGE_NARROWPHASE,
+    WORLD_STAGE_ISLANDS,
+    WORLD_STAGE_PRE_SOLVE,
+    WORLD_STAGE_SOLVE,
+    WORLD_STAGE_INTEGRATE_VELOCITIES,
+    WORLD_STAGE_SLEEP,
+    WORLD_STAGE_COUNT
+} WorldStage;
+
+const char *world_stage_names[WORLD_STAGE_COUNT] = {
+    "apply forces",
+    "integrate forces",
+    "broadphase",
+    "narrowphase",
+    "islands",
+    "pre-solve",
+    "solve",
+    "integrate velocities",
+    "sleep",
+};
+
+// how the contacts of colored islands are solved, the scalar path is the reference the
+// SIMD one is checked against
+typedef enum
+{
+    CONTACT_SOLVER_SCALAR,
+    CONTACT_SOLVER_SIMD
+} ContactSolver;
+
+// How world_update advances the bodies. SOLVER_MODE_BAUMGARTE integrates once and solves
+// constraint_iterations passes that push out joint_beta and penetration_beta of the error
+// per step. SOLVER_MODE_SOFT_STEP splits the step into substeps of one soft solve and one
+// relax pass each, see world_solve_soft_step.
+typedef enum
+{
+    SOLVER_MODE_BAUMGARTE,
+    SOLVER_MODE_SOFT_STEP
+} SolverMode;
+
+typedef struct
+{
+    unsigned long n_pairs_tested;
+    unsigned long n_candidate_pairs;
+    unsigned long n_contacts;
+    unsigned long n_manifolds;
+    unsigned long n_warm_started_contacts;
+    unsigned long n_islands;
+    unsigned long n_awake_bodies;
+    unsigned long n_sleeping_bodies;
+    double broadphase_time;
+    unsigned long n_colors;
+    unsigned long n_colored_constraints;
+    unsigned long n_overflow_constraints;
+    double solver_time;
+    // solver iterations of the step summed over the islands and the most one island took,
+    // the colored islands and the global solver count as one island. The residual is how far
+    // the impulses moved in the last iteration of each.
+    unsigned long n_solver_iterations;
+    unsigned long max_solver_iterations;
+    float solver_residual_max;
+    float solver_residual_rms;
+    double stage_time[WORLD_STAGE_COUNT];
+    // most scratch memory one thread had in use at once during the step
+    size_t scratch_high_water;
+} WorldStats;
+
+// state the stages of the step in progress hand to each other
+typedef struct
+{
+    float delta_time;
+    // contact constraints in the order of the touched manifolds
+    PenetrationConstraint *contacts;
+    unsigned int contacts_capacity;
+    unsigned int n_contacts;
+    // awake islands before this one are solved color by color
+    unsigned int n_colored_islands;
+    // with CONTACT_SOLVER_SIMD the contacts of color k are the contact rows
+    // [contact_row_start[k], contact_row_start[k + 1]), padded to CONTACT_ROWS_WIDTH
+    unsigned int contact_row_start[COLORING_MAX_COLORS + 1];
+    // per uncolored awake island, its iterations and the residual of the last one
+    unsigned int *island_iterations;
+    SolverResidual *island_residuals;
+    unsigned int islands_capacity;
+    // per thread, the residual of the colored constraints in the current iteration
+    SolverResidual *thread_residuals;
+    unsigned int threads_capacity;
+    // the substep of the soft step in progress, its length and the softness in it
+    unsigned int substep;
+    float substep_time;
+    float inv_substep_time;
+    Softness contact_softness;
+    Softness joint_softness;
+} WorldStep;
+
 typedef struct
 {
     float G;
-    List bodies;
+    BodyPool body_pool;
+    // hot state of the bodies that the integrate stages work on
+    BodyState body_state;
     List joint_constraints;
 
     // constraint solving constants
@@ -22,112 +138,1087 @@ typedef struct
     float penetration_beta;
     unsigned int constraint_iterations;
     unsigned int gauss_seidel_iterations;
+    // An island stops iterating once no impulse moved by more than solver_tolerance in an
+    // iteration, after at least min_constraint_iterations. constraint_iterations, or
+    // gauss_seidel_iterations for the global solver, is the most it gets. At 0 only a pass
+    // that changed nothing stops early, which leaves the result as it was.
+    unsigned int min_constraint_iterations;
+    float solver_tolerance;
+
+    // islands with at least this many constraints are solved color by color, so that a single
+    // big pile still spreads over the threads
+    unsigned int coloring_threshold;
+    ContactSolver contact_solver;
+    // assemble all awake constraints of a step into one sparse system and solve it with
+    // projected Gauss-Seidel, gauss_seidel_iterations sweeps, instead of constraint by constraint.
+    // Only with SOLVER_MODE_BAUMGARTE.
+    bool global_solver;
+
+    SolverMode solver_mode;
+    // The soft step: substeps per step, the stiffness in hertz and damping ratio of contacts
+    // and joints, how fast overlap is pushed out (pixels per second) and the approach velocity
+    // that bounces with restitution. Contacts stay below a quarter of the substep rate. Colored
+    // islands are solved with the scalar contact solver.
+    unsigned int substeps;
+    float contact_hertz;
+    float contact_damping_ratio;
+    float joint_hertz;
+    float joint_damping_ratio;
+    float max_bias_velocity;
+    float restitution_threshold;
+
+    // islands whose bodies all stay below these velocities (pixels and radians per second)
+    // for time_to_sleep seconds are put to sleep
+    bool allow_sleeping;
+    float sleep_linear_velocity;
+    float sleep_angular_velocity;
+    float time_to_sleep;
+
+    Broadphase broadphase;
+    Narrowphase narrowphase;
+    ManifoldCache manifolds;
+    Islands islands;
+    ConstraintColoring coloring;
+    ContactRows contact_rows;
+    ConstraintSystem system;
+    JobSystem jobs;
+    WorldStep step;
+    WorldStats stats;
+    // contact points of the last step, when enabled
+    DebugDraw debug_draw;
 } World;
 
 void world_create(World *w, float gravity)
 {
     w->G = -gravity;
-    w->bodies = list_create_empty();
+    body_pool_create(&w->body_pool);
+    body_state_create(&w->body_state);
     w->joint_constraints = list_create_empty();
 
     w->joint_beta = 0.2;
     w->penetration_beta = 0.2;
     w->constraint_iterations = 5;
     w->gauss_seidel_iterations = 5;
+    w->min_constraint_iterations = 1;
+    w->solver_tolerance = 0.0f;
+    w->coloring_threshold = 512;
+    w->contact_solver = CONTACT_SOLVER_SIMD;
+    w->global_solver = false;
+
+    w->solver_mode = SOLVER_MODE_BAUMGARTE;
+    w->substeps = 3;
+    w->contact_hertz = 30.0f;
+    w->contact_damping_ratio = 5.0f;
+    w->joint_hertz = 60.0f;
+    w->joint_damping_ratio = 5.0f;
+    w->max_bias_velocity = 3.0f * PIXELS_PER_METER;
+    w->restitution_threshold = 1.0f * PIXELS_PER_METER;
+
+    w->allow_sleeping = true;
+    w->sleep_linear_velocity = 0.02f * PIXELS_PER_METER;
+    w->sleep_angular_velocity = 2.0f * M_PI / 180.0f;
+    w->time_to_sleep = 0.5f;
+
+    broadphase_create(&w->broadphase, BROADPHASE_SPATIAL_HASH);
+    narrowphase_create(&w->narrowphase);
+    manifold_cache_create(&w->manifolds);
+    islands_create(&w->islands);
+    coloring_create(&w->coloring);
+    contact_rows_create(&w->contact_rows);
+    constraint_system_create(&w->system);
+    job_system_create(&w->jobs, 0);
+    w->step = (WorldStep){0};
+    w->stats = (WorldStats){0};
+    debug_draw_create(&w->debug_draw);
 }
 
-void world_update(World *w, float delta_time)
+void world_set_broadphase(World *w, BroadphaseType type)
 {
-    List pc_list = list_create_empty();
+    broadphase_reset(&w->broadphase, w->body_pool.bodies, w->body_pool.n_bodies);
+    w->broadphase.type = type;
+}
+
+void world_destroy(World *w)
+{
+    list_destroy(&w->joint_constraints);
+
+    for (unsigned int i = 0; i < w->body_pool.n_bodies; i++)
+    {
+        shape_release(&w->body_pool.bodies[i].shape);
+    }
+    body_pool_destroy(&w->body_pool);
+    body_state_destroy(&w->body_state);
+
+    broadphase_destroy(&w->broadphase);
+    narrowphase_destroy(&w->narrowphase);
+    manifold_cache_destroy(&w->manifolds);
+    islands_destroy(&w->islands);
+    coloring_destroy(&w->coloring);
+    contact_rows_destroy(&w->contact_rows);
+    constraint_system_destroy(&w->system);
+    job_system_destroy(&w->jobs);
+    mem_free(w->step.contacts);
+    mem_free(w->step.island_iterations);
+    mem_free(w->step.island_residuals);
+    mem_free(w->step.thread_residuals);
+    debug_draw_destroy(&w->debug_draw);
+}
+
+// number of worker threads helping the one calling world_update, 0 runs every stage inline
+void world_set_workers(World *w, unsigned int n_workers)
+{
+    job_system_destroy(&w->jobs);
+    job_system_create(&w->jobs, n_workers);
+}
 
-    for (Node *n = w->bodies.start, *next; n != NULL; n = next)
+// bodies may have moved in the array, points the joints at them again
+void world_refresh_joints(World *w)
+{
+    for (Node *n = w->joint_constraints.start; n != NULL; n = n->next)
     {
-        Body *b = (Body *)n->data;
-        Vec2 weight = (Vec2){0.0, b->mass * w->G * PIXELS_PER_METER};
-        body_add_force(b, weight);
+        JointConstraint *jc = (JointConstraint *)n->data;
+        jc->a = body_pool_get(&w->body_pool, jc->a_handle);
+        jc->b = body_pool_get(&w->body_pool, jc->b_handle);
+    }
+}
+
+// Adds a copy of body, the world owns its polygon from then on. Body pointers into the world
+// are only good until the next add or remove, keep the handle instead. The world keeps the
+// ones of its joints up to date.
+BodyHandle world_add_body(World *w, Body body)
+{
+    BodyHandle handle = body_pool_add(&w->body_pool, body);
+    world_refresh_joints(w);
+    return handle;
+}
+
+// body of the handle, NULL once it was removed
+Body *world_get_body(World *w, BodyHandle handle)
+{
+    return body_pool_get(&w->body_pool, handle);
+}
+
+// Removes a body together with the joints attached to it and gives its polygon vertices
+// back. Its manifolds are dropped at the next step as nothing touches them anymore.
+void world_remove_body(World *w, BodyHandle handle)
+{
+    Body *b = body_pool_get(&w->body_pool, handle);
+    if (!b)
+        return;
+
+    for (Node *n = w->joint_constraints.start, *next; n; n = next)
+    {
+        JointConstraint *jc = (JointConstraint *)n->data;
         next = n->next;
+        if (body_pool_get(&w->body_pool, jc->a_handle) == b || body_pool_get(&w->body_pool, jc->b_handle) == b)
+        {
+            List_remove(&w->joint_constraints, jc);
+        }
+    }
+
+    broadphase_remove_body(&w->broadphase, b, w->body_pool.bodies, w->body_pool.n_bodies);
+    shape_release(&b->shape);
+    body_pool_remove(&w->body_pool, handle);
+    world_refresh_joints(w);
+}
+
+// joint between two bodies of the world pinned at anchor, in world space
+JointConstraint *world_add_joint(World *w, BodyHandle a, BodyHandle b, Vec2 anchor)
+{
+    JointConstraint *jc = (JointConstraint *)malloc(sizeof(JointConstraint));
+    joint_constraint_create(jc, world_get_body(w, a), world_get_body(w, b), anchor);
+    List_push(&w->joint_constraints, jc);
+    return jc;
+}
+
+bool world_body_moves(Body *b)
+{
+    return b->is_awake && b->inv_mass != 0.0;
+}
+
+// contacts and joints are solved while either body is in an awake island
+bool world_constraint_awake(World *w, Body *a, Body *b)
+{
+    return islands_body_awake(&w->islands, a) || islands_body_awake(&w->islands, b);
+}
+
+void world_build_islands(World *w)
+{
+    islands_begin(&w->islands, w->body_pool.n_bodies);
+
+    for (unsigned int t = 0; t < w->manifolds.n_touched; t++)
+    {
+        Manifold *m = manifold_cache_touched(&w->manifolds, t);
+        if (m->a->inv_mass != 0.0 && m->b->inv_mass != 0.0)
+            islands_union(&w->islands, m->a->world_index, m->b->world_index);
     }
 
-    for (Node *n = w->bodies.start, *next; n != NULL; n = next)
+    for (Node *n = w->joint_constraints.start, *next; n; n = next)
     {
-        Body *b = (Body *)n->data;
-        body_integrate_forces(b, delta_time);
+        JointConstraint *jc = (JointConstraint *)n->data;
+        if (jc->a->inv_mass != 0.0 && jc->b->inv_mass != 0.0)
+            islands_union(&w->islands, jc->a->world_index, jc->b->world_index);
         next = n->next;
     }
 
-    // collision detection
-    for (Node *n_i = w->bodies.start, *next_i; n_i != NULL; n_i = next_i)
+    islands_end(&w->islands, w->body_pool.bodies);
+    islands_wake(&w->islands, w->body_pool.bodies);
+}
+
+// bodies per job in the per-body stages
+#define WORLD_BODY_GRAIN 256
+// broadphase pairs per narrowphase job
+#define WORLD_PAIR_GRAIN 64
+// islands per job, the islands come largest first
+#define WORLD_ISLAND_GRAIN 4
+// constraints of a color per job item
+#define WORLD_COLOR_CHUNK 64
+
+// post-solve only copies the impulses of contact rows back, the last four only in the soft step
+typedef enum
+{
+    SOLVER_PRE_SOLVE,
+    SOLVER_SOLVE,
+    SOLVER_POST_SOLVE,
+    SOLVER_WARM_START,
+    SOLVER_SOFT_SOLVE,
+    SOLVER_RELAX,
+    SOLVER_RESTITUTION
+} SolverPhase;
+
+const char *solver_phase_names[] = {"pre-solve", "solve", "post-solve", "warm start", "soft solve", "relax", "restitution"};
+
+typedef struct
+{
+    World *w;
+    SolverPhase phase;
+    unsigned int color;
+    unsigned int chunk;
+} WorldColorJob;
+
+typedef struct
+{
+    World *w;
+    SolverPhase phase;
+} WorldIslandJob;
+
+typedef struct
+{
+    World *w;
+    WorldStage stage;
+} WorldStageTask;
+
+// the first stage of a step, it also keeps where every body starts the step for drawing
+// between steps
+void world_apply_forces(void *data, unsigned int item, unsigned int thread)
+{
+    World *w = (World *)data;
+    (void)thread;
+    Body *b = &w->body_pool.bodies[item];
+    b->previous_position = b->position;
+    b->previous_theta = b->theta;
+    if (!b->is_awake)
+        return;
+
+    Vec2 weight = (Vec2){0.0, b->mass * w->G * PIXELS_PER_METER};
+    body_add_force(b, weight);
+}
+
+// bodies [begin, end) of the run of WORLD_BODY_GRAIN bodies given by item
+void world_body_run(World *w, unsigned int item, unsigned int *begin, unsigned int *end)
+{
+    *begin = item * WORLD_BODY_GRAIN;
+    *end = *begin + WORLD_BODY_GRAIN;
+    if (*end > w->body_pool.n_bodies)
+        *end = w->body_pool.n_bodies;
+}
+
+unsigned int world_n_body_runs(World *w)
+{
+    return (w->body_pool.n_bodies + WORLD_BODY_GRAIN - 1) / WORLD_BODY_GRAIN;
+}
+
+void world_integrate_forces(void *data, unsigned int item, unsigned int thread)
+{
+    World *w = (World *)data;
+    (void)thread;
+    unsigned int begin, end;
+    world_body_run(w, item, &begin, &end);
+    body_state_load_forces(&w->body_state, w->body_pool.bodies, begin, end);
+    body_state_integrate_forces(&w->body_state, begin, end, w->step.delta_time);
+    body_state_store_velocities(&w->body_state, w->body_pool.bodies, begin, end);
+}
+
+void world_integrate_velocities(void *data, unsigned int item, unsigned int thread)
+{
+    World *w = (World *)data;
+    (void)thread;
+    unsigned int begin, end;
+    world_body_run(w, item, &begin, &end);
+    body_state_load_velocities(&w->body_state, w->body_pool.bodies, begin, end);
+    body_state_integrate_velocities(&w->body_state, begin, end, w->step.delta_time);
+    body_state_store_positions(&w->body_state, w->body_pool.bodies, begin, end);
+}
+
+void world_island_constraints(World *w, unsigned int item, JointConstraint ***joints, unsigned int *n_joints, PenetrationConstraint ***contacts, unsigned int *n_contacts)
+{
+    Islands *is = &w->islands;
+    unsigned int island = is->awake_islands[w->step.n_colored_islands + item].island;
+
+    *joints = &is->joints[is->joint_start[island]];
+    *n_joints = is->joint_start[island + 1] - is->joint_start[island];
+    *contacts = &is->contacts[is->contact_start[island]];
+    *n_contacts = is->contact_start[island + 1] - is->contact_start[island];
+}
+
+bool world_uses_contact_rows(World *w)
+{
+    return w->contact_solver == CONTACT_SOLVER_SIMD && w->solver_mode == SOLVER_MODE_BAUMGARTE;
+}
+
+bool world_uses_global_solver(World *w)
+{
+    return w->global_solver && w->solver_mode == SOLVER_MODE_BAUMGARTE;
+}
+
+// runs one solver phase on a joint, the phases that solve add how far its impulse moved to
+// residual
+void world_joint_phase(World *w, JointConstraint *c, SolverPhase phase, SolverResidual *residual)
+{
+    switch (phase)
+    {
+    case SOLVER_PRE_SOLVE:
+        if (w->solver_mode == SOLVER_MODE_SOFT_STEP)
+            joint_constraint_prepare(c);
+        else
+            joint_constraint_pre_solve(c, w->step.delta_time, w->joint_beta);
+        break;
+    case SOLVER_SOLVE:
+        solver_residual_add(residual, joint_constraint_solve(c));
+        break;
+    case SOLVER_WARM_START:
+        joint_constraint_warm_start(c);
+        break;
+    case SOLVER_SOFT_SOLVE:
+    case SOLVER_RELAX:
+        solver_residual_add(residual, joint_constraint_solve_soft(c, w->step.joint_softness, phase == SOLVER_SOFT_SOLVE));
+        break;
+    case SOLVER_POST_SOLVE:
+    case SOLVER_RESTITUTION:
+        break;
+    }
+}
+
+void world_contact_phase(World *w, PenetrationConstraint *c, SolverPhase phase, SolverResidual *residual)
+{
+    switch (phase)
+    {
+    case SOLVER_PRE_SOLVE:
+        if (w->solver_mode == SOLVER_MODE_SOFT_STEP)
+            penetration_constraint_pre_solve_soft(c);
+        else
+            penetration_constraint_pre_solve(c, w->step.delta_time, w->penetration_beta);
+        break;
+    case SOLVER_SOLVE:
+        solver_residual_add(residual, penetration_constraint_solve(c));
+        break;
+    case SOLVER_POST_SOLVE:
+        // only contact rows have impulses to store, world_solve_color_chunk does that
+        break;
+    case SOLVER_WARM_START:
+        penetration_constraint_warm_start(c);
+        break;
+    case SOLVER_SOFT_SOLVE:
+    case SOLVER_RELAX:
+        solver_residual_add(residual, penetration_constraint_solve_soft(c, w->step.contact_softness, w->max_bias_velocity, w->step.inv_substep_time, phase == SOLVER_SOFT_SOLVE));
+        break;
+    case SOLVER_RESTITUTION:
+        penetration_constraint_restitution(c, w->restitution_threshold);
+        break;
+    }
+}
+
+void world_pre_solve_island(void *data, unsigned int item, unsigned int thread)
+{
+    World *w = (World *)data;
+    (void)thread;
+    JointConstraint **joints;
+    PenetrationConstraint **contacts;
+    unsigned int n_joints, n_contacts;
+    world_island_constraints(w, item, &joints, &n_joints, &contacts, &n_contacts);
+
+    for (unsigned int i = 0; i < n_joints; i++)
+    {
+        world_joint_phase(w, joints[i], SOLVER_PRE_SOLVE, NULL);
+    }
+
+    for (unsigned int i = 0; i < n_contacts; i++)
     {
-        for (Node *n_j = n_i->next, *next_j; n_j != NULL; n_j = next_j)
+        world_contact_phase(w, contacts[i], SOLVER_PRE_SOLVE, NULL);
+    }
+}
+
+// Solves the constraints of one awake island, in the same order as they would be solved
+// for the whole world at once, until they settle
+void world_solve_island(void *data, unsigned int item, unsigned int thread)
+{
+    World *w = (World *)data;
+    (void)thread;
+    JointConstraint **joints;
+    PenetrationConstraint **contacts;
+    unsigned int n_joints, n_contacts;
+    world_island_constraints(w, item, &joints, &n_joints, &contacts, &n_contacts);
+
+    unsigned int iter = 0;
+    SolverResidual residual = {0};
+    while (iter < w->constraint_iterations)
+    {
+        residual = (SolverResidual){0};
+        for (unsigned int i = 0; i < n_joints; i++)
         {
-            Body *a = (Body *)n_i->data;
-            Body *b = (Body *)n_j->data;
-            Collision_Info info[10];
-            unsigned int n_collisions = 0;
+            solver_residual_add(&residual, joint_constraint_solve(joints[i]));
+        }
+
+        for (unsigned int i = 0; i < n_contacts; i++)
+        {
+            solver_residual_add(&residual, penetration_constraint_solve(contacts[i]));
+        }
+
+        iter++;
+        if (iter >= w->min_constraint_iterations && residual.max <= w->solver_tolerance)
+            break;
+    }
+    w->step.island_iterations[item] = iter;
+    w->step.island_residuals[item] = residual;
+}
 
-            if (collision(a, b, info, &n_collisions))
-            {
-                for (unsigned int coll_iter = 0; coll_iter < n_collisions; coll_iter++)
-                {
-                    gfx_draw_filled_square(info[coll_iter].start.x, info[coll_iter].start.y, 8, (uint8_t[3]){255, 0, 0});
+void world_solve_color_chunk(void *data, unsigned int item, unsigned int thread)
+{
+    WorldColorJob *job = (WorldColorJob *)data;
+    World *w = job->w;
+    ConstraintColoring *c = &w->coloring;
 
-                    PenetrationConstraint *pc = (PenetrationConstraint *)mem_malloc(sizeof(PenetrationConstraint));
-                    penetration_constraint_create(pc, info[coll_iter].a, info[coll_iter].b, info[coll_iter].start, info[coll_iter].end, info[coll_iter].normal);
-                    List_push(&pc_list, pc); // calling malloc here
-                }
-            }
-            next_j = n_j->next;
+    JointConstraint **joints = &c->joints[c->joint_start[job->color]];
+    unsigned int n_joints = coloring_n_joints(c, job->color);
+    PenetrationConstraint **contacts = &c->contacts[c->contact_start[job->color]];
+    // colored contacts solved as rows are packed after their pre-solve and solved by
+    // world_solve_color_rows
+    bool rows = world_uses_contact_rows(w) && job->color != COLORING_OVERFLOW;
+    unsigned int row = rows ? w->step.contact_row_start[job->color] : 0;
+    unsigned int n = n_joints;
+    if (!rows || job->phase != SOLVER_SOLVE)
+        n += coloring_n_contacts(c, job->color);
+
+    SolverResidual *residual = &w->step.thread_residuals[thread];
+    unsigned int begin = item * job->chunk;
+    unsigned int end = MIN(begin + job->chunk, n);
+    for (unsigned int i = begin; i < end; i++)
+    {
+        if (i < n_joints)
+        {
+            world_joint_phase(w, joints[i], job->phase, residual);
+        }
+        else
+        {
+            PenetrationConstraint *pc = contacts[i - n_joints];
+            if (rows && job->phase == SOLVER_POST_SOLVE)
+                contact_rows_store_lambda(&w->contact_rows, row + i - n_joints, pc);
+            world_contact_phase(w, pc, job->phase, residual);
+            if (rows && job->phase == SOLVER_PRE_SOLVE)
+                contact_rows_set(&w->contact_rows, row + i - n_joints, pc);
         }
-        next_i = n_i->next;
     }
+}
 
-    for (Node *n = w->joint_constraints.start, *next; n; n = next)
+// one pass over the contact rows of a color, WORLD_COLOR_CHUNK rows per item
+void world_solve_color_rows(void *data, unsigned int item, unsigned int thread)
+{
+    WorldColorJob *job = (WorldColorJob *)data;
+    World *w = job->w;
+    unsigned int begin = w->step.contact_row_start[job->color] + item * WORLD_COLOR_CHUNK;
+    unsigned int end = MIN(begin + WORLD_COLOR_CHUNK, w->step.contact_row_start[job->color + 1]);
+    contact_rows_solve(&w->contact_rows, w->body_pool.bodies, begin, end, &w->step.thread_residuals[thread]);
+}
+
+// Lays out the contact rows of the colors, each color starting on a batch of its own. The
+// rows are filled by the pre-solve, this only clears the padding.
+void world_begin_contact_rows(World *w)
+{
+    unsigned int *start = w->step.contact_row_start;
+    start[0] = 0;
+    for (unsigned int color = 0; color < COLORING_MAX_COLORS; color++)
     {
-        joint_constraint_pre_solve((JointConstraint *)n->data, delta_time, w->joint_beta);
-        next = n->next;
+        unsigned int n = coloring_n_contacts(&w->coloring, color);
+        start[color + 1] = start[color] + (n + CONTACT_ROWS_WIDTH - 1) / CONTACT_ROWS_WIDTH * CONTACT_ROWS_WIDTH;
     }
+    contact_rows_resize(&w->contact_rows, start[COLORING_MAX_COLORS]);
 
-    for (Node *n = pc_list.start, *next; n; n = next)
+    for (unsigned int color = 0; color < COLORING_MAX_COLORS; color++)
     {
-        penetration_constraint_pre_solve((PenetrationConstraint *)n->data, delta_time, w->penetration_beta);
-        next = n->next;
+        for (unsigned int i = start[color] + coloring_n_contacts(&w->coloring, color); i < start[color + 1]; i++)
+        {
+            contact_rows_clear(&w->contact_rows, i);
+        }
+    }
+}
+
+// Runs one phase over the colored constraints, a color at a time with its constraints split
+// over the threads. The overflow color has conflicts and runs on one thread. With
+// CONTACT_SOLVER_SIMD the contacts of the other colors are solved as contact rows.
+void world_solve_colors_phase(World *w, SolverPhase phase)
+{
+    TRACE_BEGIN(solver_phase_names[phase]);
+    WorldColorJob job = {w, phase, 0, WORLD_COLOR_CHUNK};
+    bool rows = phase == SOLVER_SOLVE && world_uses_contact_rows(w);
+    for (unsigned int color = 0; color < w->coloring.n_colors; color++)
+    {
+        unsigned int n = coloring_n_joints(&w->coloring, color) + (rows ? 0 : coloring_n_contacts(&w->coloring, color));
+        job.color = color;
+        job_parallel_for(&w->jobs, world_solve_color_chunk, &job, (n + WORLD_COLOR_CHUNK - 1) / WORLD_COLOR_CHUNK, 1);
+        if (rows)
+        {
+            unsigned int n_rows = w->step.contact_row_start[color + 1] - w->step.contact_row_start[color];
+            job_parallel_for(&w->jobs, world_solve_color_rows, &job, (n_rows + WORLD_COLOR_CHUNK - 1) / WORLD_COLOR_CHUNK, 1);
+        }
+    }
+
+    unsigned int n_overflow = coloring_n_joints(&w->coloring, COLORING_OVERFLOW) + coloring_n_contacts(&w->coloring, COLORING_OVERFLOW);
+    if (n_overflow > 0)
+    {
+        job.color = COLORING_OVERFLOW;
+        job.chunk = n_overflow;
+        world_solve_color_chunk(&job, 0, job_thread);
+    }
+    TRACE_END();
+}
+
+void world_stage_broadphase(World *w)
+{
+    broadphase_update(&w->broadphase, w->body_pool.bodies, w->body_pool.n_bodies);
+    w->stats.n_pairs_tested = w->broadphase.n_pairs_tested;
+    w->stats.n_candidate_pairs = w->broadphase.n_pairs;
+}
+
+void world_collide_pair(void *data, unsigned int item, unsigned int thread)
+{
+    World *w = (World *)data;
+    Body *a = &w->broadphase.bodies[w->broadphase.pairs[item].a];
+    Body *b = &w->broadphase.bodies[w->broadphase.pairs[item].b];
+
+    // neither body moved since the last step, so its contacts still hold
+    if (!world_body_moves(a) && !world_body_moves(b))
+    {
+        narrowphase_push(&w->narrowphase, thread, item)->keep = true;
+        return;
     }
 
-    for (unsigned int iter = 0; iter < w->constraint_iterations; iter++)
+    Collision_Info info[10];
+    unsigned int n_collisions = 0;
+    if (collision(a, b, info, &n_collisions))
     {
-        for (Node *n = w->joint_constraints.start, *next; n; n = next)
+        NarrowphaseResult *result = narrowphase_push(&w->narrowphase, thread, item);
+        result->n_points = MIN(n_collisions, MANIFOLD_MAX_POINTS);
+        for (unsigned int k = 0; k < result->n_points; k++)
         {
-            joint_constraint_solve((JointConstraint *)n->data, w->gauss_seidel_iterations);
-            next = n->next;
+            result->points[k] = info[k];
         }
+    }
+}
+
+// Collides the pairs over the threads, then updates the manifolds in pair order
+void world_stage_narrowphase(World *w)
+{
+    TRACE_BEGIN("collide pairs");
+    narrowphase_begin(&w->narrowphase, w->jobs.n_threads);
+    job_parallel_for(&w->jobs, world_collide_pair, w, w->broadphase.n_pairs, WORLD_PAIR_GRAIN);
+    narrowphase_merge(&w->narrowphase);
+    TRACE_END();
 
-        for (Node *n = pc_list.start, *next; n; n = next)
+    TRACE_BEGIN("update manifolds");
+    w->stats.n_contacts = 0;
+    manifold_cache_begin_frame(&w->manifolds);
+    for (unsigned int r = 0; r < w->narrowphase.n_results; r++)
+    {
+        NarrowphaseResult *result = &w->narrowphase.results[r];
+        Body *a = &w->broadphase.bodies[w->broadphase.pairs[result->pair].a];
+        Body *b = &w->broadphase.bodies[w->broadphase.pairs[result->pair].b];
+
+        if (result->keep)
         {
-            penetration_constraint_solve((PenetrationConstraint *)n->data, w->gauss_seidel_iterations);
-            next = n->next;
+            manifold_cache_keep(&w->manifolds, a, b);
+            continue;
         }
+
+        manifold_cache_update(&w->manifolds, a, b, result->points, result->n_points);
+        w->stats.n_contacts += result->n_points;
     }
+    TRACE_END();
+    w->stats.n_manifolds = w->manifolds.n_touched;
+    w->stats.n_warm_started_contacts = w->manifolds.n_matched_points;
+}
 
-    for (Node *n = w->joint_constraints.start, *next; n; n = next)
+// Builds the islands and this step's contact constraints, then sorts the constraints by
+// island and colors the biggest islands
+void world_stage_islands(World *w)
+{
+    world_build_islands(w);
+
+    w->step.n_contacts = 0;
+    for (unsigned int t = 0; t < w->manifolds.n_touched; t++)
     {
-        joint_constraint_post_solve((JointConstraint *)n->data);
-        next = n->next;
+        Manifold *m = manifold_cache_touched(&w->manifolds, t);
+        if (!world_constraint_awake(w, m->a, m->b))
+            continue;
+
+        for (unsigned int k = 0; k < m->n_points; k++)
+        {
+            Collision_Info *info = &m->points[k].info;
+            w->step.contacts = (PenetrationConstraint *)mem_grow(w->step.contacts, &w->step.contacts_capacity, w->step.n_contacts + 1, sizeof(PenetrationConstraint));
+            PenetrationConstraint *pc = &w->step.contacts[w->step.n_contacts++];
+            penetration_constraint_create(pc, info->a, info->b, info->start, info->end, info->normal);
+
+            // warm start with the impulses this contact accumulated last step
+            pc->cached_lambda.data[0][0] = m->points[k].normal_impulse;
+            pc->cached_lambda.data[1][0] = m->points[k].tangent_impulse;
+        }
     }
 
-    for (Node *n = pc_list.start, *next; n; n = next)
+    // islands share no moving bodies, so they are solved independently and the result
+    // does not depend on the number of threads. The biggest islands are colored instead,
+    // constraints of one color share no moving bodies either.
+    islands_sort_constraints(&w->islands, &w->joint_constraints, w->step.contacts, w->step.n_contacts);
+
+    unsigned int n_colored_islands = 0;
+    while (!world_uses_global_solver(w) && n_colored_islands < w->islands.n_awake_islands && w->islands.awake_islands[n_colored_islands].n_constraints >= w->coloring_threshold)
     {
-        penetration_constraint_post_solve((PenetrationConstraint *)n->data);
-        next = n->next;
+        n_colored_islands++;
     }
+    w->step.n_colored_islands = n_colored_islands;
 
-    for (Node *n = w->bodies.start, *next; n != NULL; n = next)
+    w->stats.n_colors = 0;
+    w->stats.n_colored_constraints = 0;
+    w->stats.n_overflow_constraints = 0;
+    if (n_colored_islands > 0)
     {
-        Body *b = (Body *)n->data;
-        body_integrate_velocities(b, delta_time);
-        next = n->next;
+        coloring_build(&w->coloring, &w->islands, n_colored_islands);
+        w->stats.n_colors = w->coloring.n_colors;
+        w->stats.n_colored_constraints = w->coloring.joint_start[COLORING_OVERFLOW] + w->coloring.contact_start[COLORING_OVERFLOW];
+        w->stats.n_overflow_constraints = coloring_n_joints(&w->coloring, COLORING_OVERFLOW) + coloring_n_contacts(&w->coloring, COLORING_OVERFLOW);
+    }
+}
+
+// the constraints of the awake islands, pre-solved, into w->system
+void world_assemble_system(World *w)
+{
+    constraint_system_begin(&w->system, w->body_pool.n_bodies);
+    for (unsigned int item = 0; item < w->islands.n_awake_islands; item++)
+    {
+        JointConstraint **joints;
+        PenetrationConstraint **contacts;
+        unsigned int n_joints, n_contacts;
+        world_island_constraints(w, item, &joints, &n_joints, &contacts, &n_contacts);
+        for (unsigned int i = 0; i < n_joints; i++)
+        {
+            constraint_system_add_joint(&w->system, joints[i]);
+        }
+    }
+    for (unsigned int item = 0; item < w->islands.n_awake_islands; item++)
+    {
+        JointConstraint **joints;
+        PenetrationConstraint **contacts;
+        unsigned int n_joints, n_contacts;
+        world_island_constraints(w, item, &joints, &n_joints, &contacts, &n_contacts);
+        for (unsigned int i = 0; i < n_contacts; i++)
+        {
+            constraint_system_add_contact(&w->system, contacts[i]);
+        }
+    }
+    constraint_system_end(&w->system, w->body_pool.bodies, w->body_pool.n_bodies);
+}
+
+void world_stage_pre_solve(World *w)
+{
+    w->step.thread_residuals = (SolverResidual *)mem_grow(w->step.thread_residuals, &w->step.threads_capacity, w->jobs.n_threads, sizeof(SolverResidual));
+
+    if (w->step.n_colored_islands > 0)
+    {
+        if (world_uses_contact_rows(w))
+            world_begin_contact_rows(w);
+        world_solve_colors_phase(w, SOLVER_PRE_SOLVE);
+    }
+
+    unsigned int n_islands = w->islands.n_awake_islands - w->step.n_colored_islands;
+    TRACE_BEGIN("uncolored islands");
+    job_parallel_for(&w->jobs, world_pre_solve_island, w, n_islands, WORLD_ISLAND_GRAIN);
+    TRACE_END();
+
+    if (world_uses_global_solver(w))
+        world_assemble_system(w);
+}
+
+// adds one island, or group of islands solved together, to the solver stats of the step
+void world_add_solver_stats(World *w, unsigned int iterations, SolverResidual *residual, SolverResidual *total)
+{
+    w->stats.n_solver_iterations += iterations;
+    w->stats.max_solver_iterations = MAX(w->stats.max_solver_iterations, iterations);
+    solver_residual_merge(total, residual);
+}
+
+// Iterates over the colored islands until they settle. The threads add up the residual of an
+// iteration each on their own, the largest change decides and does not depend on how the
+// constraints were split over them.
+void world_reset_thread_residuals(World *w)
+{
+    for (unsigned int t = 0; t < w->jobs.n_threads; t++)
+    {
+        w->step.thread_residuals[t] = (SolverResidual){0};
+    }
+}
+
+SolverResidual world_merge_thread_residuals(World *w)
+{
+    SolverResidual residual = {0};
+    for (unsigned int t = 0; t < w->jobs.n_threads; t++)
+    {
+        solver_residual_merge(&residual, &w->step.thread_residuals[t]);
+    }
+    return residual;
+}
+
+void world_solve_colored_islands(World *w, SolverResidual *total)
+{
+    unsigned int iter = 0;
+    SolverResidual residual = {0};
+    while (iter < w->constraint_iterations)
+    {
+        world_reset_thread_residuals(w);
+        world_solve_colors_phase(w, SOLVER_SOLVE);
+        residual = world_merge_thread_residuals(w);
+
+        iter++;
+        if (iter >= w->min_constraint_iterations && residual.max <= w->solver_tolerance)
+            break;
+    }
+    if (world_uses_contact_rows(w))
+        world_solve_colors_phase(w, SOLVER_POST_SOLVE);
+    world_add_solver_stats(w, iter, &residual, total);
+}
+
+void world_reserve_island_results(World *w, unsigned int n_islands)
+{
+    if (n_islands > w->step.islands_capacity)
+    {
+        w->step.islands_capacity = MAX(n_islands, 2 * w->step.islands_capacity);
+        w->step.island_iterations = (unsigned int *)mem_realloc(w->step.island_iterations, w->step.islands_capacity * sizeof(unsigned int));
+        w->step.island_residuals = (SolverResidual *)mem_realloc(w->step.island_residuals, w->step.islands_capacity * sizeof(SolverResidual));
+    }
+}
+
+// the velocities of a substep from the forces, which are taken off the bodies with the first
+// substep and stay in the body state for the others
+void world_substep_integrate_forces(void *data, unsigned int item, unsigned int thread)
+{
+    World *w = (World *)data;
+    (void)thread;
+    unsigned int begin, end;
+    world_body_run(w, item, &begin, &end);
+    if (w->step.substep == 0)
+        body_state_load_forces(&w->body_state, w->body_pool.bodies, begin, end);
+    else
+        body_state_load_velocities(&w->body_state, w->body_pool.bodies, begin, end);
+    body_state_integrate_forces(&w->body_state, begin, end, w->step.substep_time);
+    body_state_store_velocities(&w->body_state, w->body_pool.bodies, begin, end);
+}
+
+void world_substep_integrate_velocities(void *data, unsigned int item, unsigned int thread)
+{
+    World *w = (World *)data;
+    (void)thread;
+    unsigned int begin, end;
+    world_body_run(w, item, &begin, &end);
+    body_state_load_velocities(&w->body_state, w->body_pool.bodies, begin, end);
+    body_state_integrate_velocities(&w->body_state, begin, end, w->step.substep_time);
+    body_state_store_positions(&w->body_state, w->body_pool.bodies, begin, end);
+}
+
+// one phase of the soft step on an uncolored island, the soft solve warm starts it first
+void world_soft_step_island(void *data, unsigned int item, unsigned int thread)
+{
+    WorldIslandJob *job = (WorldIslandJob *)data;
+    World *w = job->w;
+    (void)thread;
+    JointConstraint **joints;
+    PenetrationConstraint **contacts;
+    unsigned int n_joints, n_contacts;
+    world_island_constraints(w, item, &joints, &n_joints, &contacts, &n_contacts);
+
+    SolverResidual residual = {0};
+    if (job->phase == SOLVER_SOFT_SOLVE)
+    {
+        for (unsigned int i = 0; i < n_joints; i++)
+        {
+            world_joint_phase(w, joints[i], SOLVER_WARM_START, &residual);
+        }
+        for (unsigned int i = 0; i < n_contacts; i++)
+        {
+            world_contact_phase(w, contacts[i], SOLVER_WARM_START, &residual);
+        }
     }
 
-    list_destroy(&pc_list);
+    for (unsigned int i = 0; i < n_joints; i++)
+    {
+        world_joint_phase(w, joints[i], job->phase, &residual);
+    }
+    for (unsigned int i = 0; i < n_contacts; i++)
+    {
+        world_contact_phase(w, contacts[i], job->phase, &residual);
+    }
+    if (job->phase == SOLVER_RELAX)
+        w->step.island_residuals[item] = residual;
+}
+
+void world_soft_step_phase(World *w, SolverPhase phase)
+{
+    if (w->step.n_colored_islands > 0)
+    {
+        if (phase == SOLVER_SOFT_SOLVE)
+            world_solve_colors_phase(w, SOLVER_WARM_START);
+        world_solve_colors_phase(w, phase);
+    }
+
+    WorldIslandJob job = {w, phase};
+    unsigned int n_islands = w->islands.n_awake_islands - w->step.n_colored_islands;
+    TRACE_BEGIN("uncolored islands");
+    job_parallel_for(&w->jobs, world_soft_step_island, &job, n_islands, WORLD_ISLAND_GRAIN);
+    TRACE_END();
+}
+
+// Soft step: each substep integrates the forces, warm starts and solves the soft constraints
+// once with their bias, moves the bodies and relaxes once without the bias, so the push out
+// of overlap does not stay in the velocities. Restitution is applied once at the end. The
+// constraints keep the anchors and jacobians of the pre-solve and follow the bodies only by
+// the angle they turned since.
+void world_solve_soft_step(World *w, SolverResidual *total)
+{
+    unsigned int substeps = MAX(w->substeps, 1);
+    float h = w->step.delta_time / substeps;
+    w->step.substep_time = h;
+    w->step.inv_substep_time = 1.0f / h;
+    w->step.contact_softness = softness_create(MIN(w->contact_hertz, 0.25f / h), w->contact_damping_ratio, h);
+    w->step.joint_softness = softness_create(w->joint_hertz, w->joint_damping_ratio, h);
+
+    unsigned int n_islands = w->islands.n_awake_islands - w->step.n_colored_islands;
+    world_reserve_island_results(w, n_islands);
+
+    for (unsigned int s = 0; s < substeps; s++)
+    {
+        w->step.substep = s;
+        TRACE_BEGIN("substep");
+        TRACE_BEGIN(world_stage_names[WORLD_STAGE_INTEGRATE_FORCES]);
+        job_parallel_for(&w->jobs, world_substep_integrate_forces, w, world_n_body_runs(w), 1);
+        TRACE_END();
+        world_soft_step_phase(w, SOLVER_SOFT_SOLVE);
+        TRACE_BEGIN(world_stage_names[WORLD_STAGE_INTEGRATE_VELOCITIES]);
+        job_parallel_for(&w->jobs, world_substep_integrate_velocities, w, world_n_body_runs(w), 1);
+        TRACE_END();
+        world_reset_thread_residuals(w);
+        world_soft_step_phase(w, SOLVER_RELAX);
+        TRACE_END();
+    }
+
+    // the residual is that of the last relax
+    SolverResidual colored = world_merge_thread_residuals(w);
+    world_soft_step_phase(w, SOLVER_RESTITUTION);
+    if (w->step.n_colored_islands > 0)
+        world_add_solver_stats(w, substeps, &colored, total);
+    for (unsigned int i = 0; i < n_islands; i++)
+    {
+        world_add_solver_stats(w, substeps, &w->step.island_residuals[i], total);
+    }
+}
+
+void world_stage_solve(World *w)
+{
+    w->stats.n_solver_iterations = 0;
+    w->stats.max_solver_iterations = 0;
+    SolverResidual total = {0};
+
+    if (w->solver_mode == SOLVER_MODE_SOFT_STEP)
+    {
+        world_solve_soft_step(w, &total);
+    }
+    else if (w->global_solver)
+    {
+        TRACE_BEGIN("global solver");
+        unsigned int iterations = constraint_system_solve(&w->system, w->min_constraint_iterations, w->gauss_seidel_iterations, w->solver_tolerance);
+        constraint_system_apply(&w->system, w->body_pool.bodies);
+        TRACE_END();
+        world_add_solver_stats(w, iterations, &w->system.residual, &total);
+    }
+    else
+    {
+        if (w->step.n_colored_islands > 0)
+            world_solve_colored_islands(w, &total);
+
+        unsigned int n_islands = w->islands.n_awake_islands - w->step.n_colored_islands;
+        world_reserve_island_results(w, n_islands);
+        TRACE_BEGIN("uncolored islands");
+        job_parallel_for(&w->jobs, world_solve_island, w, n_islands, WORLD_ISLAND_GRAIN);
+        TRACE_END();
+
+        for (unsigned int i = 0; i < n_islands; i++)
+        {
+            world_add_solver_stats(w, w->step.island_iterations[i], &w->step.island_residuals[i], &total);
+        }
+    }
+    w->stats.solver_residual_max = total.max;
+    w->stats.solver_residual_rms = solver_residual_rms(&total);
+
+    // the contacts were built in the order of the touched manifolds, hand the impulses back
+    PenetrationConstraint *pc = w->step.contacts;
+    for (unsigned int t = 0; t < w->manifolds.n_touched; t++)
+    {
+        Manifold *m = manifold_cache_touched(&w->manifolds, t);
+        if (!world_constraint_awake(w, m->a, m->b))
+            continue;
+
+        for (unsigned int k = 0; k < m->n_points; k++)
+        {
+            m->points[k].normal_impulse = pc->cached_lambda.data[0][0];
+            m->points[k].tangent_impulse = pc->cached_lambda.data[1][0];
+            pc++;
+        }
+    }
+}
+
+void world_stage_sleep(World *w)
+{
+    if (w->allow_sleeping)
+    {
+        islands_sleep(&w->islands, w->body_pool.bodies, w->step.delta_time, w->sleep_linear_velocity, w->sleep_angular_velocity, w->time_to_sleep);
+    }
+
+    w->stats.n_islands = w->islands.n_islands;
+    w->stats.n_awake_bodies = 0;
+    w->stats.n_sleeping_bodies = 0;
+    for (unsigned int i = 0; i < w->body_pool.n_bodies; i++)
+    {
+        Body *b = &w->body_pool.bodies[i];
+        if (b->inv_mass == 0.0)
+            continue;
+        if (b->is_awake)
+            w->stats.n_awake_bodies++;
+        else
+            w->stats.n_sleeping_bodies++;
+    }
+}
+
+void world_run_stage(void *data, unsigned int item, unsigned int thread)
+{
+    WorldStageTask *task = (WorldStageTask *)data;
+    World *w = task->w;
+    (void)item;
+    (void)thread;
+    double start = timer_now();
+    TRACE_BEGIN(world_stage_names[task->stage]);
+
+    switch (task->stage)
+    {
+    case WORLD_STAGE_APPLY_FORCES:
+        job_parallel_for(&w->jobs, world_apply_forces, w, w->body_pool.n_bodies, WORLD_BODY_GRAIN);
+        break;
+    case WORLD_STAGE_INTEGRATE_FORCES:
+        // the soft step integrates in its substeps
+        if (w->solver_mode == SOLVER_MODE_SOFT_STEP)
+            break;
+        job_parallel_for(&w->jobs, world_integrate_forces, w, world_n_body_runs(w), 1);
+        break;
+    case WORLD_STAGE_BROADPHASE:
+        world_stage_broadphase(w);
+        break;
+    case WORLD_STAGE_NARROWPHASE:
+        world_stage_narrowphase(w);
+        break;
+    case WORLD_STAGE_ISLANDS:
+        world_stage_islands(w);
+        break;
+    case WORLD_STAGE_PRE_SOLVE:
+        world_stage_pre_solve(w);
+        break;
+    case WORLD_STAGE_SOLVE:
+        world_stage_solve(w);
+        break;
+    case WORLD_STAGE_INTEGRATE_VELOCITIES:
+        if (w->solver_mode == SOLVER_MODE_SOFT_STEP)
+            break;
+        job_parallel_for(&w->jobs, world_integrate_velocities, w, world_n_body_runs(w), 1);
+        break;
+    case WORLD_STAGE_SLEEP:
+        world_stage_sleep(w);
+        break;
+    default:
+        break;
+    }
+
+    TRACE_END();
+    w->stats.stage_time[task->stage] = timer_now() - start;
+}
+
+void world_update(World *w, float delta_time)
+{
+    TRACE_BEGIN("world_update");
+    WorldStep *step = &w->step;
+    step->delta_time = delta_time;
+
+    body_state_resize(&w->body_state, w->body_pool.n_bodies);
+
+    WorldStageTask stages[WORLD_STAGE_COUNT];
+    JobTask tasks[WORLD_STAGE_COUNT];
+    for (unsigned int s = 0; s < WORLD_STAGE_COUNT; s++)
+    {
+        stages[s] = (WorldStageTask){w, (WorldStage)s};
+        job_task_init(&tasks[s], world_run_stage, &stages[s]);
+    }
+
+    // the broadphase only reads positions and runs next to the force stages, except for the
+    // tree which fattens the boxes along the velocity
+    job_task_depends_on(&tasks[WORLD_STAGE_INTEGRATE_FORCES], &tasks[WORLD_STAGE_APPLY_FORCES]);
+    if (w->broadphase.type == BROADPHASE_AABB_TREE)
+        job_task_depends_on(&tasks[WORLD_STAGE_BROADPHASE], &tasks[WORLD_STAGE_INTEGRATE_FORCES]);
+    job_task_depends_on(&tasks[WORLD_STAGE_NARROWPHASE], &tasks[WORLD_STAGE_INTEGRATE_FORCES]);
+    job_task_depends_on(&tasks[WORLD_STAGE_NARROWPHASE], &tasks[WORLD_STAGE_BROADPHASE]);
+    for (unsigned int s = WORLD_STAGE_ISLANDS; s < WORLD_STAGE_COUNT; s++)
+    {
+        job_task_depends_on(&tasks[s], &tasks[s - 1]);
+    }
+
+    job_graph_run(&w->jobs, tasks, WORLD_STAGE_COUNT);
+
+    w->stats.broadphase_time = w->stats.stage_time[WORLD_STAGE_BROADPHASE];
+    w->stats.solver_time = w->stats.stage_time[WORLD_STAGE_PRE_SOLVE] + w->stats.stage_time[WORLD_STAGE_SOLVE];
+
+    // recorded here as the stages may run on other threads
+    debug_draw_clear(&w->debug_draw);
+    for (unsigned int t = 0; w->debug_draw.enabled && t < w->manifolds.n_touched; t++)
+    {
+        Manifold *m = manifold_cache_touched(&w->manifolds, t);
+        for (unsigned int k = 0; k < m->n_points; k++)
+        {
+            debug_draw_point(&w->debug_draw, m->points[k].info.start, (uint8_t[3]){255, 0, 0});
+        }
+    }
+
+    manifold_cache_evict(&w->manifolds);
+
+    w->stats.scratch_high_water = mem_scratch_take_high_water(mem_scratch_pool);
+    for (unsigned int t = 1; t < w->jobs.n_threads; t++)
+    {
+        size_t high_water = mem_scratch_take_high_water(&w->jobs.scratch_pools[t]);
+        if (high_water > w->stats.scratch_high_water)
+            w->stats.scratch_high_water = high_water;
+    }
+    step->n_contacts = 0;
+    TRACE_END();
 }
 
-#endif
\ No newline at end of file
+#endif